@@ -0,0 +1,163 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <stdint.h>
+
+/*
+ * Bitboard helpers shared by Board and the search code. A bitboard holds one
+ * bit per square, using the same x + 8*y indexing as Board, so bit 0 is the
+ * upper-left corner (0,0) and bit 63 is the lower-right corner (7,7).
+ */
+
+#define BB_FILE_A   UINT64_C(0x0101010101010101)
+#define BB_FILE_H   UINT64_C(0x8080808080808080)
+#define BB_CORNERS  UINT64_C(0x8100000000000081)
+
+#define BB_SQUARE(x, y) (UINT64_C(1) << ((x) + 8 * (y)))
+
+// Room for the legal moves of any position. Reachable positions have at most
+// 33, so move lists sized by this never overflow.
+#define MAX_MOVES   64
+
+/*
+ * Shifts every stone one step in direction dir (0-7), dropping stones that
+ * would wrap around an edge.
+ */
+static inline uint64_t bb_shift(uint64_t b, int dir) {
+    switch (dir) {
+        case 0:  return (b << 1) & ~BB_FILE_A;   // east
+        case 1:  return (b >> 1) & ~BB_FILE_H;   // west
+        case 2:  return b << 8;                  // south
+        case 3:  return b >> 8;                  // north
+        case 4:  return (b << 9) & ~BB_FILE_A;   // south-east
+        case 5:  return (b << 7) & ~BB_FILE_H;   // south-west
+        case 6:  return (b >> 7) & ~BB_FILE_A;   // north-east
+        default: return (b >> 9) & ~BB_FILE_H;   // north-west
+    }
+}
+
+/*
+ * Returns the set of legal moves for the side owning the stones in own.
+ */
+static inline uint64_t bb_moves(uint64_t own, uint64_t opp) {
+    uint64_t empty = ~(own | opp);
+    uint64_t moves = 0;
+    for (int dir = 0; dir < 8; dir++) {
+        uint64_t t = bb_shift(own, dir) & opp;
+        t |= bb_shift(t, dir) & opp;
+        t |= bb_shift(t, dir) & opp;
+        t |= bb_shift(t, dir) & opp;
+        t |= bb_shift(t, dir) & opp;
+        t |= bb_shift(t, dir) & opp;
+        moves |= bb_shift(t, dir) & empty;
+    }
+    return moves;
+}
+
+/*
+ * Returns the opponent stones flipped by playing on square sq. The result is
+ * empty if the move is illegal.
+ */
+static inline uint64_t bb_flips(uint64_t own, uint64_t opp, int sq) {
+    uint64_t m = UINT64_C(1) << sq;
+    uint64_t flips = 0;
+    for (int dir = 0; dir < 8; dir++) {
+        uint64_t f = 0;
+        uint64_t t = bb_shift(m, dir);
+        while (t & opp) {
+            f |= t;
+            t = bb_shift(t, dir);
+        }
+        if (t & own) flips |= f;
+    }
+    return flips;
+}
+
+static inline int bb_count(uint64_t b) {
+    return __builtin_popcountll(b);
+}
+
+/*
+ * Index of the lowest set bit; b must be non-zero.
+ */
+static inline int bb_first(uint64_t b) {
+    return __builtin_ctzll(b);
+}
+
+/*
+ * Mirrors the board left to right (x -> 7 - x).
+ */
+static inline uint64_t bb_mirror(uint64_t b) {
+    b = ((b >> 1) & UINT64_C(0x5555555555555555))
+        | ((b & UINT64_C(0x5555555555555555)) << 1);
+    b = ((b >> 2) & UINT64_C(0x3333333333333333))
+        | ((b & UINT64_C(0x3333333333333333)) << 2);
+    b = ((b >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F))
+        | ((b & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4);
+    return b;
+}
+
+/*
+ * Flips the board top to bottom (y -> 7 - y).
+ */
+static inline uint64_t bb_flip(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+/*
+ * Transposes the board about the (0,0)-(7,7) diagonal (x <-> y).
+ */
+static inline uint64_t bb_transpose(uint64_t b) {
+    uint64_t t;
+    t = UINT64_C(0x0F0F0F0F00000000) & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = UINT64_C(0x3333000033330000) & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = UINT64_C(0x5500550055005500) & (b ^ (b << 7));
+    b ^= t ^ (t >> 7);
+    return b;
+}
+
+/*
+ * Applies one of the 8 symmetries of the board: bit 2 of t transposes,
+ * then bit 0 mirrors and bit 1 flips.
+ */
+static inline uint64_t bb_transform(uint64_t b, int t) {
+    if (t & 4) b = bb_transpose(b);
+    if (t & 1) b = bb_mirror(b);
+    if (t & 2) b = bb_flip(b);
+    return b;
+}
+
+/*
+ * Maps a position to the smallest of its 8 symmetric images. Returns the
+ * symmetry used.
+ */
+static inline int bb_canonical(uint64_t own, uint64_t opp, uint64_t *cOwn,
+                               uint64_t *cOpp) {
+    int best = 0;
+    *cOwn = own;
+    *cOpp = opp;
+    for (int t = 1; t < 8; t++) {
+        uint64_t o = bb_transform(own, t);
+        uint64_t p = bb_transform(opp, t);
+        if (o < *cOwn || (o == *cOwn && p < *cOpp)) {
+            *cOwn = o;
+            *cOpp = p;
+            best = t;
+        }
+    }
+    return best;
+}
+
+/*
+ * Square that symmetry t maps to sq, i.e. the inverse image of sq.
+ */
+static inline int bb_untransform_square(int sq, int t) {
+    for (int s = 0; s < 64; s++) {
+        if (bb_transform(UINT64_C(1) << s, t) == (UINT64_C(1) << sq)) return s;
+    }
+    return -1;
+}
+
+#endif
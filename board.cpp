@@ -1,48 +1,51 @@
 #include "board.h"
 
 /*
- * Make a standard 8x8 othello board and initialize it to the standard setup.
+ * Make an N x N othello board and initialize it to the standard setup.
  */
-Board::Board() {
-    taken.set(3 + 8 * 3);
-    taken.set(3 + 8 * 4);
-    taken.set(4 + 8 * 3);
-    taken.set(4 + 8 * 4);
-    black.set(4 + 8 * 3);
-    black.set(3 + 8 * 4);
+template <int N>
+BoardT<N>::BoardT() {
+    setBits(Geometry::start_black(), Geometry::start_white());
 }
 
 /*
  * Destructor for the board.
  */
-Board::~Board() {
+template <int N>
+BoardT<N>::~BoardT() {
 }
 
 /*
  * Returns a copy of this board.
  */
-Board *Board::copy() {
-    Board *newBoard = new Board();
+template <int N>
+BoardT<N> *BoardT<N>::copy() {
+    BoardT *newBoard = new BoardT();
     newBoard->black = black;
     newBoard->taken = taken;
     return newBoard;
 }
 
-bool Board::occupied(int x, int y) {
-    return taken[x + 8*y];
+template <int N>
+bool BoardT<N>::occupied(int x, int y) {
+    return taken[Geometry::square(x, y)];
 }
 
-bool Board::get(Side side, int x, int y) {
-    return occupied(x, y) && (black[x + 8*y] == (side == BLACK));
+template <int N>
+bool BoardT<N>::get(Side side, int x, int y) {
+    return occupied(x, y)
+        && (black[Geometry::square(x, y)] == (side == BLACK));
 }
 
-void Board::set(Side side, int x, int y) {
-    taken.set(x + 8*y);
-    black.set(x + 8*y, side == BLACK);
+template <int N>
+void BoardT<N>::set(Side side, int x, int y) {
+    taken.set(Geometry::square(x, y));
+    black.set(Geometry::square(x, y), side == BLACK);
 }
 
-bool Board::onBoard(int x, int y) {
-    return(0 <= x && x < 8 && 0 <= y && y < 8);
+template <int N>
+bool BoardT<N>::onBoard(int x, int y) {
+    return Geometry::on_board(x, y);
 }
 
  
@@ -50,27 +53,25 @@ bool Board::onBoard(int x, int y) {
  * Returns true if the game is finished; false otherwise. The game is finished 
  * if neither side has a legal move.
  */
-bool Board::isDone() {
+template <int N>
+bool BoardT<N>::isDone() {
     return !(hasMoves(BLACK) || hasMoves(WHITE));
 }
 
 /*
  * Returns true if there are legal moves for the given side.
  */
-bool Board::hasMoves(Side side) {
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Move move(i, j);
-            if (checkMove(&move, side)) return true;
-        }
-    }
-    return false;
+template <int N>
+bool BoardT<N>::hasMoves(Side side) {
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    return Geometry::moves(getBits(side), getBits(other)) != 0;
 }
 
 /*
  * Returns true if a move is legal for the given side; false otherwise.
  */
-bool Board::checkMove(Move *m, Side side) {
+template <int N>
+bool BoardT<N>::checkMove(Move *m, Side side) {
     // Passing is only legal if you have no moves.
     if (m == NULL) return !hasMoves(side);
 
@@ -80,30 +81,15 @@ bool Board::checkMove(Move *m, Side side) {
     if (occupied(X, Y)) return false;
 
     Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            // Is there a capture in that direction?
-            int x = X + dx;
-            int y = Y + dy;
-            if (onBoard(x, y) && get(other, x, y)) {
-                do {
-                    x += dx;
-                    y += dy;
-                } while (onBoard(x, y) && get(other, x, y));
-
-                if (onBoard(x, y) && get(side, x, y)) return true;
-            }
-        }
-    }
-    return false;
+    uint64_t moves = Geometry::moves(getBits(side), getBits(other));
+    return (moves & (UINT64_C(1) << Geometry::square(X, Y))) != 0;
 }
 
 /*
  * Modifies the board to reflect the specified move.
  */
-void Board::doMove(Move *m, Side side) {
+template <int N>
+void BoardT<N>::doMove(Move *m, Side side) {
     // A NULL move means pass.
     if (m == NULL) return;
 
@@ -113,80 +99,57 @@ void Board::doMove(Move *m, Side side) {
     int X = m->getX();
     int Y = m->getY();
     Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            int x = X;
-            int y = Y;
-            do {
-                x += dx;
-                y += dy;
-            } while (onBoard(x, y) && get(other, x, y));
-
-            if (onBoard(x, y) && get(side, x, y)) {
-                x = X;
-                y = Y;
-                x += dx;
-                y += dy;
-                while (onBoard(x, y) && get(other, x, y)) {
-                    set(side, x, y);
-                    x += dx;
-                    y += dy;
-                }
-            }
-        }
-    }
-    set(side, X, Y);
+    uint64_t own = getBits(side);
+    uint64_t opp = getBits(other);
+    int sq = Geometry::square(X, Y);
+    uint64_t flips = Geometry::flips(own, opp, sq);
+    own |= flips | (UINT64_C(1) << sq);
+    opp &= ~flips;
+    if (side == BLACK) setBits(own, opp);
+    else setBits(opp, own);
 }
 
 /*
  * Current count of given side's stones.
  */
-int Board::count(Side side) {
+template <int N>
+int BoardT<N>::count(Side side) {
     return (side == BLACK) ? countBlack() : countWhite();
 }
 
 /*
  * Current count of black stones.
  */
-int Board::countBlack() {
+template <int N>
+int BoardT<N>::countBlack() {
     return black.count();
 }
 
 /*
  * Current count of white stones.
  */
-int Board::countWhite() {
+template <int N>
+int BoardT<N>::countWhite() {
     return taken.count() - black.count();
 }
 
-int Board::countMoves(Side side) {
-    int nmoves = 0;
-    for (int x = 0; x < 8; x++)
-    {
-        for(int y = 0; y < 8; y++)
-        {
-            Move *move = new Move(x, y);
-            if(checkMove(move, side))
-            {
-                nmoves++;
-            }
-            delete move;
-        }
-    }
-
-    return nmoves;
+template <int N>
+int BoardT<N>::countMoves(Side side) {
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    return bb_count(Geometry::moves(getBits(side), getBits(other)));
 }
 
 /*
- * Sets the board state given an 8x8 char array where 'w' indicates a white
- * piece and 'b' indicates a black piece. Mainly for testing purposes.
+ * Sets the board state given a char array indexed like the bitboards
+ * (x + 8*y, Geometry::BITS long) where 'w' indicates a white piece and 'b'
+ * indicates a black piece. Mainly for testing purposes.
  */
-void Board::setBoard(char data[]) {
+template <int N>
+void BoardT<N>::setBoard(char data[]) {
     taken.reset();
     black.reset();
-    for (int i = 0; i < 64; i++) {
+    for (int i = 0; i < Geometry::BITS; i++) {
+        if (!((Geometry::BOARD >> i) & 1)) continue;
         if (data[i] == 'b') {
             taken.set(i);
             black.set(i);
@@ -196,30 +159,53 @@ void Board::setBoard(char data[]) {
     }
 }
 
+/*
+ * Returns the stones of the given side as a bitboard (bit x + 8*y).
+ */
+template <int N>
+uint64_t BoardT<N>::getBits(Side side) {
+    uint64_t b = black.to_ulong();
+    return (side == BLACK) ? b : (taken.to_ulong() & ~b);
+}
+
+/*
+ * Sets the board state from one bitboard per side. The two must not overlap.
+ */
+template <int N>
+void BoardT<N>::setBits(uint64_t blackBits, uint64_t whiteBits) {
+    black = bitset<Geometry::BITS>(blackBits);
+    taken = bitset<Geometry::BITS>(blackBits | whiteBits);
+}
+
 /* 
  * Retrieves the current board state so it can be set later using setBoard
  */
-char *Board::getBoard()
+template <int N>
+char *BoardT<N>::getBoard()
 {
-    char *data = new char[64];
-    for(int x = 0; x < 8; x++)
+    char *data = new char[Geometry::BITS];
+    for(int i = 0; i < Geometry::BITS; i++)
     {
-        for(int y = 0; y < 8; y++)
+        data[i] = 'x';
+    }
+    for(int x = 0; x < Geometry::SIZE; x++)
+    {
+        for(int y = 0; y < Geometry::SIZE; y++)
         {
-            if(taken[x + 8*y])
+            if(taken[Geometry::square(x, y)])
             {
-                if(black[x + 8*y])
+                if(black[Geometry::square(x, y)])
                 {
-                    data[x + 8*y] = 'b';
+                    data[Geometry::square(x, y)] = 'b';
                 }
                 else
                 {
-                    data[x + 8*y] = 'w';
+                    data[Geometry::square(x, y)] = 'w';
                 }
             }
             else
             {
-                data[x + 8*y] = 'x'; 
+                data[Geometry::square(x, y)] = 'x'; 
             }
         }
     }
@@ -230,15 +216,16 @@ char *Board::getBoard()
 /*
  * Draws the current state of the board out for debugging purposes
  */
-void Board::draw()
+template <int N>
+void BoardT<N>::draw()
 {
-    for(int x = 0; x < 8; x++)
+    for(int x = 0; x < Geometry::SIZE; x++)
     {
-        for(int y = 0; y < 8; y++)
+        for(int y = 0; y < Geometry::SIZE; y++)
         {
-            if(taken[y + x*8])
+            if(taken[Geometry::square(y, x)])
             {
-                if(black[y + x*8])
+                if(black[Geometry::square(y, x)])
                 {
                     std::cerr << " B ";
                 }
@@ -259,13 +246,14 @@ void Board::draw()
 
 // For the side given by input argument side, count the number of unoccupied,
 // so called "fronteir" squares that 
-int Board::countFrontier(Side side)
+template <int N>
+int BoardT<N>::countFrontier(Side side)
 {
     // Keep track of spaces identified as fronteir spaces using a biset:
-    bitset<64> frontier_spaces;
-    for(int x = 0; x < 8; x++)
+    bitset<Geometry::BITS> frontier_spaces;
+    for(int x = 0; x < Geometry::SIZE; x++)
     {
-        for(int y = 0; y < 8; y++)
+        for(int y = 0; y < Geometry::SIZE; y++)
         {
             // If side has a token at the space, count how many adjacent
             // peices: 
@@ -279,9 +267,9 @@ int Board::countFrontier(Side side)
                         {
                             if(!occupied(xx,yy))
                             {
-                                if(!frontier_spaces[xx + 8*yy])
+                                if(!frontier_spaces[Geometry::square(xx, yy)])
                                 {
-                                    frontier_spaces.set(xx + 8*yy);
+                                    frontier_spaces.set(Geometry::square(xx, yy));
                                 }
                             }
                         }
@@ -293,7 +281,7 @@ int Board::countFrontier(Side side)
 
     // Count how many places we marked:
     int nspaces = 0; 
-    for(int i = 0; i < 64; i++)
+    for(int i = 0; i < Geometry::BITS; i++)
     {
         if(frontier_spaces[i])
         {
@@ -304,6 +292,10 @@ int Board::countFrontier(Side side)
     return nspaces;
 }
 
+template class BoardT<4>;
+template class BoardT<6>;
+template class BoardT<8>;
+
 /*
 // Returns true if the board position at (x,y) is adjacent to the reference
 // position at (x0, y0)
@@ -3,15 +3,25 @@
 
 #include <bitset>
 #include "common.h"
+#include "bitboard.h"
+#include "boardgeom.h"
 #include <iostream>
 #include <vector>
 using namespace std;
 
-class Board {
-   
+/*
+ * An N x N board (see BoardGeometry), as the player and the tools outside
+ * the bitboard searches see it. Board is the 8x8 one.
+ */
+template <int N>
+class BoardT {
+
+public:
+    typedef BoardGeometry<N> Geometry;
+
 private:
-    bitset<64> black;
-    bitset<64> taken;    
+    bitset<Geometry::BITS> black;
+    bitset<Geometry::BITS> taken;
        
     bool occupied(int x, int y);
     bool get(Side side, int x, int y);
@@ -19,9 +29,9 @@ private:
     bool onBoard(int x, int y);
       
 public:
-    Board();
-    ~Board();
-    Board *copy();
+    BoardT();
+    ~BoardT();
+    BoardT *copy();
     void draw();
     bool isDone();
     bool hasMoves(Side side);
@@ -34,6 +44,10 @@ public:
     int countFrontier(Side side);
     void setBoard(char data[]);
     char *getBoard();
+    uint64_t getBits(Side side);
+    void setBits(uint64_t blackBits, uint64_t whiteBits);
 };
 
+typedef BoardT<8> Board;
+
 #endif
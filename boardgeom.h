@@ -0,0 +1,141 @@
+#ifndef __BOARDGEOM_H__
+#define __BOARDGEOM_H__
+
+#include <stdint.h>
+
+/*
+ * Geometry and move generation for an N x N board, 4 <= N <= 8 and N even.
+ *
+ * Squares keep the x + 8*y indexing of the 8x8 board at every size, so a
+ * smaller board sits in the upper-left corner of the 64 bit word and the
+ * squares outside it are always empty. All masks are compile time
+ * constants; for N = 8 the board mask is all ones and the functions below
+ * compile to the same code as the helpers in bitboard.h.
+ */
+template <int N>
+struct BoardGeometry {
+    enum {
+        SIZE = N,
+        SQUARES = N * N,
+        STRIDE = 8,
+        // Bits of the word from square 0 to past the last square.
+        BITS = STRIDE * N,
+        // Longest run of stones one move can flip in a line.
+        MAX_RUN = N - 2
+    };
+
+    static const uint64_t FILE_A =
+        UINT64_C(0x0101010101010101) >> (8 * (8 - N));
+    static const uint64_t FILE_LAST = FILE_A << (N - 1);
+    static const uint64_t ROW = (UINT64_C(1) << N) - 1;
+    static const uint64_t BOARD = ROW * FILE_A;
+    static const uint64_t NOT_A = BOARD & ~FILE_A;
+    static const uint64_t NOT_LAST = BOARD & ~FILE_LAST;
+    static const uint64_t CORNERS =
+        (FILE_A | FILE_LAST) & (ROW | (ROW << (8 * (N - 1))));
+
+    static int square(int x, int y) {
+        return x + STRIDE * y;
+    }
+
+    static bool on_board(int x, int y) {
+        return 0 <= x && x < N && 0 <= y && y < N;
+    }
+
+    /*
+     * The four centre stones of the starting position, black on the
+     * (N/2, N/2 - 1)-(N/2 - 1, N/2) diagonal as on the 8x8 board.
+     */
+    static uint64_t start_black() {
+        return (UINT64_C(1) << square(N / 2, N / 2 - 1))
+            | (UINT64_C(1) << square(N / 2 - 1, N / 2));
+    }
+
+    static uint64_t start_white() {
+        return (UINT64_C(1) << square(N / 2 - 1, N / 2 - 1))
+            | (UINT64_C(1) << square(N / 2, N / 2));
+    }
+
+    /*
+     * Shifts every stone one step in direction dir (numbered as in
+     * bb_shift), dropping stones that would leave the board.
+     */
+    static uint64_t shift(uint64_t b, int dir) {
+        switch (dir) {
+            case 0:  return (b << 1) & NOT_A;       // east
+            case 1:  return (b >> 1) & NOT_LAST;    // west
+            case 2:  return (b << 8) & BOARD;       // south
+            case 3:  return b >> 8;                 // north
+            case 4:  return (b << 9) & NOT_A;       // south-east
+            case 5:  return (b << 7) & NOT_LAST;    // south-west
+            case 6:  return (b >> 7) & NOT_A;       // north-east
+            default: return (b >> 9) & NOT_LAST;    // north-west
+        }
+    }
+
+    /*
+     * Legal moves for the side owning the stones in own.
+     */
+    static uint64_t moves(uint64_t own, uint64_t opp) {
+        uint64_t empty = ~(own | opp) & BOARD;
+        uint64_t result = 0;
+        for (int dir = 0; dir < 8; dir++) {
+            // Written out rather than looped so that the steps a board this
+            // size does not need compile away.
+            uint64_t t = shift(own, dir) & opp;
+            if (MAX_RUN > 1) t |= shift(t, dir) & opp;
+            if (MAX_RUN > 2) t |= shift(t, dir) & opp;
+            if (MAX_RUN > 3) t |= shift(t, dir) & opp;
+            if (MAX_RUN > 4) t |= shift(t, dir) & opp;
+            if (MAX_RUN > 5) t |= shift(t, dir) & opp;
+            result |= shift(t, dir) & empty;
+        }
+        return result;
+    }
+
+    /*
+     * Opponent stones flipped by playing on square sq; empty if the move is
+     * illegal.
+     */
+    static uint64_t flips(uint64_t own, uint64_t opp, int sq) {
+        uint64_t m = UINT64_C(1) << sq;
+        uint64_t result = 0;
+        for (int dir = 0; dir < 8; dir++) {
+            uint64_t f = 0;
+            uint64_t t = shift(m, dir);
+            while (t & opp) {
+                f |= t;
+                t = shift(t, dir);
+            }
+            if (t & own) result |= f;
+        }
+        return result;
+    }
+
+    static int empties(uint64_t own, uint64_t opp) {
+        return SQUARES - __builtin_popcountll(own | opp);
+    }
+
+    /*
+     * Final score of a finished game for the side owning own, with empty
+     * squares counted for the winner.
+     */
+    static int final_score(uint64_t own, uint64_t opp) {
+        int o = __builtin_popcountll(own);
+        int p = __builtin_popcountll(opp);
+        int e = SQUARES - o - p;
+        if (o > p) return o - p + e;
+        if (o < p) return o - p - e;
+        return 0;
+    }
+};
+
+template <int N> const uint64_t BoardGeometry<N>::FILE_A;
+template <int N> const uint64_t BoardGeometry<N>::FILE_LAST;
+template <int N> const uint64_t BoardGeometry<N>::ROW;
+template <int N> const uint64_t BoardGeometry<N>::BOARD;
+template <int N> const uint64_t BoardGeometry<N>::NOT_A;
+template <int N> const uint64_t BoardGeometry<N>::NOT_LAST;
+template <int N> const uint64_t BoardGeometry<N>::CORNERS;
+
+#endif
@@ -0,0 +1,414 @@
+#include "dfpn.h"
+#include <cstring>
+#include "threadpool.h"
+
+static inline uint64_t dfpn_key(uint64_t own, uint64_t opp, int goal) {
+    uint64_t key = tt_key(own, opp)
+                   ^ ((uint64_t)(goal + 128) * UINT64_C(0xD6E8FEB86659FD93));
+    return (key != 0) ? key : 1;
+}
+
+// Sums proof numbers: infinite if either is, otherwise at most one short
+// of infinite.
+static inline uint32_t dfpn_add(uint32_t a, uint32_t b) {
+    if (a == DFPN_INFINITY || b == DFPN_INFINITY) return DFPN_INFINITY;
+    uint64_t sum = (uint64_t)a + b;
+    return (sum < DFPN_INFINITY) ? (uint32_t)sum : DFPN_INFINITY - 1;
+}
+
+/*
+ * Allocates the table and a leaf solver for each thread.
+ */
+DfpnSolver::DfpnSolver(size_t tableBytes, int nthreads) {
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > DFPN_MAX_THREADS) nthreads = DFPN_MAX_THREADS;
+    this->nthreads = nthreads;
+
+    buckets = tableBytes / (DFPN_BUCKET_ENTRIES * sizeof(DfpnEntry));
+    if (buckets < 1) buckets = 1;
+    table = new DfpnEntry[buckets * DFPN_BUCKET_ENTRIES];
+    clear();
+
+    for (int i = 0; i < DFPN_LOCKS; i++) pthread_mutex_init(&locks[i], NULL);
+    workers = new DfpnWorker[nthreads];
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].solver = this;
+        workers[i].nodes = 0;
+        workers[i].leafNodes = 0;
+        workers[i].leaf = new EndgameSolver(1, DFPN_LEAF_TT_BYTES);
+    }
+
+    rootOwn = rootOpp = 0;
+    rootGoal = 0;
+    deadline = 0;
+    stopped = false;
+    rootPn = rootDn = 1;
+    rootMove = -1;
+}
+
+DfpnSolver::~DfpnSolver() {
+    for (int i = 0; i < nthreads; i++) delete workers[i].leaf;
+    delete[] workers;
+    for (int i = 0; i < DFPN_LOCKS; i++) pthread_mutex_destroy(&locks[i]);
+    delete[] table;
+}
+
+/*
+ * Forgets every proof. Proofs stay valid from one position to the next, so
+ * this is only needed to measure a solve from scratch.
+ */
+void DfpnSolver::clear() {
+    memset(table, 0, buckets * DFPN_BUCKET_ENTRIES * sizeof(DfpnEntry));
+}
+
+bool DfpnSolver::lookup(uint64_t key, DfpnEntry *out) {
+    size_t b = key % buckets;
+    DfpnEntry *bucket = &table[b * DFPN_BUCKET_ENTRIES];
+    bool found = false;
+    if (nthreads > 1) pthread_mutex_lock(&locks[b % DFPN_LOCKS]);
+    for (int i = 0; i < DFPN_BUCKET_ENTRIES; i++) {
+        if (bucket[i].key == key) {
+            *out = bucket[i];
+            found = true;
+            break;
+        }
+    }
+    if (nthreads > 1) pthread_mutex_unlock(&locks[b % DFPN_LOCKS]);
+    return found;
+}
+
+/*
+ * Stores a node's numbers, replacing the entry of the bucket that took the
+ * least work if the node is new. A node another thread has already proven
+ * or disproven keeps its result.
+ */
+void DfpnSolver::store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work,
+                       int move) {
+    size_t b = key % buckets;
+    DfpnEntry *bucket = &table[b * DFPN_BUCKET_ENTRIES];
+    if (nthreads > 1) pthread_mutex_lock(&locks[b % DFPN_LOCKS]);
+
+    DfpnEntry *slot = NULL;
+    for (int i = 0; i < DFPN_BUCKET_ENTRIES; i++) {
+        if (bucket[i].key == key) {
+            slot = &bucket[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        slot = &bucket[0];
+        for (int i = 1; i < DFPN_BUCKET_ENTRIES; i++) {
+            if (bucket[i].key == 0
+                || (slot->key != 0 && bucket[i].work < slot->work)) {
+                slot = &bucket[i];
+            }
+        }
+        slot->key = key;
+        slot->busy = 0;
+        slot->work = 0;
+    } else if (slot->pn == 0 || slot->dn == 0) {
+        pn = slot->pn;
+        dn = slot->dn;
+        move = slot->move;
+    }
+    slot->pn = pn;
+    slot->dn = dn;
+    if (work > slot->work) slot->work = work;
+    slot->move = (int8_t)move;
+
+    if (nthreads > 1) pthread_mutex_unlock(&locks[b % DFPN_LOCKS]);
+}
+
+// Counts a thread into or out of a node, if the node is in the table.
+void DfpnSolver::set_busy(uint64_t key, int delta) {
+    size_t b = key % buckets;
+    DfpnEntry *bucket = &table[b * DFPN_BUCKET_ENTRIES];
+    pthread_mutex_lock(&locks[b % DFPN_LOCKS]);
+    for (int i = 0; i < DFPN_BUCKET_ENTRIES; i++) {
+        if (bucket[i].key == key) {
+            if (delta > 0 || bucket[i].busy > 0) bucket[i].busy += delta;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&locks[b % DFPN_LOCKS]);
+}
+
+/*
+ * The numbers of a node: from the table if it is there; exact if the game
+ * is over or the node is small enough to solve; otherwise the estimate of
+ * an unexpanded node, which is easier to disprove the fewer moves it has.
+ */
+void DfpnSolver::evaluate(DfpnWorker *w, uint64_t own, uint64_t opp,
+                          int goal, uint32_t *pn, uint32_t *dn, int *busy) {
+    uint64_t key = dfpn_key(own, opp, goal);
+    DfpnEntry e;
+    *busy = 0;
+    if (lookup(key, &e)) {
+        *pn = e.pn;
+        *dn = e.dn;
+        *busy = e.busy;
+        return;
+    }
+
+    uint64_t moves = bb_moves(own, opp);
+    if (moves == 0 && bb_moves(opp, own) == 0) {
+        bool win = endgame_final_score(own, opp) > goal;
+        *pn = win ? 0 : DFPN_INFINITY;
+        *dn = win ? DFPN_INFINITY : 0;
+        return;
+    }
+
+    if (64 - bb_count(own | opp) <= DFPN_LEAF_EMPTIES) {
+        int move;
+        int score = w->leaf->solve(own, opp, goal, goal + 1, &move);
+        long nodes = w->leaf->nodes();
+        w->leafNodes += nodes;
+        bool win = score > goal;
+        *pn = win ? 0 : DFPN_INFINITY;
+        *dn = win ? DFPN_INFINITY : 0;
+        store(key, *pn, *dn, (nodes < (long)DFPN_INFINITY) ? nodes
+                                                           : DFPN_INFINITY,
+              win ? move : -1);
+        return;
+    }
+
+    *pn = 1;
+    *dn = (moves != 0) ? bb_count(moves) : 1;
+}
+
+/*
+ * Expands the node until its proof number reaches thPn or its disproof
+ * number reaches thDn, always descending into the child with the smallest
+ * disproof number (the one that most cheaply proves this node). The child
+ * may go on until its proof number would make this node's disproof number
+ * reach thDn, or its disproof number passes the second smallest by a
+ * quarter (the 1 + epsilon trick, which saves returning to this node every
+ * time the two trade places).
+ */
+void DfpnSolver::mid(DfpnWorker *w, uint64_t own, uint64_t opp, int goal,
+                     uint32_t thPn, uint32_t thDn, int ply) {
+    w->nodes++;
+    if ((w->nodes & (DFPN_CHECK_NODES - 1)) == 0 && deadline > 0
+        && now_ms() > deadline) {
+        stopped = true;
+    }
+    if (stopped) return;
+
+    uint64_t key = dfpn_key(own, opp, goal);
+    long start = w->nodes + w->leafNodes;
+    DfpnEntry e;
+    uint32_t work = lookup(key, &e) ? e.work : 0;
+    if (nthreads > 1) set_busy(key, 1);
+
+    // One child per move, or the pass.
+    uint64_t childOwn[MAX_MOVES], childOpp[MAX_MOVES];
+    int childMove[MAX_MOVES];
+    int n = 0;
+    uint64_t moves = bb_moves(own, opp);
+    if (moves == 0) {
+        childOwn[0] = opp;
+        childOpp[0] = own;
+        childMove[0] = -1;
+        n = 1;
+    }
+    for (; moves; moves &= moves - 1) {
+        int sq = bb_first(moves);
+        uint64_t flips = bb_flips(own, opp, sq);
+        childOwn[n] = opp & ~flips;
+        childOpp[n] = own | flips | (UINT64_C(1) << sq);
+        childMove[n] = sq;
+        n++;
+    }
+
+    int childGoal = -goal - 1;
+    uint32_t pn, dn;
+    int move = -1;
+    for (;;) {
+        uint32_t cpn[MAX_MOVES], cdn[MAX_MOVES];
+        int best = 0, virt = 0;
+        uint32_t dn2 = DFPN_INFINITY;
+        uint64_t v1 = UINT64_MAX, v2 = UINT64_MAX;
+        pn = DFPN_INFINITY;
+        dn = 0;
+        for (int i = 0; i < n; i++) {
+            int busy;
+            evaluate(w, childOwn[i], childOpp[i], childGoal, &cpn[i],
+                     &cdn[i], &busy);
+            dn = dfpn_add(dn, cpn[i]);
+            if (cdn[i] < pn) {
+                dn2 = pn;
+                pn = cdn[i];
+                best = i;
+            } else if (cdn[i] < dn2) {
+                dn2 = cdn[i];
+            }
+
+            // The child as it looks with the other threads inside it.
+            uint64_t v = (uint64_t)cdn[i] * (1 + busy) + busy;
+            if (v < v1) {
+                v2 = v1;
+                v1 = v;
+                virt = i;
+            } else if (v < v2) {
+                v2 = v;
+            }
+        }
+        if (pn == 0) {
+            move = childMove[best];
+            dn = DFPN_INFINITY;
+        }
+        if (pn >= thPn || dn >= thDn || stopped) break;
+
+        uint64_t next = (uint64_t)dn2 + dn2 / 4 + 1;
+        uint32_t childThDn = (next < thPn) ? (uint32_t)next : thPn;
+        if (virt != best) {
+            // Another thread is in the best child: take the one that looks
+            // best with it counted, if its thresholds leave it any room.
+            uint64_t vnext = v2 + v2 / 4 + 1;
+            uint32_t vthDn = (vnext < thPn) ? (uint32_t)vnext : thPn;
+            if (cdn[virt] < vthDn) {
+                best = virt;
+                childThDn = vthDn;
+            }
+        }
+        uint64_t childThPn = (uint64_t)thDn - dn + cpn[best];
+        if (childThPn > DFPN_INFINITY) childThPn = DFPN_INFINITY;
+
+        mid(w, childOwn[best], childOpp[best], childGoal,
+            (uint32_t)childThPn, childThDn, ply + 1);
+    }
+
+    long spent = w->nodes + w->leafNodes - start;
+    work = (work + spent < (long)DFPN_INFINITY) ? work + spent : DFPN_INFINITY;
+    store(key, pn, dn, work, move);
+    if (nthreads > 1) set_busy(key, -1);
+
+    if (ply == 0) {
+        rootPn = pn;
+        rootDn = dn;
+        rootMove = move;
+        if (pn == 0 || dn == 0) stopped = true;
+    }
+}
+
+void DfpnSolver::run(DfpnWorker *w) {
+    while (!stopped) {
+        mid(w, rootOwn, rootOpp, rootGoal, DFPN_INFINITY, DFPN_INFINITY, 0);
+    }
+}
+
+void *DfpnSolver::worker_main(void *arg) {
+    DfpnWorker *w = (DfpnWorker *)arg;
+    ((DfpnSolver *)w->solver)->run(w);
+    return NULL;
+}
+
+/*
+ * Tries to prove that the side to move (own) can finish more than goal
+ * discs ahead, for at most ms milliseconds if ms is positive. When proven,
+ * move is a move that does it (x + 8*y, or -1 to pass); otherwise -1.
+ */
+DfpnProof DfpnSolver::prove(uint64_t own, uint64_t opp, int goal, double ms,
+                            int *move) {
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].nodes = 0;
+        workers[i].leafNodes = 0;
+    }
+    *move = -1;
+
+    // Positions small enough for alpha-beta have no tree to search.
+    uint32_t pn, dn;
+    int busy;
+    if (64 - bb_count(own | opp) <= DFPN_LEAF_EMPTIES
+        || (bb_moves(own, opp) == 0 && bb_moves(opp, own) == 0)) {
+        evaluate(&workers[0], own, opp, goal, &pn, &dn, &busy);
+        if (pn == 0) {
+            DfpnEntry e;
+            if (lookup(dfpn_key(own, opp, goal), &e)) *move = e.move;
+            return DFPN_PROVEN;
+        }
+        return DFPN_DISPROVEN;
+    }
+
+    rootOwn = own;
+    rootOpp = opp;
+    rootGoal = goal;
+    deadline = (ms > 0) ? now_ms() + ms : 0;
+    stopped = false;
+    rootPn = rootDn = 1;
+    rootMove = -1;
+
+    // Search with the threads that start; the rest of the workers idle.
+    int started = 1;
+    while (started < nthreads
+           && pthread_create(&workers[started].thread, NULL, worker_main,
+                             &workers[started]) == 0) {
+        started++;
+    }
+    run(&workers[0]);
+    for (int i = 1; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+    // The threads race to record the root; the table has the last word.
+    DfpnEntry e;
+    if (lookup(dfpn_key(own, opp, goal), &e)) {
+        rootPn = e.pn;
+        rootDn = e.dn;
+        rootMove = e.move;
+    }
+    if (rootPn == 0) {
+        *move = rootMove;
+        return DFPN_PROVEN;
+    }
+    return (rootDn == 0) ? DFPN_DISPROVEN : DFPN_UNPROVEN;
+}
+
+/*
+ * Win, loss or draw for the side to move, proving a win first and then, if
+ * that fails, a draw. For a win or a draw, move is a move that secures it.
+ * Gives DFPN_UNKNOWN if ms (if positive) runs out first.
+ */
+DfpnResult DfpnSolver::solve(uint64_t own, uint64_t opp, double ms,
+                             int *move) {
+    double start = now_ms();
+    long nodes = 0, leafNodes = 0;
+    DfpnProof win = prove(own, opp, 0, ms, move);
+    if (win != DFPN_DISPROVEN) return (win == DFPN_PROVEN) ? DFPN_WIN
+                                                            : DFPN_UNKNOWN;
+
+    nodes = this->nodes();
+    leafNodes = this->leaf_nodes();
+    double left = ms - (now_ms() - start);
+    if (ms > 0 && left <= 0) return DFPN_UNKNOWN;
+    DfpnProof draw = prove(own, opp, -1, (ms > 0) ? left : 0, move);
+
+    // Count both proofs.
+    workers[0].nodes += nodes - leafNodes;
+    workers[0].leafNodes += leafNodes;
+    if (draw == DFPN_UNPROVEN) return DFPN_UNKNOWN;
+    return (draw == DFPN_PROVEN) ? DFPN_DRAW : DFPN_LOSS;
+}
+
+// Nodes of the last proof or solve, leaves included.
+long DfpnSolver::nodes() {
+    long total = 0;
+    for (int i = 0; i < nthreads; i++) {
+        total += workers[i].nodes + workers[i].leafNodes;
+    }
+    return total;
+}
+
+// Nodes spent in the alpha-beta leaf solves.
+long DfpnSolver::leaf_nodes() {
+    long total = 0;
+    for (int i = 0; i < nthreads; i++) total += workers[i].leafNodes;
+    return total;
+}
+
+const char *dfpn_result_name(DfpnResult r) {
+    switch (r) {
+    case DFPN_WIN:  return "win";
+    case DFPN_DRAW: return "draw";
+    case DFPN_LOSS: return "loss";
+    default:        return "unknown";
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef __DFPN_H__
+#define __DFPN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "bitboard.h"
+#include "endgame.h"
+
+/*
+ * Depth-first proof-number search (df-pn) for win/loss/draw solving.
+ *
+ * A proof number is a lower bound on the leaves that must still be solved
+ * to prove a node, the disproof number the same for disproving it. df-pn
+ * always expands the most proving node, as best-first proof-number search
+ * would, but depth first: it stays below a node until the node's numbers
+ * pass thresholds set by its siblings. In positions where one side is
+ * clearly winning this proves the result with far fewer nodes than an
+ * alpha-beta solve of the exact score.
+ *
+ * Nodes are stored negamax style: a node's proof number is for the side to
+ * move reaching its goal, a final disc difference greater than goal, and a
+ * child's goal is -goal - 1. Nodes with DFPN_LEAF_EMPTIES empties or fewer
+ * are settled by a null window alpha-beta solve instead of expanded.
+ *
+ * The table is fixed in size and replaces the entry that took the least
+ * work, so a long proof runs in bounded memory. With more than one thread
+ * every thread searches from the root through the shared table; a thread
+ * inside a node makes it look harder to the others (virtual proof numbers)
+ * so that they spread over different subtrees.
+ */
+
+#define DFPN_INFINITY       0x3FFFFFFFu
+
+// Default table size.
+#define DFPN_TABLE_BYTES    (64 << 20)
+
+// Nodes with this many empties or fewer are solved by alpha-beta, with a
+// table of this size for each thread.
+#define DFPN_LEAF_EMPTIES   10
+#define DFPN_LEAF_TT_BYTES  (1 << 20)
+
+// Time is checked every so many nodes.
+#define DFPN_CHECK_NODES    1024
+
+#define DFPN_BUCKET_ENTRIES 4
+#define DFPN_LOCKS          1024
+#define DFPN_MAX_THREADS    64
+
+enum DfpnProof { DFPN_DISPROVEN, DFPN_PROVEN, DFPN_UNPROVEN };
+
+enum DfpnResult { DFPN_LOSS = -1, DFPN_DRAW = 0, DFPN_WIN = 1, DFPN_UNKNOWN };
+
+struct DfpnEntry {
+    uint64_t key;       // 0 if empty
+    uint32_t pn;
+    uint32_t dn;
+    uint32_t work;      // nodes spent below this entry
+    int8_t move;        // a proving move once proven, else -1
+    uint8_t busy;       // threads searching below it
+    uint16_t unused;
+};
+
+struct DfpnWorker {
+    void *solver;
+    pthread_t thread;
+    long nodes;
+    long leafNodes;
+    EndgameSolver *leaf;
+};
+
+class DfpnSolver {
+
+private:
+    DfpnEntry *table;
+    size_t buckets;
+    pthread_mutex_t locks[DFPN_LOCKS];
+    DfpnWorker *workers;
+    int nthreads;
+
+    // The proof in progress.
+    uint64_t rootOwn, rootOpp;
+    int rootGoal;
+    double deadline;
+    volatile bool stopped;
+    uint32_t rootPn, rootDn;
+    int rootMove;
+
+    static void *worker_main(void *arg);
+    bool lookup(uint64_t key, DfpnEntry *out);
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint32_t work,
+               int move);
+    void set_busy(uint64_t key, int delta);
+    void evaluate(DfpnWorker *w, uint64_t own, uint64_t opp, int goal,
+                  uint32_t *pn, uint32_t *dn, int *busy);
+    void mid(DfpnWorker *w, uint64_t own, uint64_t opp, int goal,
+             uint32_t thPn, uint32_t thDn, int ply);
+    void run(DfpnWorker *w);
+
+public:
+    DfpnSolver(size_t tableBytes, int nthreads);
+    ~DfpnSolver();
+    DfpnProof prove(uint64_t own, uint64_t opp, int goal, double ms,
+                    int *move);
+    DfpnResult solve(uint64_t own, uint64_t opp, double ms, int *move);
+    void clear();
+    long nodes();
+    long leaf_nodes();
+    int threads() { return nthreads; }
+    size_t bytes() { return buckets * DFPN_BUCKET_ENTRIES
+                            * sizeof(DfpnEntry); }
+};
+
+const char *dfpn_result_name(DfpnResult r);
+
+#endif
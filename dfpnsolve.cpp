@@ -0,0 +1,110 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "dfpn.h"
+#include "positions.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Settles win, loss or draw for a batch of positions with the df-pn solver,
+ * one line per position, then totals. Positions come from a position file
+ * (see posgen), or are reached by random play from the start with a fixed
+ * seed when the first argument is a number of empties. Positions with up to
+ * DFPNSOLVE_CHECK_EMPTIES empties are also solved exactly by alpha-beta, to
+ * check the result and compare the time.
+ *
+ * usage: dfpnsolve positions.ops|empties [threads] [table MB]
+ *                  [ms per position] [count]
+ */
+
+#define DFPNSOLVE_CHECK_EMPTIES 20
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: dfpnsolve positions.ops|empties [threads] "
+                "[table MB] [ms per position] [count]\n");
+        return 1;
+    }
+    int threads = (argc > 2) ? atoi(argv[2]) : online_cpus();
+    size_t tableMb = (argc > 3) ? atoi(argv[3]) : DFPN_TABLE_BYTES >> 20;
+    double ms = (argc > 4) ? atof(argv[4]) : 0;
+    int count = (argc > 5) ? atoi(argv[5]) : 8;
+
+    vector<PositionRecord> positions;
+    char *end;
+    long empties = strtol(argv[1], &end, 10);
+    if (*end == '\0') {
+        uint64_t rng = POS_SEED;
+        for (int i = 0; i < count; i++) {
+            PositionRecord rec;
+            pos_random_position((int)empties, &rng, &rec.own, &rec.opp);
+            positions.push_back(rec);
+        }
+    } else {
+        PositionReader reader;
+        if (!reader.open(argv[1])) {
+            fprintf(stderr, "cannot read %s\n", argv[1]);
+            return 1;
+        }
+        PositionRecord rec;
+        while (reader.next(&rec)) positions.push_back(rec);
+    }
+
+    DfpnSolver solver(tableMb << 20, threads);
+    EndgameSolver exact(threads);
+    printf("%d threads, %lu MB table\n", solver.threads(),
+           (unsigned long)(solver.bytes() >> 20));
+    printf("    # empties  result  move        nodes  leaf%%    dfpn ms  "
+           "alpha-beta ms\n");
+
+    int results[4] = { 0, 0, 0, 0 };
+    int wrong = 0;
+    double dfpnMs = 0, exactMs = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        uint64_t own = positions[i].own, opp = positions[i].opp;
+        int e = 64 - bb_count(own | opp);
+
+        int move;
+        double start = now_ms();
+        DfpnResult r = solver.solve(own, opp, ms, &move);
+        double elapsed = now_ms() - start;
+        dfpnMs += elapsed;
+        results[r + 1]++;
+        long nodes = solver.nodes();
+
+        char check[64] = "";
+        if (e <= DFPNSOLVE_CHECK_EMPTIES) {
+            int m;
+            start = now_ms();
+            int score = exact.solve(own, opp, &m);
+            double t = now_ms() - start;
+            exactMs += t;
+            DfpnResult expected = (score > 0) ? DFPN_WIN
+                                  : (score < 0) ? DFPN_LOSS : DFPN_DRAW;
+            bool ok = (r == DFPN_UNKNOWN || r == expected);
+            if (!ok) wrong++;
+            snprintf(check, sizeof(check), "%14.1f%s", t,
+                     ok ? "" : "  WRONG");
+        }
+
+        printf("%5lu %7d  %-7s  %c%c %12ld %5.1f %10.1f %s\n",
+               (unsigned long)i, e, dfpn_result_name(r),
+               (move < 0) ? '-' : 'a' + move % 8,
+               (move < 0) ? '-' : '1' + move / 8, nodes,
+               100.0 * solver.leaf_nodes() / (nodes > 0 ? nodes : 1),
+               elapsed, check);
+        fflush(stdout);
+    }
+
+    printf("%d wins, %d draws, %d losses, %d unknown; df-pn %.1f ms",
+           results[DFPN_WIN + 1], results[DFPN_DRAW + 1],
+           results[DFPN_LOSS + 1], results[DFPN_UNKNOWN + 1], dfpnMs);
+    if (exactMs > 0) printf(", alpha-beta %.1f ms", exactMs);
+    printf("\n");
+    if (wrong > 0) {
+        printf("%d WRONG\n", wrong);
+        return 1;
+    }
+    return 0;
+}
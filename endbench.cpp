@@ -0,0 +1,60 @@
+#include <cstdio>
+#include <cstdlib>
+#include "endgame.h"
+#include "positions.h"
+#include "threadpool.h"
+
+/*
+ * Measures the parallel endgame solver against the same solver on one
+ * thread. Positions are reached by random play from the start with a fixed
+ * seed, so every run solves the same set.
+ *
+ * usage: endbench [threads] [min empties] [max empties] [positions]
+ */
+
+int main(int argc, char *argv[]) {
+    int threads = (argc > 1) ? atoi(argv[1]) : online_cpus();
+    int minEmpties = (argc > 2) ? atoi(argv[2]) : 12;
+    int maxEmpties = (argc > 3) ? atoi(argv[3]) : 20;
+    int positions = (argc > 4) ? atoi(argv[4]) : 4;
+    uint64_t rng = POS_SEED;
+
+    EndgameSolver serial(1);
+    EndgameSolver parallel(threads);
+    printf("%d threads, %d positions per row\n", parallel.threads(), positions);
+    printf("empties   serial ms parallel ms  speedup  efficiency  "
+           "serial nodes  parallel nodes\n");
+
+    for (int empties = minEmpties; empties <= maxEmpties; empties++) {
+        double serialMs = 0, parallelMs = 0;
+        long serialNodes = 0, parallelNodes = 0;
+
+        for (int i = 0; i < positions; i++) {
+            uint64_t own, opp;
+            pos_random_position(empties, &rng, &own, &opp);
+
+            int move1, move2;
+            double start = now_ms();
+            int score1 = serial.solve(own, opp, &move1);
+            serialMs += now_ms() - start;
+            serialNodes += serial.nodes();
+
+            start = now_ms();
+            int score2 = parallel.solve(own, opp, &move2);
+            parallelMs += now_ms() - start;
+            parallelNodes += parallel.nodes();
+
+            if (score1 != score2) {
+                printf("score mismatch at %d empties: %d vs %d\n", empties,
+                       score1, score2);
+                return 1;
+            }
+        }
+
+        double speedup = (parallelMs > 0) ? serialMs / parallelMs : 0;
+        printf("%7d %11.1f %11.1f %8.2f %11.2f %13ld %15ld\n", empties,
+               serialMs, parallelMs, speedup, speedup / parallel.threads(),
+               serialNodes, parallelNodes);
+    }
+    return 0;
+}
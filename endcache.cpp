@@ -0,0 +1,331 @@
+#include "endcache.h"
+#include "searchcache.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ENDCACHE_MAGIC      "OEC1"
+#define ENDCACHE_HEADER     16
+#define ENDCACHE_MIN_LOG2   12
+#define ENDCACHE_PROBES     8
+
+// The table is doubled once it is this full, which keeps nearly every
+// position within the probe window of its home slot.
+#define ENDCACHE_MAX_LOAD   0.7
+
+/*
+ * Home slot of a canonical position in a table of nslots (a power of two).
+ */
+static uint64_t home_slot(uint64_t own, uint64_t opp, uint64_t nslots) {
+    return position_key(own, opp, 0) & (nslots - 1);
+}
+
+/*
+ * Puts e in the first free slot of its probe window, or overwrites the same
+ * position if it is already there, unless that would replace an exact
+ * result with a proof. Returns false if the window is full.
+ */
+static bool insert_slot(EndCacheSlot *slots, uint64_t nslots,
+                        const EndCacheSlot &e, bool *added) {
+    uint64_t h = home_slot(e.own, e.opp, nslots);
+    for (int i = 0; i < ENDCACHE_PROBES; i++) {
+        EndCacheSlot *s = &slots[(h + i) & (nslots - 1)];
+        if (s->used && (s->own != e.own || s->opp != e.opp)) continue;
+        if (s->used && !s->proof && e.proof) {
+            *added = false;
+            return true;
+        }
+        // Other processes may be reading the mapped file, so the slot is
+        // marked used only once the rest of it is written.
+        *added = !s->used;
+        s->used = 0;
+        __sync_synchronize();
+        EndCacheSlot tmp = e;
+        tmp.used = 0;
+        *s = tmp;
+        __sync_synchronize();
+        s->used = 1;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Writes a fresh table of 2^log2 slots holding old (may be NULL) and the
+ * entries of extra to path. Doubles the size until everything fits.
+ */
+static bool write_table(const char *path, const EndCacheSlot *old,
+                        uint64_t oldSlots, const vector<EndCacheSlot> &extra,
+                        int log2) {
+    for (;; log2++) {
+        uint64_t nslots = UINT64_C(1) << log2;
+        uint64_t count = 0;
+        vector<EndCacheSlot> table(nslots);
+        memset(&table[0], 0, nslots * sizeof(EndCacheSlot));
+
+        bool fits = true;
+        bool added;
+        for (uint64_t i = 0; fits && i < oldSlots; i++) {
+            if (!old[i].used) continue;
+            fits = insert_slot(&table[0], nslots, old[i], &added);
+            count += added;
+        }
+        for (size_t i = 0; fits && i < extra.size(); i++) {
+            fits = insert_slot(&table[0], nslots, extra[i], &added);
+            count += added;
+        }
+        if (!fits || count > ENDCACHE_MAX_LOAD * nslots) continue;
+
+        char tmpPath[4096];
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp.%d", path, (int)getpid());
+        FILE *fp = fopen(tmpPath, "wb");
+        if (fp == NULL) return false;
+
+        char header[ENDCACHE_HEADER];
+        uint32_t log2_32 = log2;
+        memset(header, 0, sizeof(header));
+        memcpy(header, ENDCACHE_MAGIC, 4);
+        memcpy(header + 4, &log2_32, sizeof(log2_32));
+        memcpy(header + 8, &count, sizeof(count));
+        bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+            && fwrite(&table[0], sizeof(EndCacheSlot), nslots, fp) == nslots;
+        ok = (fclose(fp) == 0) && ok;
+        ok = ok && rename(tmpPath, path) == 0;
+        if (!ok) unlink(tmpPath);
+        return ok;
+    }
+}
+
+EndCache::EndCache() {
+    base = NULL;
+    mapSize = 0;
+    slots = NULL;
+    nslots = 0;
+}
+
+EndCache::~EndCache() {
+    close();
+}
+
+/*
+ * Maps the table at path read-only. A missing or invalid file leaves the
+ * cache empty; results added later are still kept for flush().
+ */
+bool EndCache::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < ENDCACHE_HEADER) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    char *b = (char *)p;
+    uint32_t log2;
+    memcpy(&log2, b + 4, sizeof(log2));
+    if (memcmp(b, ENDCACHE_MAGIC, 4) != 0 || log2 >= 40
+        || ENDCACHE_HEADER + (sizeof(EndCacheSlot) << log2)
+            > (uint64_t)st.st_size) {
+        munmap(p, st.st_size);
+        return false;
+    }
+
+    base = b;
+    mapSize = st.st_size;
+    slots = (EndCacheSlot *)(b + ENDCACHE_HEADER);
+    nslots = UINT64_C(1) << log2;
+    return true;
+}
+
+void EndCache::close() {
+    if (base != NULL) {
+        munmap(base, mapSize);
+        base = NULL;
+    }
+    mapSize = 0;
+    slots = NULL;
+    nslots = 0;
+}
+
+/*
+ * Finds the canonical position in the mapped table, or NULL.
+ */
+EndCacheSlot *EndCache::lookup(uint64_t own, uint64_t opp) {
+    if (slots == NULL) return NULL;
+    uint64_t h = home_slot(own, opp, nslots);
+    for (int i = 0; i < ENDCACHE_PROBES; i++) {
+        EndCacheSlot *s = &slots[(h + i) & (nslots - 1)];
+        if (!s->used) return NULL;
+        if (s->own == own && s->opp == opp) return s;
+    }
+    return NULL;
+}
+
+/*
+ * Finds the position with own to move, mapped or pending, and the transform
+ * that takes it to its canonical form.
+ */
+const EndCacheSlot *EndCache::find(uint64_t own, uint64_t opp, int *t) {
+    uint64_t cOwn, cOpp;
+    *t = bb_canonical(own, opp, &cOwn, &cOpp);
+
+    const EndCacheSlot *s = lookup(cOwn, cOpp);
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i].own == cOwn && pending[i].opp == cOpp
+            && (s == NULL || s->proof || !pending[i].proof)) {
+            s = &pending[i];
+        }
+    }
+    return s;
+}
+
+/*
+ * Looks up the position with own to move. On a hit, stores the exact final
+ * disc difference for own and the best move (-1 to pass) in own's frame.
+ */
+bool EndCache::probe(uint64_t own, uint64_t opp, int *score, int *move) {
+    int t;
+    const EndCacheSlot *s = find(own, opp, &t);
+    if (s == NULL || s->proof) return false;
+
+    *score = s->score;
+    *move = (s->move < 0) ? -1 : bb_untransform_square(s->move, t);
+    return true;
+}
+
+/*
+ * Looks up whether own, to move, wins (1), draws (0) or loses (-1), from a
+ * proof or an exact result. On a hit, move is the move that secures a win
+ * or a draw (-1 to pass, or after a loss).
+ */
+bool EndCache::probe_outcome(uint64_t own, uint64_t opp, int *outcome,
+                             int *move) {
+    int t;
+    const EndCacheSlot *s = find(own, opp, &t);
+    if (s == NULL) return false;
+
+    *outcome = (s->score > 0) - (s->score < 0);
+    *move = (s->move < 0) ? -1 : bb_untransform_square(s->move, t);
+    return true;
+}
+
+/*
+ * Queues a result for the position with own to move until flush().
+ */
+void EndCache::queue(uint64_t own, uint64_t opp, int score, int move,
+                     bool proof) {
+    EndCacheSlot e;
+    memset(&e, 0, sizeof(e));
+    int t = bb_canonical(own, opp, &e.own, &e.opp);
+    e.score = score;
+    e.move = (move < 0) ? -1 : bb_first(bb_transform(UINT64_C(1) << move, t));
+    e.empties = 64 - bb_count(own | opp);
+    e.used = 1;
+    e.proof = proof;
+    pending.push_back(e);
+}
+
+/*
+ * Records an exact result for the position with own to move. It is kept in
+ * memory until flush().
+ */
+void EndCache::add(uint64_t own, uint64_t opp, int score, int move) {
+    queue(own, opp, score, move, false);
+}
+
+/*
+ * Records a proven outcome (1 win, 0 draw, -1 loss for own, to move) and the
+ * move that secures it, for positions too far from the end to solve
+ * exactly. It is kept in memory until flush().
+ */
+void EndCache::add_proof(uint64_t own, uint64_t opp, int outcome, int move) {
+    queue(own, opp, outcome, move, true);
+}
+
+/*
+ * Writes the results added since the last flush into the table at path.
+ * Under a lock on path.lock, new entries go straight into free slots of the
+ * existing file; only when the table is too full is it rebuilt at twice the
+ * size and swapped in with a rename.
+ */
+bool EndCache::flush(const char *path) {
+    if (pending.empty()) return true;
+
+    string lockPath = string(path) + ".lock";
+    int lockfd = ::open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lockfd < 0) return false;
+    flock(lockfd, LOCK_EX);
+
+    bool ok = false;
+    int fd = ::open(path, O_RDWR);
+    struct stat st;
+    void *p = MAP_FAILED;
+    uint32_t log2 = 0;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= ENDCACHE_HEADER) {
+        p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) ::close(fd);
+
+    if (p != MAP_FAILED) {
+        char *b = (char *)p;
+        memcpy(&log2, b + 4, sizeof(log2));
+        if (memcmp(b, ENDCACHE_MAGIC, 4) != 0 || log2 >= 40
+            || ENDCACHE_HEADER + (sizeof(EndCacheSlot) << log2)
+                > (uint64_t)st.st_size) {
+            munmap(p, st.st_size);
+            p = MAP_FAILED;
+        }
+    }
+
+    if (p != MAP_FAILED) {
+        char *b = (char *)p;
+        EndCacheSlot *table = (EndCacheSlot *)(b + ENDCACHE_HEADER);
+        uint64_t n = UINT64_C(1) << log2;
+        uint64_t count;
+        memcpy(&count, b + 8, sizeof(count));
+
+        // Fill in place while there is room; whatever does not fit forces a
+        // rebuild along with the rest of the table.
+        vector<EndCacheSlot> rest;
+        for (size_t i = 0; i < pending.size(); i++) {
+            bool added = false;
+            if (count + 1 > ENDCACHE_MAX_LOAD * n
+                || !insert_slot(table, n, pending[i], &added)) {
+                rest.push_back(pending[i]);
+            }
+            count += added;
+        }
+        memcpy(b + 8, &count, sizeof(count));
+
+        ok = rest.empty() || write_table(path, table, n, rest, log2 + 1);
+        munmap(p, st.st_size);
+    } else {
+        ok = write_table(path, NULL, 0, pending, ENDCACHE_MIN_LOG2);
+    }
+
+    flock(lockfd, LOCK_UN);
+    ::close(lockfd);
+    if (ok) {
+        pending.clear();
+        open(path);
+    }
+    return ok;
+}
+
+// Number of positions known, counting those not yet flushed.
+uint64_t EndCache::size() {
+    uint64_t count = 0;
+    if (base != NULL) memcpy(&count, base + 8, sizeof(count));
+    return count + pending.size();
+}
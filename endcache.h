@@ -0,0 +1,63 @@
+#ifndef __ENDCACHE_H__
+#define __ENDCACHE_H__
+
+#include <vector>
+#include <stdint.h>
+#include "bitboard.h"
+using namespace std;
+
+// Solves with fewer empties than this are cheaper to redo than to store.
+#define ENDCACHE_MIN_EMPTIES    10
+
+/*
+ * One solved position in canonical form (the smallest of its 8 symmetric
+ * images), with the side to move owning own. Exact solves only reach the
+ * endgame solver's depth; proofs (win, draw or loss, from proof-number
+ * search) keep positions further from the end.
+ */
+struct EndCacheSlot {
+    uint64_t own;
+    uint64_t opp;
+    int8_t score;       // exact final disc difference for the side to move,
+                        // or for a proof 1, 0 or -1 for a win, draw or loss
+    int8_t move;        // best move in canonical coordinates, -1 to pass
+    int8_t empties;
+    int8_t used;
+    int8_t proof;       // 1 if score is only a proof's outcome
+    int8_t pad[3];
+};
+
+/*
+ * Exact endgame results kept on disk. The file is an open-addressing hash
+ * table mapped into memory: a lookup hashes the canonical position and
+ * checks a few consecutive slots, so it costs O(1) and reads nothing else.
+ * New results are written into free slots in place; the table is only
+ * rebuilt, at twice the size, when it gets too full.
+ */
+class EndCache {
+
+private:
+    char *base;
+    size_t mapSize;
+    EndCacheSlot *slots;
+    uint64_t nslots;
+    vector<EndCacheSlot> pending;
+
+    EndCacheSlot *lookup(uint64_t own, uint64_t opp);
+    const EndCacheSlot *find(uint64_t own, uint64_t opp, int *t);
+    void queue(uint64_t own, uint64_t opp, int score, int move, bool proof);
+
+public:
+    EndCache();
+    ~EndCache();
+    bool open(const char *path);
+    void close();
+    bool probe(uint64_t own, uint64_t opp, int *score, int *move);
+    bool probe_outcome(uint64_t own, uint64_t opp, int *outcome, int *move);
+    void add(uint64_t own, uint64_t opp, int score, int move);
+    void add_proof(uint64_t own, uint64_t opp, int outcome, int move);
+    bool flush(const char *path);
+    uint64_t size();
+};
+
+#endif
@@ -0,0 +1,482 @@
+#include "endgame.h"
+#include <sched.h>
+#include "perfcount.h"
+
+/*
+ * Final score of a finished game, from the point of view of the side owning
+ * own. Empty squares are counted for the winner.
+ */
+int endgame_final_score(uint64_t own, uint64_t opp) {
+    return BoardGeometry<8>::final_score(own, opp);
+}
+
+/*
+ * Fills list with the moves in the bitboard moves, ordered so that the moves
+ * leaving the opponent the fewest replies come first (corners break ties).
+ * If tt is given, the table entries of the positions after each move are
+ * prefetched. Returns the number of moves.
+ */
+template <int N>
+static int order_moves(uint64_t own, uint64_t opp, uint64_t moves, int *list,
+                       TTable *tt) {
+    typedef BoardGeometry<N> G;
+    int keys[MAX_MOVES];
+    int n = 0;
+    while (moves) {
+        int sq = bb_first(moves);
+        moves &= moves - 1;
+        uint64_t flips = G::flips(own, opp, sq);
+        uint64_t newOwn = own | flips | (UINT64_C(1) << sq);
+        uint64_t newOpp = opp & ~flips;
+        if (tt != NULL) tt->prefetch(tt_key(newOpp, newOwn));
+        PERF_BEGIN(PERF_MOVEGEN);
+        int key = 2 * bb_count(G::moves(newOpp, newOwn));
+        PERF_END(PERF_MOVEGEN);
+        if ((UINT64_C(1) << sq) & G::CORNERS) key -= 1;
+
+        int i = n++;
+        while (i > 0 && keys[i - 1] > key) {
+            keys[i] = keys[i - 1];
+            list[i] = list[i - 1];
+            i--;
+        }
+        keys[i] = key;
+        list[i] = sq;
+    }
+    return n;
+}
+
+/*
+ * True if the split point or any split point above it has been cut off, in
+ * which case results computed under it are meaningless.
+ */
+static bool aborted(SplitPoint *sp) {
+    for (; sp != NULL; sp = sp->parent) {
+        if (sp->stop) return true;
+    }
+    return false;
+}
+
+/*
+ * Starts nthreads - 1 helper threads, or as many as the system allows; the
+ * thread calling solve() is the remaining one. The threads share a table of
+ * tableBytes.
+ */
+template <int N>
+EndgameSolverT<N>::EndgameSolverT(int nthreads, size_t tableBytes) {
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > ENDGAME_MAX_THREADS) nthreads = ENDGAME_MAX_THREADS;
+    this->nthreads = nthreads;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&wake, NULL);
+    active = false;
+    quitting = false;
+
+    table = new TTable(tableBytes, true);
+    workers = new EndgameWorker[nthreads];
+    for (int i = 0; i < nthreads; i++) {
+        EndgameWorker *w = &workers[i];
+        w->solver = this;
+        w->id = i;
+        w->nodes = 0;
+        w->dequeSize = 0;
+        pthread_mutex_init(&w->dequeLock, NULL);
+        for (int j = 0; j < ENDGAME_MAX_PLY; j++) {
+            pthread_mutex_init(&w->splits[j].lock, NULL);
+        }
+    }
+    for (int i = 1; i < nthreads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, idle_loop, &workers[i])
+            != 0) {
+            // Solve with the threads that did start.
+            this->nthreads = i;
+            break;
+        }
+    }
+}
+
+template <int N>
+EndgameSolverT<N>::~EndgameSolverT() {
+    pthread_mutex_lock(&lock);
+    quitting = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    for (int i = 1; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_destroy(&workers[i].dequeLock);
+        for (int j = 0; j < ENDGAME_MAX_PLY; j++) {
+            pthread_mutex_destroy(&workers[i].splits[j].lock);
+        }
+    }
+    delete[] workers;
+    delete table;
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&lock);
+}
+
+/*
+ * Helper threads sleep until a solve starts, then keep looking for split
+ * points to join until it ends.
+ */
+template <int N>
+void *EndgameSolverT<N>::idle_loop(void *arg) {
+    EndgameWorker *w = (EndgameWorker *)arg;
+    EndgameSolverT *solver = (EndgameSolverT *)w->solver;
+
+    for (;;) {
+        pthread_mutex_lock(&solver->lock);
+        while (!solver->active && !solver->quitting) {
+            pthread_cond_wait(&solver->wake, &solver->lock);
+        }
+        bool quit = solver->quitting;
+        pthread_mutex_unlock(&solver->lock);
+        if (quit) return NULL;
+
+        if (!solver->steal(w)) sched_yield();
+    }
+}
+
+/*
+ * Joins the oldest open split point of another thread, which is the one with
+ * the most work left under it. Returns false if there was nothing to join.
+ */
+template <int N>
+bool EndgameSolverT<N>::steal(EndgameWorker *w) {
+    for (int k = 1; k < nthreads; k++) {
+        EndgameWorker *victim = &workers[(w->id + k) % nthreads];
+        if (victim->dequeSize == 0) continue;
+
+        SplitPoint *found = NULL;
+        pthread_mutex_lock(&victim->dequeLock);
+        for (int j = 0; j < victim->dequeSize && found == NULL; j++) {
+            SplitPoint *sp = victim->deque[j];
+            pthread_mutex_lock(&sp->lock);
+            if (sp->next < sp->nmoves && !aborted(sp)) {
+                sp->workers++;
+                found = sp;
+            }
+            pthread_mutex_unlock(&sp->lock);
+        }
+        pthread_mutex_unlock(&victim->dequeLock);
+
+        if (found != NULL) {
+            help(w, found, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Searches moves of a split point until none are left, then leaves it.
+ * Children are searched from the given ply of w's own stack.
+ */
+template <int N>
+void EndgameSolverT<N>::help(EndgameWorker *w, SplitPoint *sp, int ply) {
+    for (;;) {
+        pthread_mutex_lock(&sp->lock);
+        if (sp->next >= sp->nmoves || aborted(sp)) {
+            pthread_mutex_unlock(&sp->lock);
+            break;
+        }
+        int sq = sp->moves[sp->next++];
+        int alpha = sp->alpha;
+        int beta = sp->beta;
+        pthread_mutex_unlock(&sp->lock);
+
+        uint64_t flips = Geometry::flips(sp->own, sp->opp, sq);
+        uint64_t own = sp->own | flips | (UINT64_C(1) << sq);
+        uint64_t opp = sp->opp & ~flips;
+        int score = -search(w, opp, own, -beta, -alpha, sp->empties - 1, ply,
+                            sp, NULL);
+
+        pthread_mutex_lock(&sp->lock);
+        if (!aborted(sp) && score > sp->best) {
+            sp->best = score;
+            sp->bestMove = sq;
+            if (score > sp->alpha) sp->alpha = score;
+            if (score >= sp->beta) sp->stop = true;
+        }
+        pthread_mutex_unlock(&sp->lock);
+    }
+
+    pthread_mutex_lock(&sp->lock);
+    sp->workers--;
+    pthread_mutex_unlock(&sp->lock);
+}
+
+/*
+ * Serial alpha-beta for the last few empties. Uses only w's preallocated
+ * move stack.
+ */
+template <int N>
+int EndgameSolverT<N>::solveSerial(EndgameWorker *w, uint64_t own,
+                                   uint64_t opp, int alpha, int beta,
+                                   int empties, int ply) {
+    w->nodes++;
+    PERF_NODE();
+    PERF_BEGIN(PERF_MOVEGEN);
+    uint64_t moves = Geometry::moves(own, opp);
+    PERF_END(PERF_MOVEGEN);
+    if (moves == 0) {
+        if (Geometry::moves(opp, own) == 0) {
+            return Geometry::final_score(own, opp);
+        }
+        return -solveSerial(w, opp, own, -beta, -alpha, empties, ply + 1);
+    }
+
+    int best = -65;
+    if (empties >= ENDGAME_SORT_EMPTIES) {
+        int *list = w->moveStack[ply];
+        int n = order_moves<N>(own, opp, moves, list, NULL);
+        for (int i = 0; i < n; i++) {
+            int sq = list[i];
+            uint64_t flips = Geometry::flips(own, opp, sq);
+            int score = -solveSerial(w, opp & ~flips,
+                                     own | flips | (UINT64_C(1) << sq),
+                                     -beta, -alpha, empties - 1, ply + 1);
+            if (score > best) {
+                best = score;
+                if (score > alpha) alpha = score;
+                if (score >= beta) break;
+            }
+        }
+    } else {
+        while (moves) {
+            int sq = bb_first(moves);
+            moves &= moves - 1;
+            uint64_t flips = Geometry::flips(own, opp, sq);
+            int score = -solveSerial(w, opp & ~flips,
+                                     own | flips | (UINT64_C(1) << sq),
+                                     -beta, -alpha, empties - 1, ply + 1);
+            if (score > best) {
+                best = score;
+                if (score > alpha) alpha = score;
+                if (score >= beta) break;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Parallel alpha-beta. The first move of a node is always searched by the
+ * thread that owns the node; only then are the remaining moves offered to
+ * other threads through a split point. ctx is the split point this subtree
+ * belongs to (NULL at the root); bestMove is only requested at the root.
+ *
+ * Results are shared between threads through the transposition table. A
+ * subtree cut off by an abort returns a meaningless score, so nothing is
+ * stored once ctx has been aborted.
+ */
+template <int N>
+int EndgameSolverT<N>::search(EndgameWorker *w, uint64_t own, uint64_t opp,
+                              int alpha, int beta, int empties, int ply,
+                              SplitPoint *ctx, int *bestMove) {
+    if (empties < ENDGAME_SPLIT_EMPTIES && bestMove == NULL) {
+        return solveSerial(w, own, opp, alpha, beta, empties, ply);
+    }
+    w->nodes++;
+    PERF_NODE();
+    if (aborted(ctx)) return 0;
+
+    PERF_BEGIN(PERF_MOVEGEN);
+    uint64_t moves = Geometry::moves(own, opp);
+    PERF_END(PERF_MOVEGEN);
+    if (moves == 0) {
+        if (bestMove != NULL) *bestMove = -1;
+        if (Geometry::moves(opp, own) == 0) {
+            return Geometry::final_score(own, opp);
+        }
+        return -search(w, opp, own, -beta, -alpha, empties, ply + 1, ctx,
+                       NULL);
+    }
+
+    uint64_t key = tt_key(own, opp);
+    TTData hit;
+    int ttMove = -1;
+    PERF_BEGIN(PERF_TT);
+    bool found = table->probe(key, &hit);
+    PERF_END(PERF_TT);
+    if (found) {
+        // The root must come back with a move, so it only uses the entry
+        // for ordering.
+        if (bestMove == NULL) {
+            if (hit.lower >= beta || hit.lower == hit.upper) return hit.lower;
+            if (hit.upper <= alpha) return hit.upper;
+            if (hit.lower > alpha) alpha = hit.lower;
+            if (hit.upper < beta) beta = hit.upper;
+        }
+        ttMove = hit.move;
+    }
+    int alphaIn = alpha;
+
+    int *list = w->moveStack[ply];
+    int n = order_moves<N>(own, opp, moves, list, table);
+    for (int i = 1; i < n; i++) {
+        if (list[i] == ttMove) {
+            for (; i > 0; i--) list[i] = list[i - 1];
+            list[0] = ttMove;
+            break;
+        }
+    }
+
+    // The eldest brother is searched alone.
+    uint64_t flips = Geometry::flips(own, opp, list[0]);
+    int best = -search(w, opp & ~flips, own | flips | (UINT64_C(1) << list[0]),
+                       -beta, -alpha, empties - 1, ply + 1, ctx, NULL);
+    int bm = list[0];
+    if (best > alpha) alpha = best;
+
+    if (best < beta && n > 1) {
+        if (nthreads == 1 || empties < ENDGAME_SPLIT_EMPTIES) {
+            for (int i = 1; i < n && best < beta; i++) {
+                int sq = list[i];
+                flips = Geometry::flips(own, opp, sq);
+                int score = -search(w, opp & ~flips,
+                                    own | flips | (UINT64_C(1) << sq),
+                                    -beta, -alpha, empties - 1, ply + 1, ctx,
+                                    NULL);
+                if (score > best) {
+                    best = score;
+                    bm = sq;
+                    if (score > alpha) alpha = score;
+                }
+            }
+        } else {
+            SplitPoint *sp = &w->splits[ply];
+            sp->parent = ctx;
+            sp->own = own;
+            sp->opp = opp;
+            for (int i = 1; i < n; i++) sp->moves[i - 1] = list[i];
+            sp->nmoves = n - 1;
+            sp->next = 0;
+            sp->empties = empties;
+            sp->alpha = alpha;
+            sp->beta = beta;
+            sp->best = best;
+            sp->bestMove = bm;
+            sp->workers = 1;
+            sp->stop = false;
+
+            pthread_mutex_lock(&w->dequeLock);
+            w->deque[w->dequeSize++] = sp;
+            pthread_mutex_unlock(&w->dequeLock);
+
+            help(w, sp, ply + 1);
+
+            pthread_mutex_lock(&w->dequeLock);
+            w->dequeSize--;
+            pthread_mutex_unlock(&w->dequeLock);
+
+            while (sp->workers > 0) sched_yield();
+
+            best = sp->best;
+            bm = sp->bestMove;
+        }
+    }
+
+    if (!aborted(ctx)) {
+        table->store(key, (best > alphaIn) ? best : -64,
+                     (best < beta) ? best : 64, bm, empties);
+    }
+    if (bestMove != NULL) *bestMove = bm;
+    return best;
+}
+
+/*
+ * Solves the position exactly. Returns the score for the side owning own and
+ * stores the best square (x + 8*y, or -1 to pass) in bestMove.
+ */
+template <int N>
+int EndgameSolverT<N>::solve(uint64_t own, uint64_t opp, int *bestMove) {
+    return solve(own, opp, -64, 64, bestMove);
+}
+
+/*
+ * Solves within the window (alpha, beta): the result is exact if it lies
+ * strictly inside the window, and otherwise a bound on the wrong side of it.
+ */
+template <int N>
+int EndgameSolverT<N>::solve(uint64_t own, uint64_t opp, int alpha, int beta,
+                             int *bestMove) {
+    for (int i = 0; i < nthreads; i++) workers[i].nodes = 0;
+    table->new_search();
+    return run(own, opp, alpha, beta, bestMove);
+}
+
+/*
+ * Solves the position exactly with a sequence of null window searches
+ * (MTD(f)) starting from the guess. Each pass only has to prove a bound, and
+ * the passes share their work through the table, so for deep solves this is
+ * usually much cheaper than one full window search. Nodes are summed over
+ * the passes.
+ */
+template <int N>
+int EndgameSolverT<N>::solve_mtd(uint64_t own, uint64_t opp, int guess,
+                                 int *bestMove) {
+    for (int i = 0; i < nthreads; i++) workers[i].nodes = 0;
+    table->new_search();
+
+    int lower = -64, upper = 64;
+    int score = guess;
+    int move = -1;
+    while (lower < upper) {
+        int beta = (score == lower) ? score + 1 : score;
+        int m;
+        score = run(own, opp, beta - 1, beta, &m);
+        // Only a fail high proves that its move reaches the bound.
+        if (score >= beta) {
+            lower = score;
+            move = m;
+        } else {
+            upper = score;
+            if (move == -1) move = m;
+        }
+    }
+    if (bestMove != NULL) *bestMove = move;
+    return score;
+}
+
+/*
+ * One search of the root with the helper threads awake. Node counts keep
+ * adding up until the caller resets them.
+ */
+template <int N>
+int EndgameSolverT<N>::run(uint64_t own, uint64_t opp, int alpha, int beta,
+                           int *bestMove) {
+    pthread_mutex_lock(&lock);
+    active = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    int empties = Geometry::empties(own, opp);
+    int move = -1;
+    int score = search(&workers[0], own, opp, alpha, beta, empties, 0, NULL,
+                       &move);
+
+    pthread_mutex_lock(&lock);
+    active = false;
+    pthread_mutex_unlock(&lock);
+
+    if (bestMove != NULL) *bestMove = move;
+    return score;
+}
+
+/*
+ * Nodes searched by all threads during the last solve.
+ */
+template <int N>
+long EndgameSolverT<N>::nodes() {
+    long total = 0;
+    for (int i = 0; i < nthreads; i++) total += workers[i].nodes;
+    return total;
+}
+
+template class EndgameSolverT<4>;
+template class EndgameSolverT<6>;
+template class EndgameSolverT<8>;
@@ -0,0 +1,111 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "bitboard.h"
+#include "boardgeom.h"
+#include "ttable.h"
+
+// Positions with this many empties or fewer are solved exactly by the
+// player, unless the parameter file says otherwise.
+#define ENDGAME_EMPTIES         12
+
+// Nodes with fewer empties than this are searched serially.
+#define ENDGAME_SPLIT_EMPTIES   9
+
+// Below this many empties moves are searched in board order.
+#define ENDGAME_SORT_EMPTIES    6
+
+// Size of the transposition table shared by the solver's threads. Entries
+// are exact bounds, so they stay valid from one solve to the next.
+#define ENDGAME_TT_BYTES        (16 << 20)
+
+#define ENDGAME_MAX_PLY         128
+#define ENDGAME_MAX_THREADS     64
+
+/*
+ * A node whose remaining moves may be searched by several threads
+ * (young brothers wait: a node is only split after its first move has been
+ * searched). It lives on the owner's stack until every helper has left.
+ */
+struct SplitPoint {
+    SplitPoint *parent;
+    pthread_mutex_t lock;
+    uint64_t own, opp;
+    int moves[MAX_MOVES];
+    int nmoves;
+    int next;
+    int empties;
+    int alpha, beta;
+    int best, bestMove;
+    volatile int workers;
+    volatile bool stop;
+};
+
+/*
+ * Per-thread state. Everything a search needs is preallocated here, indexed
+ * by ply, so the hot path never allocates.
+ */
+struct EndgameWorker {
+    void *solver;
+    int id;
+    pthread_t thread;
+    long nodes;
+
+    // Split points this thread has opened and that thieves may still join,
+    // oldest first.
+    pthread_mutex_t dequeLock;
+    SplitPoint *deque[ENDGAME_MAX_PLY];
+    volatile int dequeSize;
+
+    SplitPoint splits[ENDGAME_MAX_PLY];
+    int moveStack[ENDGAME_MAX_PLY][MAX_MOVES];
+};
+
+/*
+ * Exact endgame solver for an N x N board (see boardgeom.h). Scores are
+ * final disc differences from the point of view of the side to move, with
+ * empty squares going to the winner. Instantiated for N = 4, 6 and 8.
+ */
+template <int N>
+class EndgameSolverT {
+
+private:
+    EndgameWorker *workers;
+    int nthreads;
+    TTable *table;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    volatile bool active;
+    volatile bool quitting;
+
+    static void *idle_loop(void *arg);
+    bool steal(EndgameWorker *w);
+    void help(EndgameWorker *w, SplitPoint *sp, int ply);
+    int search(EndgameWorker *w, uint64_t own, uint64_t opp, int alpha,
+               int beta, int empties, int ply, SplitPoint *ctx,
+               int *bestMove);
+    int solveSerial(EndgameWorker *w, uint64_t own, uint64_t opp, int alpha,
+                    int beta, int empties, int ply);
+    int run(uint64_t own, uint64_t opp, int alpha, int beta, int *bestMove);
+
+public:
+    typedef BoardGeometry<N> Geometry;
+
+    EndgameSolverT(int nthreads, size_t tableBytes = ENDGAME_TT_BYTES);
+    ~EndgameSolverT();
+    int solve(uint64_t own, uint64_t opp, int *bestMove);
+    int solve(uint64_t own, uint64_t opp, int alpha, int beta,
+              int *bestMove);
+    int solve_mtd(uint64_t own, uint64_t opp, int guess, int *bestMove);
+    long nodes();
+    int threads() { return nthreads; }
+};
+
+typedef EndgameSolverT<8> EndgameSolver;
+
+int endgame_final_score(uint64_t own, uint64_t opp);
+
+#endif
@@ -0,0 +1,75 @@
+#include "engine.h"
+#include <cstring>
+
+template <class Eval, class Order, class Table, int algorithm>
+static Engine *create() {
+    PolicyEngine<Eval, Order, Table> *engine =
+        new PolicyEngine<Eval, Order, Table>(SEARCH_TT_BYTES);
+    engine->algorithm = (SearchAlgorithm)algorithm;
+    return engine;
+}
+
+// Player searches MODE_SEARCH entries with its own Search, which has the
+// network and tuned weights; what they create is Search as it starts out.
+const EngineEntry engine_registry[] = {
+    { "minimax", "two move minimax on score_move (default)", MODE_MINIMAX,
+      SEARCH_PVS, NULL },
+    { "random", "a random legal move", MODE_RANDOM, SEARCH_PVS, NULL },
+    { "greedy", "the best move by score_move, one ply", MODE_GREEDY,
+      SEARCH_PVS, NULL },
+    { "mcts", "Monte Carlo tree search", MODE_MCTS, SEARCH_PVS, NULL },
+    { "alphabeta", "Search, full window alpha-beta", MODE_SEARCH,
+      SEARCH_ALPHABETA,
+      create<NetworkEval, MobilityOrder, TTable, SEARCH_ALPHABETA> },
+    { "pvs", "Search, principal variation search", MODE_SEARCH, SEARCH_PVS,
+      create<NetworkEval, MobilityOrder, TTable, SEARCH_PVS> },
+    { "aspiration", "Search, PVS with aspiration windows", MODE_SEARCH,
+      SEARCH_ASPIRATION,
+      create<NetworkEval, MobilityOrder, TTable, SEARCH_ASPIRATION> },
+    { "mtdf", "Search, MTD(f)", MODE_SEARCH, SEARCH_MTDF,
+      create<NetworkEval, MobilityOrder, TTable, SEARCH_MTDF> },
+    { "disc/board/none", "policy PVS: disc count, board order, no table",
+      MODE_POLICY, SEARCH_PVS,
+      create<DiscEval, BoardOrder, NoTable, SEARCH_PVS> },
+    { "disc/board/tt", "policy PVS: disc count, board order, table",
+      MODE_POLICY, SEARCH_PVS,
+      create<DiscEval, BoardOrder, TTable, SEARCH_PVS> },
+    { "disc/mobility/none", "policy PVS: disc count, mobility order, no table",
+      MODE_POLICY, SEARCH_PVS,
+      create<DiscEval, MobilityOrder, NoTable, SEARCH_PVS> },
+    { "disc/mobility/tt", "policy PVS: disc count, mobility order, table",
+      MODE_POLICY, SEARCH_PVS,
+      create<DiscEval, MobilityOrder, TTable, SEARCH_PVS> },
+    { "eval/board/none", "policy PVS: handcrafted, board order, no table",
+      MODE_POLICY, SEARCH_PVS,
+      create<HandcraftedEval, BoardOrder, NoTable, SEARCH_PVS> },
+    { "eval/board/tt", "policy PVS: handcrafted, board order, table",
+      MODE_POLICY, SEARCH_PVS,
+      create<HandcraftedEval, BoardOrder, TTable, SEARCH_PVS> },
+    { "eval/mobility/none", "policy PVS: handcrafted, mobility order, "
+      "no table", MODE_POLICY, SEARCH_PVS,
+      create<HandcraftedEval, MobilityOrder, NoTable, SEARCH_PVS> },
+    { "eval/mobility/tt", "policy PVS: handcrafted, mobility order, table",
+      MODE_POLICY, SEARCH_PVS,
+      create<HandcraftedEval, MobilityOrder, TTable, SEARCH_PVS> }
+};
+
+const int engine_count = sizeof(engine_registry) / sizeof(engine_registry[0]);
+
+const EngineEntry *engine_find(const char *name) {
+    for (int i = 0; i < engine_count; i++) {
+        if (!strcmp(name, engine_registry[i].name)) return &engine_registry[i];
+    }
+    return NULL;
+}
+
+/*
+ * Prints the engine names and what they are, one to a line.
+ */
+void engine_list(ostream &out) {
+    for (int i = 0; i < engine_count; i++) {
+        out << "  " << engine_registry[i].name;
+        for (int k = strlen(engine_registry[i].name); k < 20; k++) out << ' ';
+        out << engine_registry[i].description << endl;
+    }
+}
@@ -0,0 +1,306 @@
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include <iostream>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+#include "eval.h"
+#include "nneval.h"
+#include "perfcount.h"
+#include "search.h"
+#include "searchtrace.h"
+#include "ttable.h"
+using namespace std;
+
+/*
+ * Search engines composed at compile time from policies.
+ *
+ * PolicyEngine is an iterative deepening alpha-beta search templated on
+ * three policies: the evaluator that scores leaves, the orderer that sorts
+ * the moves of a node, and the table that remembers results between nodes.
+ * Policies are plain classes whose methods the search calls directly, so
+ * each combination compiles to its own fully inlined search with no
+ * virtual calls below the root. The one virtual call per move is
+ * Engine::run. Search (search.h) is the combination the player uses; the
+ * others are registered below. The member definitions are in search.cpp,
+ * which instantiates every registered combination.
+ */
+
+/*
+ * Evaluators: score(own, opp, ply, side) from the point of view of own, to
+ * move. side is the side to move as an accumulator index; refresh() is
+ * called on the root position (own being BLACK), update() on every move
+ * from ply to ply + 1 and pass() on every pass, for evaluators that keep
+ * state along the line being searched.
+ */
+
+// Disc difference only.
+class DiscEval {
+
+public:
+    void refresh(uint64_t own, uint64_t opp) {
+        (void)own;
+        (void)opp;
+    }
+    void update(int ply, int side, int sq, uint64_t flips) {
+        (void)ply;
+        (void)side;
+        (void)sq;
+        (void)flips;
+    }
+    void pass(int ply) { (void)ply; }
+    int score(uint64_t own, uint64_t opp, int ply, int side) {
+        (void)ply;
+        (void)side;
+        return bb_count(own) - bb_count(opp);
+    }
+};
+
+// The handcrafted evaluation of eval.h, with tunable weights.
+class HandcraftedEval : public DiscEval {
+
+public:
+    EvalWeights weights;
+
+    HandcraftedEval() : weights(eval_default_weights) {}
+    int score(uint64_t own, uint64_t opp, int ply, int side) {
+        (void)ply;
+        (void)side;
+        return evaluate(own, opp, &weights);
+    }
+};
+
+// The network of nneval.h, its first layer updated incrementally along the
+// line being searched; the handcrafted evaluation until a network is set.
+class NetworkEval : public HandcraftedEval {
+
+private:
+    NNEval *nn;
+    NNAccumulator *acc;         // one per ply, aligned for AVX2
+
+public:
+    NetworkEval();
+    ~NetworkEval();
+    void set_nn(NNEval *nn);
+    void refresh(uint64_t own, uint64_t opp) {
+        if (nn != NULL) nn->refresh(&acc[0], own, opp);
+    }
+    void update(int ply, int side, int sq, uint64_t flips) {
+        if (nn != NULL) nn->update(&acc[ply], &acc[ply + 1], side, sq, flips);
+    }
+    void pass(int ply) {
+        if (nn != NULL) acc[ply + 1] = acc[ply];
+    }
+    int score(uint64_t own, uint64_t opp, int ply, int side) {
+        if (nn != NULL) return nn->evaluate(&acc[ply], side);
+        return evaluate(own, opp, &weights);
+    }
+};
+
+/*
+ * Orderers: fill list with the moves in moves, best first, and return how
+ * many there are. ttMove is the table's move for the node, or -1. sort is
+ * set at nodes at least the engine's sortDepth from the leaves, where a
+ * full ordering pays for itself.
+ */
+
+// The table move, then board order.
+class BoardOrder {
+
+public:
+    template <class Table>
+    int order(uint64_t own, uint64_t opp, uint64_t moves, int ttMove,
+              bool sort, int *list, Table &table) {
+        (void)own;
+        (void)opp;
+        (void)sort;
+        (void)table;
+        int n = 0;
+        if (ttMove >= 0 && (moves & (UINT64_C(1) << ttMove))) {
+            list[n++] = ttMove;
+            moves &= ~(UINT64_C(1) << ttMove);
+        }
+        for (; moves; moves &= moves - 1) list[n++] = bb_first(moves);
+        return n;
+    }
+};
+
+// The table move, then, where sort is set, the moves that leave the
+// opponent the fewest replies (corners first among equals), prefetching
+// their table entries; elsewhere board order.
+class MobilityOrder {
+
+public:
+    template <class Table>
+    int order(uint64_t own, uint64_t opp, uint64_t moves, int ttMove,
+              bool sort, int *list, Table &table) {
+        int keys[MAX_MOVES];
+        int n = 0;
+        for (; moves; moves &= moves - 1) {
+            int sq = bb_first(moves);
+            int key = 0;
+            if (sq == ttMove) {
+                key = -SEARCH_INFINITY;
+            } else if (sort) {
+                PERF_BEGIN(PERF_MOVEGEN);
+                uint64_t flips = bb_flips(own, opp, sq);
+                PERF_END(PERF_MOVEGEN);
+                uint64_t newOwn = opp & ~flips;
+                uint64_t newOpp = own | flips | (UINT64_C(1) << sq);
+                table.prefetch(tt_key(newOwn, newOpp));
+                PERF_BEGIN(PERF_MOVEGEN);
+                key = 2 * bb_count(bb_moves(newOwn, newOpp));
+                PERF_END(PERF_MOVEGEN);
+                if ((UINT64_C(1) << sq) & BB_CORNERS) key -= 1;
+            }
+
+            int i = n++;
+            while (i > 0 && keys[i - 1] > key) {
+                keys[i] = keys[i - 1];
+                list[i] = list[i - 1];
+                i--;
+            }
+            keys[i] = key;
+            list[i] = sq;
+        }
+        return n;
+    }
+};
+
+/*
+ * Tables, with the interface of TTable, which is the other one.
+ */
+
+// Remembers nothing.
+class NoTable {
+
+public:
+    NoTable(size_t bytes, bool hugePages) {
+        (void)bytes;
+        (void)hugePages;
+    }
+    bool probe(uint64_t key, TTData *out) {
+        (void)key;
+        (void)out;
+        return false;
+    }
+    void store(uint64_t key, int lower, int upper, int move, int depth) {
+        (void)key;
+        (void)lower;
+        (void)upper;
+        (void)move;
+        (void)depth;
+    }
+    void prefetch(uint64_t key) { (void)key; }
+    void new_search() {}
+    void clear() {}
+};
+
+/*
+ * What Player and the benchmarks see of an engine.
+ */
+class Engine {
+
+public:
+    virtual ~Engine() {}
+    virtual int run(uint64_t own, uint64_t opp, int maxDepth, double ms,
+                    int *bestMove) = 0;
+    virtual void clear() = 0;
+    virtual long nodes() = 0;
+    virtual int depth() = 0;
+};
+
+/*
+ * Iterative deepening search of midgame positions on bitboards, with the
+ * root searched by any of the algorithms of SearchAlgorithm. Scores are
+ * from the point of view of the side to move.
+ */
+template <class Eval, class Order, class Table>
+class PolicyEngine : public Engine {
+
+private:
+    Order orderer;
+    Table table;
+    int moveStack[SEARCH_MAX_PLY][MAX_MOVES];
+
+    long nodeCount;
+    double deadline;
+    bool timeUp;
+    int completed;
+
+    SearchTrace *trace;
+    int iteration;              // depth being searched, for the trace
+    long ttProbes, ttHits, ttCutoffs;
+
+    int alphabeta(uint64_t own, uint64_t opp, int alpha, int beta, int depth,
+                  int ply, int side, int *bestMove);
+    int leaf(uint64_t own, uint64_t opp, int ply, int side) {
+        PERF_BEGIN(PERF_EVAL);
+        int score = eval.score(own, opp, ply, side);
+        PERF_END(PERF_EVAL);
+        return score;
+    }
+    int aspiration(uint64_t own, uint64_t opp, int guess, int depth,
+                   int *bestMove);
+    int mtdf(uint64_t own, uint64_t opp, int guess, int depth,
+             int *bestMove);
+    void start(uint64_t own, uint64_t opp, double ms);
+    void note(int type, int move, int score, uint64_t nodes, uint32_t extra);
+    void begin_iteration(int depth, long *nodes, long *tt);
+    void end_iteration(int move, int score, long nodes, long *tt);
+    int principal_variation(uint64_t own, uint64_t opp, int *pv, int max);
+
+public:
+    PolicyEngine(size_t ttBytes);
+    void set_trace(SearchTrace *trace) { this->trace = trace; }
+    void clear();
+    int run(uint64_t own, uint64_t opp, int maxDepth, double ms,
+            int *bestMove);
+    int analyze(uint64_t own, uint64_t opp, int lines, int maxDepth,
+                double ms, SearchLine *out);
+    long nodes() { return nodeCount; }
+    int depth() { return completed; }
+
+    SearchAlgorithm algorithm;
+
+    // The evaluator, whose weights (and network) are set through here.
+    Eval eval;
+
+    // Tunable, see tune.h.
+    int window;
+    int sortDepth;
+};
+
+/*
+ * The engine registry names every way Player can choose moves: the
+ * instantiations of PolicyEngine, Search itself among them once
+ * for each root algorithm, as well as the older move choosers, so that any
+ * of them can be picked on the command line.
+ */
+
+// How the player picks moves before the endgame.
+enum EngineMode {
+    MODE_MINIMAX, MODE_MCTS, MODE_SEARCH, MODE_RANDOM, MODE_GREEDY,
+    MODE_POLICY
+};
+
+/*
+ * One way of choosing moves. mode says which; MODE_SEARCH and MODE_POLICY
+ * entries also name the root algorithm and create their engine.
+ */
+struct EngineEntry {
+    const char *name;
+    const char *description;
+    EngineMode mode;
+    SearchAlgorithm algorithm;
+    Engine *(*create)();
+};
+
+extern const EngineEntry engine_registry[];
+extern const int engine_count;
+
+const EngineEntry *engine_find(const char *name);
+void engine_list(ostream &out);
+
+#endif
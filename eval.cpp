@@ -0,0 +1,36 @@
+#include "eval.h"
+
+// Boards are evaluated in chunks so the scratch arrays stay in cache.
+#define EVAL_CHUNK  256
+
+/*
+ * Evaluates n positions, using the batch kernels for the mobility and
+ * frontier terms of both sides. Gives the same scores as evaluate().
+ */
+void evaluate_batch(const BoardPair *boards, int *scores, int n) {
+    BoardPair swapped[EVAL_CHUNK];
+    int ownMobility[EVAL_CHUNK], oppMobility[EVAL_CHUNK];
+    int ownFrontier[EVAL_CHUNK], oppFrontier[EVAL_CHUNK];
+
+    for (int start = 0; start < n; start += EVAL_CHUNK) {
+        int len = (n - start < EVAL_CHUNK) ? n - start : EVAL_CHUNK;
+        const BoardPair *b = boards + start;
+        for (int i = 0; i < len; i++) {
+            swapped[i].own = b[i].opp;
+            swapped[i].opp = b[i].own;
+        }
+
+        batch_mobility(b, ownMobility, len);
+        batch_mobility(swapped, oppMobility, len);
+        batch_frontier(b, ownFrontier, len);
+        batch_frontier(swapped, oppFrontier, len);
+
+        for (int i = 0; i < len; i++) {
+            scores[start + i] = eval_terms(
+                bb_count(b[i].own) - bb_count(b[i].opp),
+                ownMobility[i] - oppMobility[i],
+                ownFrontier[i] - oppFrontier[i],
+                bb_count(b[i].own & BB_CORNERS) - bb_count(b[i].opp & BB_CORNERS));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <stdint.h>
+#include "bitboard.h"
+#include "simdboard.h"
+
+/*
+ * Static evaluation of a position from the point of view of the side to
+ * move, built from the same features as Player::score_move: disc count,
+ * mobility and frontier squares, with corners weighted heavily.
+ */
+
+#define EVAL_DISC_WEIGHT        1
+#define EVAL_MOBILITY_WEIGHT    4
+#define EVAL_FRONTIER_WEIGHT    2
+#define EVAL_CORNER_WEIGHT      24
+
+struct EvalWeights {
+    int disc;
+    int mobility;
+    int frontier;
+    int corner;
+};
+
+static const EvalWeights eval_default_weights = {
+    EVAL_DISC_WEIGHT, EVAL_MOBILITY_WEIGHT, EVAL_FRONTIER_WEIGHT,
+    EVAL_CORNER_WEIGHT
+};
+
+static inline int eval_terms(int discs, int mobility, int frontier,
+                             int corners,
+                             const EvalWeights *w = &eval_default_weights) {
+    return w->disc * discs + w->mobility * mobility - w->frontier * frontier
+        + w->corner * corners;
+}
+
+static inline int evaluate(uint64_t own, uint64_t opp,
+                           const EvalWeights *w = &eval_default_weights) {
+    return eval_terms(bb_count(own) - bb_count(opp),
+                      bb_count(bb_moves(own, opp)) - bb_count(bb_moves(opp, own)),
+                      bb_count(bb_frontier(own, opp))
+                          - bb_count(bb_frontier(opp, own)),
+                      bb_count(own & BB_CORNERS) - bb_count(opp & BB_CORNERS),
+                      w);
+}
+
+void evaluate_batch(const BoardPair *boards, int *scores, int n);
+
+#endif
@@ -0,0 +1,174 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+#include "gamerecord.h"
+#include "engine.h"
+using namespace std;
+
+/*
+ * Converts game records between the binary format and the text printed by
+ * the Java observers, replays binary records as a speed check, and analyzes
+ * the games move by move.
+ */
+
+static double now_seconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int to_text(const char *path) {
+    GameRecordReader reader;
+    if (!reader.open(path)) {
+        cerr << "cannot read " << path << endl;
+        return -1;
+    }
+
+    GameRecordView view;
+    int games = 0;
+    while (reader.next(&view)) {
+        if (!game_record_to_text(&view, cout)) {
+            cerr << "invalid record " << games << endl;
+            return -1;
+        }
+        games++;
+    }
+    return 0;
+}
+
+static int from_text(const char *in, const char *out) {
+    ifstream text(in);
+    if (!text) {
+        cerr << "cannot read " << in << endl;
+        return -1;
+    }
+
+    GameRecordWriter writer;
+    if (!writer.open(out, false)) {
+        cerr << "cannot write " << out << endl;
+        return -1;
+    }
+
+    GameRecord rec;
+    int games = 0, line = 0;
+    const char *error;
+    while (game_record_from_text(text, &rec, &line, &error)) {
+        writer.write(&rec);
+        games++;
+    }
+    cerr << games << " games written" << endl;
+    if (error != NULL) {
+        cerr << in << ":" << line << ": " << error << " in game " << games + 1
+             << endl;
+        return -1;
+    }
+    return 0;
+}
+
+static int replay(const char *path) {
+    GameRecordReader reader;
+    if (!reader.open(path)) {
+        cerr << "cannot read " << path << endl;
+        return -1;
+    }
+
+    double start = now_seconds();
+    GameRecordView view;
+    long games = 0, moves = 0, bad = 0, blackWins = 0, whiteWins = 0;
+    while (reader.next(&view)) {
+        Board board;
+        GameReplay replay(&view, &board);
+        while (replay.next()) moves++;
+        if (replay.ply() != view.nmoves) bad++;
+        if (view.blackCount > view.whiteCount) blackWins++;
+        if (view.whiteCount > view.blackCount) whiteWins++;
+        games++;
+    }
+    double elapsed = now_seconds() - start;
+
+    cout << games << " games, " << moves << " moves, " << bad << " invalid" << endl;
+    cout << "black wins " << blackWins << ", white wins " << whiteWins
+         << ", ties " << games - blackWins - whiteWins << endl;
+    if (elapsed > 0) {
+        cout << (long)(moves / elapsed) << " moves/s" << endl;
+    }
+    return bad ? 1 : 0;
+}
+
+static void print_square(int sq) {
+    if (sq < 0) cout << "pass";
+    else cout << "(" << sq % 8 << "," << sq / 8 << ")";
+}
+
+/*
+ * Prints, for every move of every game, the best lines moves the search
+ * finds to the given depth, with their scores and principal variations, and
+ * marks the move that was played.
+ */
+static int analyze(const char *path, int lines, int depth) {
+    GameRecordReader reader;
+    if (!reader.open(path)) {
+        cerr << "cannot read " << path << endl;
+        return -1;
+    }
+
+    Search search(SEARCH_TT_BYTES);
+    search.algorithm = SEARCH_PVS;
+    GameRecordView view;
+    int games = 0;
+    while (reader.next(&view)) {
+        Board board;
+        GameReplay replay(&view, &board);
+        cout << "game " << games << endl;
+        while (replay.ply() < view.nmoves) {
+            Side side = board.hasMoves(replay.side) ? replay.side
+                : ((replay.side == BLACK) ? WHITE : BLACK);
+            Side other = (side == BLACK) ? WHITE : BLACK;
+            int played = view.moves[replay.ply()];
+
+            SearchLine found[MAX_MOVES];
+            int n = search.analyze(board.getBits(side), board.getBits(other),
+                                   lines, depth, 0, found);
+            cout << replay.ply() + 1 << ". "
+                 << ((side == BLACK) ? "Black" : "White") << " played ";
+            print_square(played);
+            cout << endl;
+            for (int i = 0; i < n; i++) {
+                cout << ((found[i].move == played) ? "  * " : "    ");
+                cout << found[i].score << (found[i].exact ? " exact " : " ");
+                for (int j = 0; j < found[i].length; j++) {
+                    cout << " ";
+                    print_square(found[i].pv[j]);
+                }
+                cout << endl;
+            }
+
+            if (!replay.next()) {
+                cerr << "invalid record " << games << endl;
+                return -1;
+            }
+        }
+        games++;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && !strcmp(argv[1], "totext")) return to_text(argv[2]);
+    if (argc == 4 && !strcmp(argv[1], "fromtext")) return from_text(argv[2], argv[3]);
+    if (argc == 3 && !strcmp(argv[1], "replay")) return replay(argv[2]);
+    if (argc >= 3 && argc <= 5 && !strcmp(argv[1], "analyze")) {
+        int lines = (argc > 3) ? atoi(argv[3]) : 3;
+        int depth = (argc > 4) ? atoi(argv[4]) : 8;
+        return analyze(argv[2], lines, depth);
+    }
+
+    cerr << "usage: " << argv[0] << " totext games.ogr" << endl;
+    cerr << "       " << argv[0] << " fromtext games.txt games.ogr" << endl;
+    cerr << "       " << argv[0] << " replay games.ogr" << endl;
+    cerr << "       " << argv[0] << " analyze games.ogr [lines] [depth]"
+         << endl;
+    return -1;
+}
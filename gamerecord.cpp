@@ -0,0 +1,314 @@
+#include "gamerecord.h"
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Makes an empty record.
+ */
+GameRecord::GameRecord() {
+    clear();
+}
+
+void GameRecord::clear() {
+    nmoves = 0;
+    flags = 0;
+    blackCount = 2;
+    whiteCount = 2;
+}
+
+/*
+ * Appends a move to the record. Passes (NULL moves) are implied by the format
+ * and are ignored. Returns false if the record is already full.
+ */
+bool GameRecord::addMove(Move *m) {
+    if (m == NULL) return true;
+    if (nmoves >= GR_MAX_MOVES) return false;
+    scores[nmoves] = 0;
+    moves[nmoves++] = (unsigned char)(m->getX() + 8 * m->getY());
+    return true;
+}
+
+/*
+ * Appends a move together with the score the engine gave it. Scores are
+ * clamped to the int16 range used on disk.
+ */
+bool GameRecord::addMove(Move *m, int score) {
+    if (m == NULL) return true;
+    if (!addMove(m)) return false;
+    if (score > 32767) score = 32767;
+    if (score < -32768) score = -32768;
+    scores[nmoves - 1] = (short)score;
+    flags |= GR_HAS_SCORES;
+    return true;
+}
+
+/*
+ * Records the final disc counts from the given board.
+ */
+void GameRecord::finish(Board *b) {
+    blackCount = b->countBlack();
+    whiteCount = b->countWhite();
+    if (b->isDone()) flags |= GR_FINISHED;
+    else flags &= ~GR_FINISHED;
+}
+
+/*
+ * Score stored for move i; 0 if the record has no scores.
+ */
+int GameRecordView::score(int i) {
+    if (!hasScores()) return 0;
+    return (short)(scoreBytes[2 * i] | (scoreBytes[2 * i + 1] << 8));
+}
+
+GameRecordWriter::GameRecordWriter() {
+    fp = NULL;
+}
+
+GameRecordWriter::~GameRecordWriter() {
+    close();
+}
+
+/*
+ * Opens a record file for writing. With append set, records are added to the
+ * end of an existing file; a new or truncated file gets a fresh file header.
+ */
+bool GameRecordWriter::open(const char *path, bool append) {
+    close();
+    fp = fopen(path, append ? "ab" : "wb");
+    if (fp == NULL) return false;
+
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) {
+        unsigned char header[GR_FILE_HEADER];
+        memset(header, 0, sizeof(header));
+        memcpy(header, GR_MAGIC, 4);
+        if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GameRecordWriter::write(GameRecord *rec) {
+    if (fp == NULL) return false;
+
+    unsigned char buf[4 + 3 * GR_MAX_MOVES];
+    int n = 0;
+    buf[n++] = (unsigned char)rec->nmoves;
+    buf[n++] = (unsigned char)rec->flags;
+    buf[n++] = (unsigned char)rec->blackCount;
+    buf[n++] = (unsigned char)rec->whiteCount;
+    memcpy(buf + n, rec->moves, rec->nmoves);
+    n += rec->nmoves;
+    if (rec->flags & GR_HAS_SCORES) {
+        for (int i = 0; i < rec->nmoves; i++) {
+            buf[n++] = (unsigned char)(rec->scores[i] & 0xff);
+            buf[n++] = (unsigned char)((rec->scores[i] >> 8) & 0xff);
+        }
+    }
+    return fwrite(buf, 1, n, fp) == (size_t)n;
+}
+
+void GameRecordWriter::close() {
+    if (fp != NULL) {
+        fclose(fp);
+        fp = NULL;
+    }
+}
+
+GameRecordReader::GameRecordReader() {
+    data = NULL;
+    size = 0;
+    pos = 0;
+}
+
+GameRecordReader::~GameRecordReader() {
+    close();
+}
+
+/*
+ * Maps a record file into memory. Returns false if the file cannot be mapped
+ * or does not start with a valid file header.
+ */
+bool GameRecordReader::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < GR_FILE_HEADER) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    data = (const unsigned char *)p;
+    size = st.st_size;
+    if (memcmp(data, GR_MAGIC, 4) != 0) {
+        close();
+        return false;
+    }
+    pos = GR_FILE_HEADER;
+    return true;
+}
+
+/*
+ * Fills in a view of the next record. Returns false at the end of the file or
+ * if the remaining bytes do not form a complete record.
+ */
+bool GameRecordReader::next(GameRecordView *view) {
+    if (data == NULL || pos + 4 > size) return false;
+
+    const unsigned char *p = data + pos;
+    int n = p[0];
+    int flags = p[1];
+    size_t len = 4 + n + ((flags & GR_HAS_SCORES) ? 2 * n : 0);
+    if (n > GR_MAX_MOVES || pos + len > size) return false;
+
+    view->nmoves = n;
+    view->flags = flags;
+    view->blackCount = p[2];
+    view->whiteCount = p[3];
+    view->moves = p + 4;
+    view->scoreBytes = (flags & GR_HAS_SCORES) ? p + 4 + n : NULL;
+    pos += len;
+    return true;
+}
+
+void GameRecordReader::close() {
+    if (data != NULL) {
+        munmap((void *)data, size);
+        data = NULL;
+    }
+    size = 0;
+    pos = 0;
+}
+
+/*
+ * Starts a replay of view on board, which should hold the starting position.
+ */
+GameReplay::GameReplay(GameRecordView *view, Board *board) {
+    this->view = view;
+    this->board = board;
+    index = 0;
+    side = BLACK;
+}
+
+/*
+ * Plays the next recorded move, passing first if the side to move has no
+ * legal move. Returns false at the end of the record or on an illegal move.
+ */
+bool GameReplay::next() {
+    if (index >= view->nmoves) return false;
+
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    if (!board->hasMoves(side)) side = other;
+
+    int sq = view->moves[index];
+    Move move(sq % 8, sq / 8);
+    if (sq >= 64 || !board->checkMove(&move, side)) return false;
+    board->doMove(&move, side);
+    side = (side == BLACK) ? WHITE : BLACK;
+    index++;
+    return true;
+}
+
+/*
+ * Reads one game in the format printed by the Java OthelloTextObserver
+ * ("Black: (x,y)", "White: null", ..., "Game result: ..."). Lines that are
+ * not moves are skipped. *lineNo counts the lines read. Returns false at the
+ * end of the log with *error set to NULL, or with *error saying why if the
+ * game cannot be read (a move that does not parse or is illegal, or a game
+ * cut off before its result); *lineNo is then the line it stopped at.
+ */
+bool game_record_from_text(istream &in, GameRecord *rec, int *lineNo,
+                           const char **error) {
+    rec->clear();
+    Board board;
+    bool any = false;
+    string line;
+    *error = NULL;
+
+    for (;;) {
+        if (!getline(in, line)) {
+            if (any) *error = "game ends without a result";
+            return false;
+        }
+        (*lineNo)++;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        if (line.compare(0, 12, "Game result:") == 0) break;
+
+        Side side;
+        size_t start;
+        if (line.compare(0, 7, "Black: ") == 0) {
+            side = BLACK;
+            start = 7;
+        } else if (line.compare(0, 7, "White: ") == 0) {
+            side = WHITE;
+            start = 7;
+        } else {
+            continue;
+        }
+        any = true;
+
+        int x, y;
+        if (line.compare(start, string::npos, "null") == 0) continue;
+        if (sscanf(line.c_str() + start, "(%d,%d)", &x, &y) != 2) {
+            *error = "move does not parse";
+            return false;
+        }
+        Move move(x, y);
+        if (x < 0 || x > 7 || y < 0 || y > 7 || !board.checkMove(&move, side)) {
+            *error = "illegal move";
+            return false;
+        }
+        board.doMove(&move, side);
+        if (!rec->addMove(&move)) {
+            *error = "too many moves";
+            return false;
+        }
+    }
+
+    rec->finish(&board);
+    return true;
+}
+
+/*
+ * Writes a record in the OthelloTextObserver format, including the passes
+ * implied by the binary format. Returns false if the record is invalid.
+ */
+bool game_record_to_text(GameRecordView *view, ostream &out) {
+    Board board;
+    GameReplay replay(view, &board);
+
+    while (replay.ply() < view->nmoves) {
+        if (!board.hasMoves(replay.side)) {
+            out << ((replay.side == BLACK) ? "Black" : "White") << ": null\n";
+        }
+        int sq = view->moves[replay.ply()];
+        Side mover = board.hasMoves(replay.side) ? replay.side
+            : ((replay.side == BLACK) ? WHITE : BLACK);
+        if (!replay.next()) return false;
+        out << ((mover == BLACK) ? "Black" : "White") << ": ("
+            << sq % 8 << "," << sq / 8 << ")\n";
+    }
+
+    int b = view->blackCount;
+    int w = view->whiteCount;
+    out << "Game result: " << b << "/" << w;
+    if (b > w) out << " (Black wins)\n";
+    else if (b < w) out << " (White wins)\n";
+    else out << " (Tie)\n";
+    return true;
+}
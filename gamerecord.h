@@ -0,0 +1,131 @@
+#ifndef __GAMERECORD_H__
+#define __GAMERECORD_H__
+
+#include <cstdio>
+#include <iostream>
+#include <stdint.h>
+#include "common.h"
+#include "board.h"
+using namespace std;
+
+/*
+ * Compact binary game records.
+ *
+ * A record file starts with an 8 byte file header ("OGR1" followed by four
+ * reserved bytes) and then holds any number of game records back to back:
+ *
+ *   byte 0        number of moves n (0-60), passes are not stored
+ *   byte 1        flags (GR_HAS_SCORES, GR_FINISHED)
+ *   byte 2        black disc count at the end of the record
+ *   byte 3        white disc count at the end of the record
+ *   n bytes       moves, one square index (x + 8*y) per byte
+ *   2n bytes      per-move scores as little-endian int16 (GR_HAS_SCORES only)
+ *
+ * Black always moves first. Passes are implied: whenever the side to move has
+ * no legal move during replay, the turn goes to the other side.
+ */
+
+#define GR_MAGIC        "OGR1"
+#define GR_FILE_HEADER  8
+#define GR_MAX_MOVES    60
+
+#define GR_HAS_SCORES   0x01
+#define GR_FINISHED     0x02
+
+/*
+ * An owned, mutable game record, used to build records before writing them.
+ */
+class GameRecord {
+
+public:
+    unsigned char moves[GR_MAX_MOVES];
+    short scores[GR_MAX_MOVES];
+    int nmoves;
+    int flags;
+    int blackCount;
+    int whiteCount;
+
+    GameRecord();
+    void clear();
+    bool addMove(Move *m);
+    bool addMove(Move *m, int score);
+    void finish(Board *b);
+};
+
+/*
+ * A read-only view of one record. The pointers refer directly into the
+ * reader's mapping and stay valid until the reader is closed.
+ */
+class GameRecordView {
+
+public:
+    const unsigned char *moves;
+    const unsigned char *scoreBytes;
+    int nmoves;
+    int flags;
+    int blackCount;
+    int whiteCount;
+
+    bool hasScores() { return (flags & GR_HAS_SCORES) != 0; }
+    bool finished() { return (flags & GR_FINISHED) != 0; }
+    int score(int i);
+};
+
+/*
+ * Appends records to a file, writing the file header when the file is new.
+ */
+class GameRecordWriter {
+
+private:
+    FILE *fp;
+
+public:
+    GameRecordWriter();
+    ~GameRecordWriter();
+    bool open(const char *path, bool append);
+    bool write(GameRecord *rec);
+    void close();
+};
+
+/*
+ * Streams the records of a file without copying them: the file is mapped
+ * read-only and each call to next() returns a view into the mapping.
+ */
+class GameRecordReader {
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+
+public:
+    GameRecordReader();
+    ~GameRecordReader();
+    bool open(const char *path);
+    bool next(GameRecordView *view);
+    void close();
+};
+
+/*
+ * Replays a record move by move on a Board, inserting passes as needed.
+ */
+class GameReplay {
+
+private:
+    GameRecordView *view;
+    Board *board;
+    int index;
+
+public:
+    Side side;
+
+    GameReplay(GameRecordView *view, Board *board);
+    bool next();
+    int ply() { return index; }
+};
+
+bool game_record_from_text(istream &in, GameRecord *rec, int *lineNo,
+                           const char **error);
+bool game_record_to_text(GameRecordView *view, ostream &out);
+
+#endif
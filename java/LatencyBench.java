@@ -0,0 +1,76 @@
+import java.util.Arrays;
+
+/**
+ * Measures the round trip of WrapperPlayer.doMove, the referee's side of the
+ * protocol, by playing a program against itself with a move chooser that
+ * costs next to nothing, such as shakespeare's random engine.
+ *
+ * Usage: java [-Dothello.binary] LatencyBench PROGRAM [ARGS] [GAMES]
+ * e.g.   java -Dothello.binary LatencyBench shakespeare random 50
+ */
+public class LatencyBench {
+
+    public static void main(String[] args) {
+        if (args.length < 1 || args.length > 3) {
+            System.out.println(
+                "\nUsage: LatencyBench PROGRAM [ARGS] [GAMES]\n"
+                + "  ARGS  - program arguments after the side, default random\n"
+                + "  GAMES - games to play, default 10\n"
+                + "  -Dothello.binary selects the binary framing\n");
+            System.exit(-1);
+        }
+        String program = args[0];
+        String programArgs = (args.length > 1) ? args[1] : "random";
+        int games = (args.length > 2) ? Integer.parseInt(args[2]) : 10;
+
+        long[] times = new long[games * 64];
+        int n = 0;
+        for (int g = 0; g < games; g++) {
+            WrapperPlayer black = new WrapperPlayer(program, programArgs);
+            WrapperPlayer white = new WrapperPlayer(program, programArgs);
+            // Board dumps on stderr would be timed along with the moves.
+            black.quiet();
+            white.quiet();
+            black.init(OthelloSide.BLACK);
+            white.init(OthelloSide.WHITE);
+
+            OthelloBoard board = new OthelloBoard();
+            OthelloSide turn = OthelloSide.BLACK;
+            Move last = null;
+            while (!board.isDone()) {
+                WrapperPlayer player = (turn == OthelloSide.BLACK) ? black : white;
+                long start = System.nanoTime();
+                Move m = player.doMove(last, -1);
+                long elapsed = System.nanoTime() - start;
+                if (n < times.length) {
+                    times[n++] = elapsed;
+                }
+
+                if (m != null && !board.checkMove(m, turn)) {
+                    System.out.println("illegal move " + m + " by " + turn);
+                    System.exit(-1);
+                }
+                if (m != null) {
+                    board.move(m, turn);
+                }
+                last = m;
+                turn = turn.opposite();
+            }
+            black.close();
+            white.close();
+        }
+
+        Arrays.sort(times, 0, n);
+        long sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += times[i];
+        }
+        System.out.println((System.getProperty("othello.binary") != null
+            ? "binary" : "text") + " framing, " + n + " moves");
+        System.out.printf("  mean %8.1f us%n", sum / 1000.0 / n);
+        System.out.printf("  p50  %8.1f us%n", times[n / 2] / 1000.0);
+        System.out.printf("  p99  %8.1f us%n", times[n * 99 / 100] / 1000.0);
+        System.out.printf("  max  %8.1f us%n", times[n - 1] / 1000.0);
+        System.exit(0);
+    }
+}
@@ -81,9 +81,31 @@ public class OthelloGame implements Runnable {
     }
 
     /**
-     * Runs the game.
+     * Runs the game, then closes the players that run as programs, so that
+     * they exit before the caller moves on.
      **/
     public void run() {
+        try {
+            play();
+        } finally {
+            close(black);
+            close(white);
+        }
+    }
+
+    /**
+     * Lets a player that runs as a program end its game.
+     **/
+    private static void close(OthelloPlayer player) {
+        if (player instanceof WrapperPlayer) {
+            ((WrapperPlayer) player).close();
+        }
+    }
+
+    /**
+     * Plays the game out and tells the observer how it ended.
+     **/
+    private void play() {
         OthelloSide turn = OthelloSide.BLACK;
         Move m = null;
         OthelloResult r = new OthelloResult();
@@ -1,129 +1,253 @@
-import java.io.BufferedReader;
-import java.io.BufferedWriter;
-import java.io.InputStreamReader;
-import java.io.OutputStreamWriter;
-
-/**
- * A wrapper class for the CS 2 Othello tournament. This should 
- * enable students to use a non-Java Othello player by handing the moves
- * back and forth using stdin/stdout.
- */
-public class WrapperPlayer implements OthelloPlayer {
-    private final static int MAX_MEMORY_KB = 786432;
-    private Process p;
-    private BufferedReader br;
-    private BufferedReader stderr;    
-    private BufferedWriter bw;
-    private String name;
-
-    public WrapperPlayer(String programName) {
-        this.name = programName;
-
-        Runtime.getRuntime().addShutdownHook(new Thread() {
-            public void run() {
-                try {
-                    if (p != null) {
-                        br.close();
-                        stderr.close();
-                        bw.close();
-                        p.destroy();
-                    }
-                } catch (Exception e) {   
-                    e.printStackTrace();
-                }                
-            }
-        });
-    }
-
-    /**
-     * Prints out the stderr of the process to stdout.
-     */
-    private void printStdErr() {
-        try {
-            while (stderr.ready()) {
-                System.out.println(stderr.readLine());
-            }
-        } catch (Exception e) {   
-            e.printStackTrace();
-        }
-    }
-    
-    /**
-     * Makes the next move in the game.
-     * 
-     * @param opponentsMove the last move made by the other player. If
-     * it is null, then that player passed, of this player is the first
-     * player to make a move.
-     * 
-     * @param millisLeft the number of milliseconds that this player
-     * has remaining in the entire game, before going overtime and
-     * being disqualified.
-     * 
-     * @return Move this player's move. May be null only if there are
-     * no legal moves to make.
-     */
-    public Move doMove(Move opponentsMove, long millisLeft) {    
-        printStdErr();
-
-        String line;
-        try {
-            if (opponentsMove == null) {
-                bw.write("-1 -1 " + millisLeft + "\n");
-            } else {
-                bw.write(opponentsMove.getX() + " " + opponentsMove.getY()
-                    + " " + millisLeft + "\n");
-            }
-            bw.flush();
-            
-            while (!br.ready()) {
-                printStdErr();
-
-                try {
-                    int exitvalue = p.exitValue();
-                    // If we got an exit value (versus exception), it means
-                    // the program has ended; don't wait for input.
-                    break;
-                } catch (IllegalThreadStateException e) {
-                    // Program still running, don't do anything.
-                }                                
-                Thread.yield();
-                Thread.sleep(100);
-            }
-            printStdErr();
-
-            line = br.readLine();
-            if (line == null || line.equals("-1 -1")) {
-                return null;
-            } else {
-                String[] parts = line.split(" ");
-                return new Move(Integer.parseInt(parts[0]),
-                    Integer.parseInt(parts[1]));
-            }            
-        } catch (Exception e) {
-            e.printStackTrace();
-        }
-        return null;
-    }
-
-    /* (non-Javadoc)
-     * @see cs2ai.OthelloPlayer#init(cs2ai.OthelloSide)
-     */
-    public void init(OthelloSide side) {
-        try {
-            String cmd = "ulimit -m " + MAX_MEMORY_KB + " -v " + MAX_MEMORY_KB + ";";
-            cmd += "./" + name + " " + side;
-            ProcessBuilder pb = new ProcessBuilder("bash", "-c", cmd);
-            p = pb.start();            
-            
-            br = new BufferedReader(new InputStreamReader(p.getInputStream()));
-            stderr = new BufferedReader(new InputStreamReader(p.getErrorStream()));                    
-            bw = new BufferedWriter(new OutputStreamWriter(p.getOutputStream()));
-              
-            // Wait for message that program is done initialization.                       
-            br.readLine();
-        }
-        catch (Exception e) {
-            e.printStackTrace();
-        }
-    }
-}
\ No newline at end of file
+import java.io.BufferedInputStream;
+import java.io.BufferedOutputStream;
+import java.io.BufferedReader;
+import java.io.DataInputStream;
+import java.io.DataOutputStream;
+import java.io.IOException;
+import java.io.InputStreamReader;
+
+/**
+ * A wrapper class for the CS 2 Othello tournament. This should
+ * enable students to use a non-Java Othello player by handing the moves
+ * back and forth using stdin/stdout.
+ *
+ * Moves are exchanged as lines of text ("x y msLeft" to the program,
+ * "x y" back), or, if the system property othello.binary is set, in the
+ * binary framing of protocol.h: the program is started with
+ * OTHELLO_FRAMING=binary and gets 6 byte requests (x, y, then msLeft as a
+ * big endian int) and sends 2 byte replies (x, y). doMove blocks on the
+ * reply, which a program that exits ends as well: the shell execs the
+ * program, so its exit closes the pipe. The program's stderr is copied to
+ * stdout by a thread of its own.
+ */
+public class WrapperPlayer implements OthelloPlayer {
+    private final static int MAX_MEMORY_KB = 786432;
+    // How long a program whose stdin is closed gets to exit by itself.
+    private final static long EXIT_WAIT_MS = 5000;
+    private Process p;
+    private DataInputStream in;
+    private DataOutputStream out;
+    private String name;
+    private String args;
+    private boolean binary;
+    private boolean quiet;
+    private Thread shutdownHook;
+    // The thread group of whoever created us; the game runs init and doMove
+    // in groups of their own and disqualifies players that leave threads
+    // running in them, so the stderr thread must not start there.
+    private ThreadGroup group;
+
+    public WrapperPlayer(String programName) {
+        this(programName, "");
+    }
+
+    /**
+     * @param args extra arguments for the program, after the side.
+     */
+    public WrapperPlayer(String programName, String args) {
+        this.name = programName;
+        this.args = args;
+        this.binary = System.getProperty("othello.binary") != null;
+        this.group = Thread.currentThread().getThreadGroup();
+
+        // A JVM that exits before close() still lets the program end its
+        // game, which saves its caches, before it is killed.
+        shutdownHook = new Thread() {
+            public void run() {
+                close();
+            }
+        };
+        Runtime.getRuntime().addShutdownHook(shutdownHook);
+    }
+
+    /**
+     * Starts the program with the board display after each move turned off
+     * (OTHELLO_QUIET), e.g. for benchmarks. Must be called before init.
+     */
+    public void quiet() {
+        quiet = true;
+    }
+
+    /**
+     * Ends the game: closes the program's stdin, which makes it exit, and
+     * waits for it to do so. Safe to call more than once.
+     */
+    public synchronized void close() {
+        if (p == null) {
+            return;
+        }
+        stop();
+        p = null;
+        try {
+            Runtime.getRuntime().removeShutdownHook(shutdownHook);
+        } catch (IllegalStateException e) {
+            // Called from the hook: the JVM is already shutting down.
+        }
+    }
+
+    /**
+     * Closes the program's stdin and gives it EXIT_WAIT_MS to finish up
+     * (write its caches and reports) and exit before killing it.
+     */
+    private void stop() {
+        try {
+            out.close();
+        } catch (IOException e) {
+            // The program has already closed its end.
+        }
+        long deadline = System.currentTimeMillis() + EXIT_WAIT_MS;
+        while (!exited() && System.currentTimeMillis() < deadline) {
+            try {
+                Thread.sleep(10);
+            } catch (InterruptedException e) {
+                break;
+            }
+        }
+        if (!exited()) {
+            p.destroy();
+        }
+        try {
+            in.close();
+        } catch (IOException e) {
+            // Nothing left to read.
+        }
+    }
+
+    /**
+     * @return whether the program has exited.
+     */
+    private boolean exited() {
+        try {
+            p.exitValue();
+            return true;
+        } catch (IllegalThreadStateException e) {
+            return false;
+        }
+    }
+
+    /**
+     * Copies the stderr of the process to stdout until it closes.
+     */
+    private void startStdErrThread() {
+        final BufferedReader stderr = new BufferedReader(
+            new InputStreamReader(p.getErrorStream()));
+        Thread t = new Thread(group, new Runnable() {
+            public void run() {
+                try {
+                    String line;
+                    while ((line = stderr.readLine()) != null) {
+                        System.out.println(line);
+                    }
+                    stderr.close();
+                } catch (IOException e) {
+                    // The process is gone.
+                }
+            }
+        }, name + " stderr");
+        t.setDaemon(true);
+        t.start();
+    }
+
+    /**
+     * Reads a line of text from the program, without buffering beyond it.
+     *
+     * @return the line, or null at the end of the output.
+     */
+    private String readLine() throws IOException {
+        StringBuilder line = new StringBuilder();
+        int c;
+        while ((c = in.read()) != '\n') {
+            if (c < 0) {
+                return (line.length() > 0) ? line.toString() : null;
+            }
+            if (c != '\r') {
+                line.append((char) c);
+            }
+        }
+        return line.toString();
+    }
+
+    /**
+     * Makes the next move in the game.
+     *
+     * @param opponentsMove the last move made by the other player. If
+     * it is null, then that player passed, of this player is the first
+     * player to make a move.
+     *
+     * @param millisLeft the number of milliseconds that this player
+     * has remaining in the entire game, before going overtime and
+     * being disqualified.
+     *
+     * @return Move this player's move. May be null only if there are
+     * no legal moves to make.
+     */
+    public Move doMove(Move opponentsMove, long millisLeft) {
+        // A program that failed to start or has exited passes.
+        if (p == null || exited()) {
+            return null;
+        }
+        int x = (opponentsMove == null) ? -1 : opponentsMove.getX();
+        int y = (opponentsMove == null) ? -1 : opponentsMove.getY();
+        try {
+            if (binary) {
+                out.writeByte(x);
+                out.writeByte(y);
+                out.writeInt((int) millisLeft);
+                out.flush();
+
+                // A closed pipe reads as -1 -1, a pass, as in text mode.
+                int mx = in.read();
+                int my = in.read();
+                if (mx < 0 || my < 0 || (byte) mx < 0) {
+                    return null;
+                }
+                return new Move((byte) mx, (byte) my);
+            }
+
+            out.writeBytes(x + " " + y + " " + millisLeft + "\n");
+            out.flush();
+
+            String line = readLine();
+            if (line == null || line.equals("-1 -1")) {
+                return null;
+            } else {
+                String[] parts = line.split(" ");
+                return new Move(Integer.parseInt(parts[0]),
+                    Integer.parseInt(parts[1]));
+            }
+        } catch (Exception e) {
+            e.printStackTrace();
+        }
+        return null;
+    }
+
+    /* (non-Javadoc)
+     * @see cs2ai.OthelloPlayer#init(cs2ai.OthelloSide)
+     */
+    public void init(OthelloSide side) {
+        try {
+            String cmd = "ulimit -m " + MAX_MEMORY_KB + " -v " + MAX_MEMORY_KB + ";";
+            cmd += "exec ./" + name + " " + side + " " + args;
+            ProcessBuilder pb = new ProcessBuilder("bash", "-c", cmd);
+            if (binary) {
+                pb.environment().put("OTHELLO_FRAMING", "binary");
+            }
+            if (quiet) {
+                pb.environment().put("OTHELLO_QUIET", "1");
+            }
+            p = pb.start();
+
+            in = new DataInputStream(
+                new BufferedInputStream(p.getInputStream()));
+            out = new DataOutputStream(
+                new BufferedOutputStream(p.getOutputStream()));
+            startStdErrThread();
+
+            // Wait for message that program is done initialization.
+            readLine();
+        }
+        catch (Exception e) {
+            e.printStackTrace();
+        }
+    }
+}
@@ -0,0 +1,200 @@
+#include "latency.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *metric_names[LAT_METRICS] = {
+    "wall", "search", "io", "left"
+};
+
+static const char *phase_names[PHASE_COUNT] = {
+    "opening", "midgame", "endgame"
+};
+
+GamePhase game_phase(int empties) {
+    if (empties > PHASE_OPENING_EMPTIES) return PHASE_OPENING;
+    if (empties > PHASE_ENDGAME_EMPTIES) return PHASE_MIDGAME;
+    return PHASE_ENDGAME;
+}
+
+/*
+ * Upper bound of bucket i in milliseconds.
+ */
+static double bucket_limit(int i) {
+    return LATENCY_MIN_MS * pow(2.0, (i + 1) / 4.0);
+}
+
+LatencyHistogram::LatencyHistogram() {
+    memset(counts, 0, sizeof(counts));
+    n = 0;
+    sum = 0;
+    max = 0;
+}
+
+void LatencyHistogram::add(double ms) {
+    int i = 0;
+    if (ms > LATENCY_MIN_MS) {
+        i = (int)floor(4.0 * log(ms / LATENCY_MIN_MS) / log(2.0));
+        if (i >= LATENCY_BUCKETS) i = LATENCY_BUCKETS - 1;
+    }
+    counts[i]++;
+    n++;
+    sum += ms;
+    if (ms > max) max = ms;
+}
+
+void LatencyHistogram::merge(LatencyHistogram *h) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) counts[i] += h->counts[i];
+    n += h->n;
+    sum += h->sum;
+    if (h->max > max) max = h->max;
+}
+
+/*
+ * Time below which a fraction p of the samples fall, to bucket precision
+ * (never above the largest sample).
+ */
+double LatencyHistogram::percentile(double p) {
+    if (n == 0) return 0;
+    long rank = (long)ceil(p * n);
+    if (rank < 1) rank = 1;
+    long seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            double limit = bucket_limit(i);
+            return (limit < max) ? limit : max;
+        }
+    }
+    return max;
+}
+
+LatencyStats::LatencyStats() {
+    games = 0;
+    moves = 0;
+    timedMoves = 0;
+    riskyMoves = 0;
+    minLeft = 1e18;
+    maxFraction = 0;
+}
+
+/*
+ * Records one move. msLeft is the clock the referee reported before the
+ * move, or -1 for an untimed game.
+ */
+void LatencyStats::record(int empties, double wallMs, double searchMs,
+                          int msLeft) {
+    GamePhase phase = game_phase(empties);
+    hist[LAT_WALL][phase].add(wallMs);
+    hist[LAT_SEARCH][phase].add(searchMs);
+    hist[LAT_IO][phase].add(wallMs > searchMs ? wallMs - searchMs : 0);
+    moves++;
+
+    if (msLeft >= 0) {
+        double left = msLeft - wallMs;
+        hist[LAT_LEFT][phase].add(left > 0 ? left : 0);
+        timedMoves++;
+        if (left < minLeft) minLeft = left;
+        double fraction = (msLeft > 0) ? wallMs / msLeft : 1;
+        if (fraction > maxFraction) maxFraction = fraction;
+        if (fraction > 0.5) riskyMoves++;
+    }
+}
+
+void LatencyStats::merge(LatencyStats *s) {
+    for (int m = 0; m < LAT_METRICS; m++) {
+        for (int p = 0; p < PHASE_COUNT; p++) hist[m][p].merge(&s->hist[m][p]);
+    }
+    games += s->games;
+    moves += s->moves;
+    timedMoves += s->timedMoves;
+    riskyMoves += s->riskyMoves;
+    if (s->minLeft < minLeft) minLeft = s->minLeft;
+    if (s->maxFraction > maxFraction) maxFraction = s->maxFraction;
+}
+
+/*
+ * Prints p50/p99/max per metric and phase, then the time-forfeit risk.
+ */
+void LatencyStats::print(ostream &out) {
+    char line[160];
+    out << games << " games, " << moves << " moves" << endl;
+    out << "metric  phase      moves      p50 ms      p99 ms      max ms"
+        << endl;
+    for (int m = 0; m < LAT_METRICS; m++) {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            LatencyHistogram *h = &hist[m][p];
+            if (h->n == 0) continue;
+            snprintf(line, sizeof(line), "%-7s %-8s %7ld %11.2f %11.2f %11.2f",
+                     metric_names[m], phase_names[p], h->n,
+                     h->percentile(0.5), h->percentile(0.99), h->max);
+            out << line << endl;
+        }
+    }
+
+    if (timedMoves > 0) {
+        snprintf(line, sizeof(line),
+                 "forfeit risk: closest margin %.1f ms, largest move %.1f%% "
+                 "of clock, %ld of %ld moves used over half the clock",
+                 minLeft, 100 * maxFraction, riskyMoves, timedMoves);
+        out << line << endl;
+    }
+}
+
+/*
+ * Appends the statistics to a log file in the form read by read(), with a
+ * single write so that concurrent games do not interleave.
+ */
+bool LatencyStats::append(const char *path) {
+    ostringstream out;
+    out.precision(17);
+    out << "stats " << games << " " << moves << " " << timedMoves << " "
+        << riskyMoves << " " << minLeft << " " << maxFraction << "\n";
+    for (int m = 0; m < LAT_METRICS; m++) {
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            LatencyHistogram *h = &hist[m][p];
+            out << "hist " << m << " " << p << " " << h->n << " " << h->sum
+                << " " << h->max;
+            for (int i = 0; i < LATENCY_BUCKETS; i++) out << " " << h->counts[i];
+            out << "\n";
+        }
+    }
+
+    string data = out.str();
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+    close(fd);
+    return ok;
+}
+
+/*
+ * Reads one block written by append() and merges it into these statistics.
+ * Returns false at the end of the input or on a malformed block.
+ */
+bool LatencyStats::read(istream &in) {
+    LatencyStats s;
+    string tag;
+    if (!(in >> tag) || tag != "stats") return false;
+    in >> s.games >> s.moves >> s.timedMoves >> s.riskyMoves >> s.minLeft
+       >> s.maxFraction;
+
+    for (int k = 0; k < LAT_METRICS * PHASE_COUNT; k++) {
+        int m, p;
+        if (!(in >> tag >> m >> p) || tag != "hist" || m < 0
+            || m >= LAT_METRICS || p < 0 || p >= PHASE_COUNT) {
+            return false;
+        }
+        LatencyHistogram *h = &s.hist[m][p];
+        in >> h->n >> h->sum >> h->max;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) in >> h->counts[i];
+    }
+    if (!in) return false;
+
+    merge(&s);
+    return true;
+}
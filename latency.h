@@ -0,0 +1,70 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <iostream>
+using namespace std;
+
+// Buckets are spaced four to an octave starting at LATENCY_MIN_MS, which
+// covers 10us to about 45 minutes.
+#define LATENCY_BUCKETS     112
+#define LATENCY_MIN_MS      0.01
+
+// Game phases by number of empty squares.
+#define PHASE_OPENING_EMPTIES   40
+#define PHASE_ENDGAME_EMPTIES   12
+
+enum GamePhase {
+    PHASE_OPENING, PHASE_MIDGAME, PHASE_ENDGAME, PHASE_COUNT
+};
+
+enum LatencyMetric {
+    LAT_WALL,       // from reading the request to flushing the reply
+    LAT_SEARCH,     // inside Player::doMove
+    LAT_IO,         // wall time not spent searching
+    LAT_LEFT,       // clock left after the reply, timed games only
+    LAT_METRICS
+};
+
+/*
+ * A log-bucketed histogram of times in milliseconds.
+ */
+class LatencyHistogram {
+
+public:
+    long counts[LATENCY_BUCKETS];
+    long n;
+    double sum;
+    double max;
+
+    LatencyHistogram();
+    void add(double ms);
+    void merge(LatencyHistogram *h);
+    double percentile(double p);
+};
+
+/*
+ * Per-move timings of one or more games, split by phase, plus how close the
+ * moves came to running out of time.
+ */
+class LatencyStats {
+
+public:
+    LatencyHistogram hist[LAT_METRICS][PHASE_COUNT];
+    long games;
+    long moves;
+    long timedMoves;
+    long riskyMoves;    // moves that used over half of the clock left
+    double minLeft;     // smallest clock left after a move
+    double maxFraction; // largest share of the clock used by one move
+
+    LatencyStats();
+    void record(int empties, double wallMs, double searchMs, int msLeft);
+    void merge(LatencyStats *s);
+    void print(ostream &out);
+    bool append(const char *path);
+    bool read(istream &in);
+};
+
+GamePhase game_phase(int empties);
+
+#endif
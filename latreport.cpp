@@ -0,0 +1,31 @@
+#include <iostream>
+#include <fstream>
+#include "latency.h"
+using namespace std;
+
+/*
+ * Aggregates the per-game latency logs written by shakespeare when
+ * OTHELLO_LATENCY_LOG is set, and prints the combined histograms.
+ *
+ * usage: latreport log...   (reads stdin if no files are given)
+ */
+int main(int argc, char *argv[]) {
+    LatencyStats total;
+
+    if (argc == 1) {
+        while (total.read(cin)) {
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        ifstream in(argv[i]);
+        if (!in) {
+            cerr << "cannot read " << argv[i] << endl;
+            return -1;
+        }
+        while (total.read(in)) {
+        }
+    }
+
+    total.print(cout);
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include "mcts.h"
+#include "positions.h"
+#include "threadpool.h"
+#include <cmath>
+#include <pthread.h>
+
+// Depth of the deepest line a thread can walk down the tree.
+#define MCTS_MAX_DEPTH  128
+
+/*
+ * Plays random moves to the end of the game. Returns 2 if the side owning
+ * own wins, 1 for a draw and 0 for a loss.
+ */
+int mcts_playout(uint64_t own, uint64_t opp, uint64_t *rng) {
+    bool swapped = false;
+    bool passed = false;
+
+    for (;;) {
+        uint64_t moves = bb_moves(own, opp);
+        if (moves != 0) {
+            int sq = pos_random_move(moves, rng);
+            uint64_t flips = bb_flips(own, opp, sq);
+            own |= flips | (UINT64_C(1) << sq);
+            opp &= ~flips;
+            passed = false;
+        } else if (passed) {
+            break;
+        } else {
+            passed = true;
+        }
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+        swapped = !swapped;
+    }
+
+    int diff = bb_count(own) - bb_count(opp);
+    if (swapped) diff = -diff;
+    return (diff > 0) ? 2 : (diff == 0) ? 1 : 0;
+}
+
+/*
+ * Allocates the node arena. With usePriors, selection is guided by a cheap
+ * evaluation of each move (PUCT); otherwise plain UCB1 is used.
+ */
+MctsEngine::MctsEngine(int nthreads, int capacity, bool usePriors) {
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > MCTS_MAX_THREADS) nthreads = MCTS_MAX_THREADS;
+    this->nthreads = nthreads;
+    this->capacity = capacity;
+    this->usePriors = usePriors;
+    pool = new MctsNode[capacity];
+    used = 0;
+    playoutCount = 0;
+    timeUp = false;
+}
+
+MctsEngine::~MctsEngine() {
+    delete[] pool;
+}
+
+/*
+ * Reserves n consecutive nodes. Returns -1 once the arena is full.
+ */
+int MctsEngine::allocate(int n) {
+    if (used >= capacity) return -1;
+    int first = __sync_fetch_and_add(&used, n);
+    if (first + n > capacity) return -1;
+    return first;
+}
+
+/*
+ * Adds the children of a leaf. Only one thread expands a node; the children
+ * become visible to the others when nchildren is published.
+ */
+void MctsEngine::expand(MctsNode *node, uint64_t own, uint64_t opp) {
+    if (!__sync_bool_compare_and_swap(&node->expanding, 0, 1)) return;
+
+    uint64_t moves = bb_moves(own, opp);
+    int n = bb_count(moves);
+    if (n == 0 && bb_moves(opp, own) != 0) n = 1;
+
+    int first = (n > 0) ? allocate(n) : 0;
+    if (first < 0) {
+        node->expanding = 0;
+        return;
+    }
+
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        MctsNode *c = &pool[first + i];
+        c->visits = 0;
+        c->wins = 0;
+        c->nchildren = -1;
+        c->expanding = 0;
+        c->firstChild = 0;
+        c->prior = 1.0f;
+
+        if (moves == 0) {
+            c->move = -1;
+            continue;
+        }
+        int sq = bb_first(moves);
+        moves &= moves - 1;
+        c->move = (signed char)sq;
+
+        if (usePriors) {
+            // Favour moves that take corners and leave the opponent few
+            // replies.
+            uint64_t flips = bb_flips(own, opp, sq);
+            uint64_t newOwn = own | flips | (UINT64_C(1) << sq);
+            uint64_t newOpp = opp & ~flips;
+            double key = -0.5 * bb_count(bb_moves(newOpp, newOwn));
+            if ((UINT64_C(1) << sq) & BB_CORNERS) key += 2.0;
+            c->prior = (float)exp(key);
+        }
+        total += c->prior;
+    }
+    for (int i = 0; i < n; i++) {
+        pool[first + i].prior = (float)(pool[first + i].prior / total);
+    }
+
+    node->firstChild = first;
+    __sync_synchronize();
+    node->nchildren = n;
+}
+
+/*
+ * Picks the child to descend into.
+ */
+int MctsEngine::select(MctsNode *node, int parentVisits) {
+    int n = node->nchildren;
+    MctsNode *children = &pool[node->firstChild];
+    double logN = log((double)parentVisits + 1);
+    double sqrtN = sqrt((double)parentVisits + 1);
+    double bestScore = -1e300;
+    int best = 0;
+
+    for (int i = 0; i < n; i++) {
+        int visits = children[i].visits;
+        double q = (visits > 0) ? children[i].wins / (2.0 * visits) : 0.5;
+        double score;
+        if (usePriors) {
+            score = q + MCTS_PUCT * children[i].prior * sqrtN / (1 + visits);
+        } else {
+            if (visits == 0) return i;
+            score = q + MCTS_EXPLORATION * sqrt(logN / visits);
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/*
+ * One select / expand / playout / backup pass.
+ */
+void MctsEngine::iterate(uint64_t *rng) {
+    MctsNode *path[MCTS_MAX_DEPTH];
+    int depth = 0;
+    uint64_t own = rootOwn, opp = rootOpp;
+
+    MctsNode *node = &pool[0];
+    __sync_fetch_and_add(&node->visits, MCTS_VIRTUAL_LOSS);
+    path[depth++] = node;
+
+    bool expanded = false;
+    while (depth < MCTS_MAX_DEPTH) {
+        if (node->nchildren < 0) {
+            if (expanded) break;
+            expand(node, own, opp);
+            if (node->nchildren < 0) break;
+            expanded = true;
+        }
+        if (node->nchildren == 0) break;
+
+        MctsNode *child = &pool[node->firstChild + select(node, node->visits)];
+        if (child->move >= 0) {
+            uint64_t flips = bb_flips(own, opp, child->move);
+            own |= flips | (UINT64_C(1) << child->move);
+            opp &= ~flips;
+        }
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+
+        __sync_fetch_and_add(&child->visits, MCTS_VIRTUAL_LOSS);
+        path[depth++] = child;
+        node = child;
+        if (expanded) break;
+    }
+
+    // path[depth - 1] was entered by the opponent of the side to move now.
+    int value = 2 - mcts_playout(own, opp, rng);
+    for (int k = depth - 1; k >= 0; k--) {
+        __sync_fetch_and_add(&path[k]->wins, value);
+        __sync_fetch_and_add(&path[k]->visits, 1 - MCTS_VIRTUAL_LOSS);
+        value = 2 - value;
+    }
+}
+
+struct MctsThread {
+    MctsEngine *engine;
+    uint64_t seed;
+};
+
+void *MctsEngine::worker(void *arg) {
+    MctsThread *t = (MctsThread *)arg;
+    t->engine->run(t->seed);
+    return NULL;
+}
+
+/*
+ * Searches until the deadline, checking the clock every few playouts.
+ */
+void MctsEngine::run(uint64_t seed) {
+    uint64_t rng = seed | 1;
+    long count = 0;
+    while (!timeUp) {
+        iterate(&rng);
+        count++;
+        if ((count & 31) == 0 && now_ms() >= deadline) timeUp = true;
+    }
+    __sync_fetch_and_add(&playoutCount, count);
+}
+
+/*
+ * Searches the position for ms milliseconds and returns the most visited
+ * move (x + 8*y, or -1 to pass). winRate receives the expected score of
+ * that move for the side to move, between 0 and 1.
+ */
+int MctsEngine::search(uint64_t own, uint64_t opp, double ms,
+                       double *winRate) {
+    rootOwn = own;
+    rootOpp = opp;
+    used = 0;
+    playoutCount = 0;
+    timeUp = false;
+    deadline = now_ms() + ms;
+
+    MctsNode *root = &pool[allocate(1)];
+    root->visits = 0;
+    root->wins = 0;
+    root->nchildren = -1;
+    root->expanding = 0;
+    root->firstChild = 0;
+    root->prior = 1.0f;
+    root->move = -1;
+    expand(root, own, opp);
+    if (root->nchildren <= 0) return -1;
+
+    // A forced move needs no search.
+    if (root->nchildren > 1) {
+        MctsThread args[MCTS_MAX_THREADS];
+        pthread_t threads[MCTS_MAX_THREADS];
+        for (int i = 0; i < nthreads; i++) {
+            args[i].engine = this;
+            args[i].seed = (uint64_t)(now_ms() * 1000) * (2 * i + 1)
+                ^ (UINT64_C(0x9E3779B97F4A7C15) * (i + 1));
+        }
+        // Search with the threads that start.
+        int started = 1;
+        while (started < nthreads
+               && pthread_create(&threads[started], NULL, worker,
+                                 &args[started]) == 0) {
+            started++;
+        }
+        run(args[0].seed);
+        for (int i = 1; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    MctsNode *children = &pool[root->firstChild];
+    int best = 0;
+    for (int i = 1; i < root->nchildren; i++) {
+        if (children[i].visits > children[best].visits) best = i;
+    }
+    if (winRate != NULL) {
+        *winRate = (children[best].visits > 0)
+            ? children[best].wins / (2.0 * children[best].visits) : 0.5;
+    }
+    return children[best].move;
+}
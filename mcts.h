@@ -0,0 +1,67 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include <stdint.h>
+#include "bitboard.h"
+
+// Visits added to a node while a thread is still playing out below it.
+#define MCTS_VIRTUAL_LOSS   3
+
+// UCB1 exploration constant, and the PUCT constant used with priors.
+#define MCTS_EXPLORATION    0.7
+#define MCTS_PUCT           1.5
+
+#define MCTS_MAX_THREADS    64
+
+/*
+ * A tree node. Statistics are from the point of view of the player who made
+ * move, and are updated with atomic adds so threads can share the tree.
+ * Children of a node are stored contiguously in the pool.
+ */
+struct MctsNode {
+    volatile int visits;
+    volatile int wins;          // in half points: 2 per win, 1 per draw
+    volatile int nchildren;     // -1 until the node is expanded
+    volatile int expanding;
+    int firstChild;
+    float prior;
+    signed char move;           // square x + 8*y, or -1 for a pass
+};
+
+/*
+ * Monte Carlo tree search with UCT selection over a preallocated node arena.
+ * Several threads grow the same tree; virtual loss steers them towards
+ * different lines.
+ */
+class MctsEngine {
+
+private:
+    MctsNode *pool;
+    int capacity;
+    volatile int used;
+    int nthreads;
+    bool usePriors;
+
+    uint64_t rootOwn, rootOpp;
+    double deadline;
+    volatile long playoutCount;
+    volatile bool timeUp;
+
+    static void *worker(void *arg);
+    void run(uint64_t seed);
+    void iterate(uint64_t *rng);
+    int select(MctsNode *node, int parentVisits);
+    void expand(MctsNode *node, uint64_t own, uint64_t opp);
+    int allocate(int n);
+
+public:
+    MctsEngine(int nthreads, int capacity, bool usePriors);
+    ~MctsEngine();
+    int search(uint64_t own, uint64_t opp, double ms, double *winRate);
+    long playouts() { return playoutCount; }
+    int nodes() { return used; }
+};
+
+int mcts_playout(uint64_t own, uint64_t opp, uint64_t *rng);
+
+#endif
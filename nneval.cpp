@@ -0,0 +1,290 @@
+#include "nneval.h"
+#include "common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+#define NN_MAGIC        "ONN1"
+#define NN_HEADER       16
+
+// Dividing the layer 2 sums by NN_QW is a shift by this much.
+#define NN_QW_SHIFT     6
+
+static inline int clip(int x, int lo, int hi) {
+    return (x < lo) ? lo : (x > hi) ? hi : x;
+}
+
+/*
+ * First layer: sums of the weight rows of the set inputs, and the change
+ * made by a move to the sums of both points of view.
+ */
+static void scalar_refresh(const NNWeights *net, int16_t *acc, uint64_t own,
+                           uint64_t opp) {
+    memcpy(acc, net->b1, sizeof(net->b1));
+    for (; own; own &= own - 1) {
+        const int16_t *row = net->w1[bb_first(own)];
+        for (int j = 0; j < NN_HIDDEN1; j++) acc[j] += row[j];
+    }
+    for (; opp; opp &= opp - 1) {
+        const int16_t *row = net->w1[64 + bb_first(opp)];
+        for (int j = 0; j < NN_HIDDEN1; j++) acc[j] += row[j];
+    }
+}
+
+static void scalar_update(const NNWeights *net, int16_t *own, int16_t *opp,
+                          int sq, uint64_t flips) {
+    for (int j = 0; j < NN_HIDDEN1; j++) {
+        own[j] += net->w1[sq][j];
+        opp[j] += net->w1[64 + sq][j];
+    }
+    for (; flips; flips &= flips - 1) {
+        int f = bb_first(flips);
+        for (int j = 0; j < NN_HIDDEN1; j++) {
+            int d = net->w1[f][j] - net->w1[64 + f][j];
+            own[j] += d;
+            opp[j] -= d;
+        }
+    }
+}
+
+static AVX2 void avx2_refresh(const NNWeights *net, int16_t *acc,
+                              uint64_t own, uint64_t opp) {
+    __m256i lo = _mm256_load_si256((const __m256i *)net->b1);
+    __m256i hi = _mm256_load_si256((const __m256i *)(net->b1 + 16));
+    for (; own; own &= own - 1) {
+        const int16_t *row = net->w1[bb_first(own)];
+        lo = _mm256_add_epi16(lo, _mm256_load_si256((const __m256i *)row));
+        hi = _mm256_add_epi16(hi,
+            _mm256_load_si256((const __m256i *)(row + 16)));
+    }
+    for (; opp; opp &= opp - 1) {
+        const int16_t *row = net->w1[64 + bb_first(opp)];
+        lo = _mm256_add_epi16(lo, _mm256_load_si256((const __m256i *)row));
+        hi = _mm256_add_epi16(hi,
+            _mm256_load_si256((const __m256i *)(row + 16)));
+    }
+    _mm256_store_si256((__m256i *)acc, lo);
+    _mm256_store_si256((__m256i *)(acc + 16), hi);
+}
+
+static AVX2 void avx2_update(const NNWeights *net, int16_t *own, int16_t *opp,
+                             int sq, uint64_t flips) {
+    for (int j = 0; j < NN_HIDDEN1; j += 16) {
+        __m256i o = _mm256_load_si256((const __m256i *)(own + j));
+        __m256i p = _mm256_load_si256((const __m256i *)(opp + j));
+        o = _mm256_add_epi16(o,
+            _mm256_load_si256((const __m256i *)(net->w1[sq] + j)));
+        p = _mm256_add_epi16(p,
+            _mm256_load_si256((const __m256i *)(net->w1[64 + sq] + j)));
+        for (uint64_t b = flips; b; b &= b - 1) {
+            int f = bb_first(b);
+            __m256i d = _mm256_sub_epi16(
+                _mm256_load_si256((const __m256i *)(net->w1[f] + j)),
+                _mm256_load_si256((const __m256i *)(net->w1[64 + f] + j)));
+            o = _mm256_add_epi16(o, d);
+            p = _mm256_sub_epi16(p, d);
+        }
+        _mm256_store_si256((__m256i *)(own + j), o);
+        _mm256_store_si256((__m256i *)(opp + j), p);
+    }
+}
+
+/*
+ * Layers 2 and 3 from the first layer sums, one unit at a time.
+ */
+static int scalar_forward(const NNWeights *net, const int16_t *acc) {
+    int a1[NN_HIDDEN1];
+    for (int j = 0; j < NN_HIDDEN1; j++) a1[j] = clip(acc[j], 0, NN_QA);
+
+    int out = net->b3;
+    for (int k = 0; k < NN_HIDDEN2; k++) {
+        int sum = net->b2[k];
+        for (int j = 0; j < NN_HIDDEN1; j++) sum += a1[j] * net->w2[k][j];
+        out += clip(sum >> NN_QW_SHIFT, 0, NN_QA) * net->w3[k];
+    }
+    return out;
+}
+
+/*
+ * Sums the 8 lanes of each of s[0..7] into the 8 lanes of the result.
+ */
+static inline AVX2 __m256i hsum8x8(const __m256i *s) {
+    __m256i h01 = _mm256_hadd_epi32(s[0], s[1]);
+    __m256i h23 = _mm256_hadd_epi32(s[2], s[3]);
+    __m256i h45 = _mm256_hadd_epi32(s[4], s[5]);
+    __m256i h67 = _mm256_hadd_epi32(s[6], s[7]);
+    __m256i lo = _mm256_hadd_epi32(h01, h23);
+    __m256i hi = _mm256_hadd_epi32(h45, h67);
+    return _mm256_add_epi32(_mm256_permute2x128_si256(lo, hi, 0x20),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+/*
+ * The same computation as scalar_forward. The clipped layer 1 outputs are
+ * packed into bytes so that layer 2 is one multiply-add per unit.
+ */
+static AVX2 int avx2_forward(const NNWeights *net, const int16_t *acc) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i qa = _mm256_set1_epi16(NN_QA);
+    __m256i lo = _mm256_load_si256((const __m256i *)acc);
+    __m256i hi = _mm256_load_si256((const __m256i *)(acc + 16));
+    lo = _mm256_min_epi16(_mm256_max_epi16(lo, zero), qa);
+    hi = _mm256_min_epi16(_mm256_max_epi16(hi, zero), qa);
+    // packus interleaves the 128 bit halves of its inputs.
+    __m256i a1 = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i qa32 = _mm256_set1_epi32(NN_QA);
+    __m256i out = zero;
+    for (int k = 0; k < NN_HIDDEN2; k += 8) {
+        __m256i s[8];
+        for (int i = 0; i < 8; i++) {
+            __m256i w = _mm256_load_si256((const __m256i *)net->w2[k + i]);
+            s[i] = _mm256_madd_epi16(_mm256_maddubs_epi16(a1, w), ones);
+        }
+        __m256i sum = _mm256_add_epi32(hsum8x8(s),
+            _mm256_load_si256((const __m256i *)(net->b2 + k)));
+        __m256i a2 = _mm256_min_epi32(
+            _mm256_max_epi32(_mm256_srai_epi32(sum, NN_QW_SHIFT), zero), qa32);
+        __m256i w3 = _mm256_cvtepi16_epi32(
+            _mm_load_si128((const __m128i *)(net->w3 + k)));
+        out = _mm256_add_epi32(out, _mm256_mullo_epi32(a2, w3));
+    }
+
+    __m128i o = _mm_add_epi32(_mm256_castsi256_si128(out),
+                              _mm256_extracti128_si256(out, 1));
+    o = _mm_add_epi32(o, _mm_shuffle_epi32(o, 0x4E));
+    o = _mm_add_epi32(o, _mm_shuffle_epi32(o, 0xB1));
+    return net->b3 + _mm_cvtsi128_si32(o);
+}
+
+/*
+ * Starts with all weights zero; load() or weights() fill them in. AVX2 is
+ * used if the CPU has it.
+ */
+NNEval::NNEval() {
+    void *p = NULL;
+    if (posix_memalign(&p, 64, sizeof(NNWeights)) != 0) p = NULL;
+    net = (NNWeights *)p;
+    if (net != NULL) memset(net, 0, sizeof(NNWeights));
+    ready = false;
+    avx2 = use_avx2(true);
+}
+
+NNEval::~NNEval() {
+    free(net);
+}
+
+/*
+ * Turns the AVX2 code on or off (for testing). Returns whether it is on,
+ * which it cannot be on a CPU without AVX2.
+ */
+bool NNEval::use_avx2(bool on) {
+    __builtin_cpu_init();
+    avx2 = on && __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+/*
+ * Reads weights written by save(). Returns false, leaving the evaluator
+ * unusable, if the file is missing or was written for a different network
+ * shape.
+ */
+bool NNEval::load(const char *path) {
+    ready = false;
+    if (net == NULL) return false;
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return false;
+
+    char header[NN_HEADER];
+    uint32_t dims[3];
+    bool ok = fread(header, 1, sizeof(header), fp) == sizeof(header);
+    memcpy(dims, header + 4, sizeof(dims));
+    ok = ok && memcmp(header, NN_MAGIC, 4) == 0 && dims[0] == NN_INPUTS
+        && dims[1] == NN_HIDDEN1 && dims[2] == NN_HIDDEN2;
+    ok = ok && fread(net->w1, sizeof(net->w1), 1, fp) == 1
+        && fread(net->b1, sizeof(net->b1), 1, fp) == 1
+        && fread(net->w2, sizeof(net->w2), 1, fp) == 1
+        && fread(net->b2, sizeof(net->b2), 1, fp) == 1
+        && fread(net->w3, sizeof(net->w3), 1, fp) == 1
+        && fread(&net->b3, sizeof(net->b3), 1, fp) == 1;
+    fclose(fp);
+    ready = ok;
+    return ok;
+}
+
+bool NNEval::save(const char *path) {
+    if (net == NULL) return false;
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return false;
+
+    char header[NN_HEADER];
+    uint32_t dims[3] = { NN_INPUTS, NN_HIDDEN1, NN_HIDDEN2 };
+    memset(header, 0, sizeof(header));
+    memcpy(header, NN_MAGIC, 4);
+    memcpy(header + 4, dims, sizeof(dims));
+    bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+        && fwrite(net->w1, sizeof(net->w1), 1, fp) == 1
+        && fwrite(net->b1, sizeof(net->b1), 1, fp) == 1
+        && fwrite(net->w2, sizeof(net->w2), 1, fp) == 1
+        && fwrite(net->b2, sizeof(net->b2), 1, fp) == 1
+        && fwrite(net->w3, sizeof(net->w3), 1, fp) == 1
+        && fwrite(&net->b3, sizeof(net->b3), 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+    return ok;
+}
+
+/*
+ * First layer sums of one point of view, from scratch.
+ */
+void NNEval::refresh_side(int16_t *acc, uint64_t own, uint64_t opp) {
+    if (avx2) avx2_refresh(net, acc, own, opp);
+    else scalar_refresh(net, acc, own, opp);
+}
+
+int NNEval::forward(const int16_t *acc) {
+    int64_t out = avx2 ? avx2_forward(net, acc) : scalar_forward(net, acc);
+    return (int)(out * NN_OUTPUT_SCALE / (NN_QA * NN_QO));
+}
+
+void NNEval::refresh(NNAccumulator *acc, uint64_t black, uint64_t white) {
+    refresh_side(acc->v[BLACK], black, white);
+    refresh_side(acc->v[WHITE], white, black);
+}
+
+/*
+ * Sets to to the accumulator of the position after mover (BLACK or WHITE)
+ * plays sq flipping flips, given the accumulator from of the position
+ * before. from and to may be the same.
+ */
+void NNEval::update(const NNAccumulator *from, NNAccumulator *to, int mover,
+                    int sq, uint64_t flips) {
+    if (from != to) memcpy(to, from, sizeof(NNAccumulator));
+    if (avx2) avx2_update(net, to->v[mover], to->v[mover ^ 1], sq, flips);
+    else scalar_update(net, to->v[mover], to->v[mover ^ 1], sq, flips);
+}
+
+/*
+ * Score of the position in acc for side (BLACK or WHITE) to move.
+ */
+int NNEval::evaluate(const NNAccumulator *acc, int side) {
+    return forward(acc->v[side]);
+}
+
+/*
+ * Score for the side owning own, with own to move, without an accumulator.
+ */
+int NNEval::evaluate(uint64_t own, uint64_t opp) {
+    int16_t acc[NN_HIDDEN1] __attribute__((aligned(32)));
+    refresh_side(acc, own, opp);
+    return forward(acc);
+}
+
+void NNEval::evaluate_batch(const BoardPair *boards, int *scores, int n) {
+    for (int i = 0; i < n; i++) {
+        scores[i] = evaluate(boards[i].own, boards[i].opp);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __NNEVAL_H__
+#define __NNEVAL_H__
+
+#include <stdint.h>
+#include "bitboard.h"
+#include "simdboard.h"
+
+/*
+ * Small quantized neural network evaluator.
+ *
+ * The input layer has one input per square for the stones of the side to
+ * move and one per square for its opponent (128 in all). Two hidden layers
+ * of NN_HIDDEN1 and NN_HIDDEN2 units with clipped ReLU activations feed a
+ * single output, which is a score in the same units as evaluate().
+ *
+ * Quantization:
+ *   layer 1  int16 weights and biases scaled by NN_QA; the activation is the
+ *            int16 sum clipped to 0..NN_QA, so it fits in a byte
+ *   layer 2  int8 weights scaled by NN_QW and int32 biases scaled by
+ *            NN_QA * NN_QW; the sum is divided by NN_QW and clipped to
+ *            0..NN_QA
+ *   output   int16 weights scaled by NN_QO and an int32 bias scaled by
+ *            NN_QA * NN_QO, giving NN_OUTPUT_SCALE evaluation units per
+ *            unit of network output
+ *
+ * Layer 1 is the expensive part and depends only on which inputs are set,
+ * so it is kept in an accumulator that moves update incrementally: a move
+ * adds one column and swaps the columns of the flipped stones. Because the
+ * inputs depend on the side to move, an accumulator holds the sums for both
+ * points of view.
+ */
+
+#define NN_INPUTS       128
+#define NN_HIDDEN1      32
+#define NN_HIDDEN2      32
+
+#define NN_QA           127
+#define NN_QW           64
+#define NN_QO           256
+#define NN_OUTPUT_SCALE 64
+
+/*
+ * First layer sums of a position. v[BLACK] holds them with black as the
+ * side to move, v[WHITE] with white as the side to move (sides as in
+ * common.h).
+ */
+struct NNAccumulator {
+    int16_t v[2][NN_HIDDEN1] __attribute__((aligned(32)));
+};
+
+/*
+ * Network weights, laid out for inference. Rows of w1 are inputs; rows of w2
+ * are layer 2 units.
+ */
+struct NNWeights {
+    int16_t w1[NN_INPUTS][NN_HIDDEN1] __attribute__((aligned(32)));
+    int16_t b1[NN_HIDDEN1] __attribute__((aligned(32)));
+    int8_t w2[NN_HIDDEN2][NN_HIDDEN1] __attribute__((aligned(32)));
+    int32_t b2[NN_HIDDEN2] __attribute__((aligned(32)));
+    int16_t w3[NN_HIDDEN2] __attribute__((aligned(32)));
+    int32_t b3;
+};
+
+class NNEval {
+
+private:
+    NNWeights *net;
+    bool ready;
+    bool avx2;
+
+    void refresh_side(int16_t *acc, uint64_t own, uint64_t opp);
+    int forward(const int16_t *acc);
+
+public:
+    NNEval();
+    ~NNEval();
+    bool load(const char *path);
+    bool save(const char *path);
+    bool loaded() { return ready; }
+    NNWeights *weights() { return net; }
+    bool use_avx2(bool on);
+
+    void refresh(NNAccumulator *acc, uint64_t black, uint64_t white);
+    void update(const NNAccumulator *from, NNAccumulator *to, int mover,
+                int sq, uint64_t flips);
+    int evaluate(const NNAccumulator *acc, int side);
+    int evaluate(uint64_t own, uint64_t opp);
+    void evaluate_batch(const BoardPair *boards, int *scores, int n);
+};
+
+#endif
@@ -0,0 +1,401 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "nneval.h"
+#include "eval.h"
+#include "positions.h"
+#include "threadpool.h"
+#include "common.h"
+using namespace std;
+
+/*
+ * Writes and checks weight files for the network evaluator.
+ *
+ *   nntool train positions out [epochs]
+ *       Fits a network to a position file (see posgen) and writes quantized
+ *       weights. Positions are labelled with the handcrafted evaluation, so
+ *       the result is a network that reproduces it; it is a starting point
+ *       for weights trained on game results.
+ *
+ *   nntool bench weights [positions]
+ *       Checks that the AVX2 and portable code agree and that incremental
+ *       updates match evaluation from scratch, then compares the cost of an
+ *       evaluation with that of the handcrafted one.
+ */
+
+// Largest float weights that still quantize without overflow: 64 stones
+// plus the bias must fit the int16 layer 1 sums.
+#define W1_LIMIT    3.5f
+#define W2_LIMIT    (127.0f / NN_QW)
+#define W3_LIMIT    (32767.0f / NN_QO)
+
+#define BATCH       256
+#define RATE        0.001f
+
+static uint64_t rng_state = UINT64_C(0x9E3779B97F4A7C15);
+
+static float uniform(float limit) {
+    return limit
+        * (2.0f * (pos_random(&rng_state) >> 11) / 9007199254740992.0f - 1);
+}
+
+static float clampf(float x, float lo, float hi) {
+    return (x < lo) ? lo : (x > hi) ? hi : x;
+}
+
+/*
+ * The network in floating point, with Adam moments for every parameter.
+ * All parameters sit in one array so the optimizer can treat them alike.
+ */
+struct FloatNet {
+    vector<float> p, grad, m, v;
+    float *w1, *b1, *w2, *b2, *w3, *b3;
+    int step;
+
+    FloatNet() {
+        int n = NN_INPUTS * NN_HIDDEN1 + NN_HIDDEN1 + NN_HIDDEN2 * NN_HIDDEN1
+            + NN_HIDDEN2 + NN_HIDDEN2 + 1;
+        p.assign(n, 0);
+        grad.assign(n, 0);
+        m.assign(n, 0);
+        v.assign(n, 0);
+        w1 = &p[0];
+        b1 = w1 + NN_INPUTS * NN_HIDDEN1;
+        w2 = b1 + NN_HIDDEN1;
+        b2 = w2 + NN_HIDDEN2 * NN_HIDDEN1;
+        w3 = b2 + NN_HIDDEN2;
+        b3 = w3 + NN_HIDDEN2;
+        step = 0;
+
+        for (int i = 0; i < NN_INPUTS * NN_HIDDEN1; i++) w1[i] = uniform(0.2f);
+        for (int i = 0; i < NN_HIDDEN1; i++) b1[i] = 0.5f;
+        for (int i = 0; i < NN_HIDDEN2 * NN_HIDDEN1; i++) {
+            w2[i] = uniform(sqrtf(6.0f / NN_HIDDEN1));
+        }
+        for (int i = 0; i < NN_HIDDEN2; i++) w3[i] = uniform(1.0f);
+    }
+
+    /*
+     * Squared error on one position; adds its gradient to grad.
+     */
+    float train(uint64_t own, uint64_t opp, float target) {
+        float *g1 = &grad[0];
+        float *gb1 = g1 + (b1 - w1), *g2 = g1 + (w2 - w1);
+        float *gb2 = g1 + (b2 - w1), *g3 = g1 + (w3 - w1);
+        float *gb3 = g1 + (b3 - w1);
+
+        float z1[NN_HIDDEN1], a1[NN_HIDDEN1], z2[NN_HIDDEN2], a2[NN_HIDDEN2];
+        for (int j = 0; j < NN_HIDDEN1; j++) z1[j] = b1[j];
+        for (uint64_t b = own; b; b &= b - 1) {
+            const float *row = w1 + bb_first(b) * NN_HIDDEN1;
+            for (int j = 0; j < NN_HIDDEN1; j++) z1[j] += row[j];
+        }
+        for (uint64_t b = opp; b; b &= b - 1) {
+            const float *row = w1 + (64 + bb_first(b)) * NN_HIDDEN1;
+            for (int j = 0; j < NN_HIDDEN1; j++) z1[j] += row[j];
+        }
+        for (int j = 0; j < NN_HIDDEN1; j++) a1[j] = clampf(z1[j], 0, 1);
+
+        float out = *b3;
+        for (int k = 0; k < NN_HIDDEN2; k++) {
+            z2[k] = b2[k];
+            for (int j = 0; j < NN_HIDDEN1; j++) {
+                z2[k] += a1[j] * w2[k * NN_HIDDEN1 + j];
+            }
+            a2[k] = clampf(z2[k], 0, 1);
+            out += a2[k] * w3[k];
+        }
+
+        float err = out - target;
+        float d1[NN_HIDDEN1];
+        memset(d1, 0, sizeof(d1));
+        *gb3 += err;
+        for (int k = 0; k < NN_HIDDEN2; k++) {
+            g3[k] += err * a2[k];
+            if (z2[k] <= 0 || z2[k] >= 1) continue;
+            float d2 = err * w3[k];
+            gb2[k] += d2;
+            for (int j = 0; j < NN_HIDDEN1; j++) {
+                g2[k * NN_HIDDEN1 + j] += d2 * a1[j];
+                d1[j] += d2 * w2[k * NN_HIDDEN1 + j];
+            }
+        }
+        for (int j = 0; j < NN_HIDDEN1; j++) {
+            if (z1[j] <= 0 || z1[j] >= 1) d1[j] = 0;
+            gb1[j] += d1[j];
+        }
+        for (uint64_t b = own; b; b &= b - 1) {
+            float *row = g1 + bb_first(b) * NN_HIDDEN1;
+            for (int j = 0; j < NN_HIDDEN1; j++) row[j] += d1[j];
+        }
+        for (uint64_t b = opp; b; b &= b - 1) {
+            float *row = g1 + (64 + bb_first(b)) * NN_HIDDEN1;
+            for (int j = 0; j < NN_HIDDEN1; j++) row[j] += d1[j];
+        }
+        return err * err;
+    }
+
+    /*
+     * One Adam step with the gradient summed over n positions, then clears
+     * the gradient and clips the weights to what quantization can hold.
+     */
+    void update(int n) {
+        step++;
+        float c1 = 1 - powf(0.9f, step), c2 = 1 - powf(0.999f, step);
+        for (size_t i = 0; i < p.size(); i++) {
+            float g = grad[i] / n;
+            m[i] = 0.9f * m[i] + 0.1f * g;
+            v[i] = 0.999f * v[i] + 0.001f * g * g;
+            p[i] -= RATE * (m[i] / c1) / (sqrtf(v[i] / c2) + 1e-8f);
+            grad[i] = 0;
+        }
+        for (int i = 0; i < NN_INPUTS * NN_HIDDEN1; i++) {
+            w1[i] = clampf(w1[i], -W1_LIMIT, W1_LIMIT);
+        }
+        for (int i = 0; i < NN_HIDDEN1; i++) {
+            b1[i] = clampf(b1[i], -W1_LIMIT, W1_LIMIT);
+        }
+        for (int i = 0; i < NN_HIDDEN2 * NN_HIDDEN1; i++) {
+            w2[i] = clampf(w2[i], -W2_LIMIT, W2_LIMIT);
+        }
+        for (int i = 0; i < NN_HIDDEN2; i++) {
+            w3[i] = clampf(w3[i], -W3_LIMIT, W3_LIMIT);
+        }
+    }
+
+    void quantize(NNWeights *q) {
+        for (int i = 0; i < NN_INPUTS; i++) {
+            for (int j = 0; j < NN_HIDDEN1; j++) {
+                q->w1[i][j] = (int16_t)lrintf(w1[i * NN_HIDDEN1 + j] * NN_QA);
+            }
+        }
+        for (int j = 0; j < NN_HIDDEN1; j++) {
+            q->b1[j] = (int16_t)lrintf(b1[j] * NN_QA);
+        }
+        for (int k = 0; k < NN_HIDDEN2; k++) {
+            for (int j = 0; j < NN_HIDDEN1; j++) {
+                q->w2[k][j] = (int8_t)lrintf(w2[k * NN_HIDDEN1 + j] * NN_QW);
+            }
+            q->b2[k] = (int32_t)lrintf(b2[k] * NN_QA * NN_QW);
+            q->w3[k] = (int16_t)lrintf(w3[k] * NN_QO);
+        }
+        q->b3 = (int32_t)lrintf(*b3 * NN_QA * NN_QO);
+    }
+};
+
+static int train(const char *positions, const char *out, int epochs) {
+    PositionReader reader;
+    if (!reader.open(positions) || reader.size() == 0) {
+        fprintf(stderr, "cannot read %s\n", positions);
+        return 1;
+    }
+    const PositionRecord *recs = reader.data();
+    int n = (int)reader.size();
+    vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+
+    // Hold back a tenth of the positions to report how well the network
+    // generalizes.
+    int held = n / 10;
+    FloatNet net;
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        for (int i = n - held - 1; i > 0; i--) {
+            int j = (int)(pos_random(&rng_state) % (i + 1));
+            int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+
+        double loss = 0;
+        for (int start = 0; start < n - held; start += BATCH) {
+            int len = (n - held - start < BATCH) ? n - held - start : BATCH;
+            for (int i = start; i < start + len; i++) {
+                const PositionRecord &r = recs[order[i]];
+                loss += net.train(r.own, r.opp, (float)evaluate(r.own, r.opp)
+                                  / NN_OUTPUT_SCALE);
+            }
+            net.update(len);
+        }
+
+        NNEval nn;
+        net.quantize(nn.weights());
+        double err = 0;
+        for (int i = n - held; i < n; i++) {
+            const PositionRecord &r = recs[order[i]];
+            double d = nn.evaluate(r.own, r.opp) - evaluate(r.own, r.opp);
+            err += d * d;
+        }
+        printf("epoch %d: train rms %.2f, held out rms %.2f (quantized)\n",
+               epoch + 1, sqrt(loss / (n - held)) * NN_OUTPUT_SCALE,
+               (held > 0) ? sqrt(err / held) : 0.0);
+    }
+
+    NNEval nn;
+    net.quantize(nn.weights());
+    if (!nn.save(out)) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Plays random games and collects every position reached, together with the
+ * move played from it.
+ */
+static void random_games(vector<BoardPair> &boards, vector<int> &moves,
+                         int count) {
+    uint64_t own = 0, opp = 0;
+    while ((int)boards.size() < count) {
+        uint64_t legal = bb_moves(own, opp);
+        if (legal == 0 && bb_moves(opp, own) == 0) {
+            own = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+            opp = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+            legal = bb_moves(own, opp);
+        }
+        int sq = -1;
+        if (legal != 0) {
+            sq = pos_random_move(legal, &rng_state);
+        }
+        BoardPair b = { own, opp };
+        boards.push_back(b);
+        moves.push_back(sq);
+
+        if (sq >= 0) {
+            uint64_t flips = bb_flips(own, opp, sq);
+            own |= flips | (UINT64_C(1) << sq);
+            opp &= ~flips;
+        }
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+    }
+}
+
+/*
+ * Replays games from random_games() keeping an accumulator up to date move
+ * by move, and evaluates each position from it. With check set, also
+ * compares the accumulator against one computed from scratch; returns the
+ * number that differ.
+ */
+static int walk(NNEval &nn, vector<BoardPair> &games, vector<int> &played,
+                bool check, long *sink) {
+    const uint64_t startPos = BB_SQUARE(3, 3) | BB_SQUARE(4, 4)
+        | BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+    NNAccumulator acc, fresh;
+    uint64_t black = 0, white = 0;
+    int side = BLACK, wrong = 0;
+
+    for (size_t i = 0; i < games.size(); i++) {
+        // Each game starts with its first player as black.
+        if ((games[i].own | games[i].opp) == startPos) {
+            side = BLACK;
+            black = games[i].own;
+            white = games[i].opp;
+            nn.refresh(&acc, black, white);
+        }
+        if (check) {
+            nn.refresh(&fresh, black, white);
+            if (memcmp(&acc, &fresh, sizeof(acc)) != 0) wrong++;
+        }
+        *sink += nn.evaluate(&acc, side);
+
+        int sq = played[i];
+        if (sq >= 0) {
+            uint64_t *own = (side == BLACK) ? &black : &white;
+            uint64_t *opp = (side == BLACK) ? &white : &black;
+            uint64_t flips = bb_flips(*own, *opp, sq);
+            nn.update(&acc, &acc, side, sq, flips);
+            *own |= flips | (UINT64_C(1) << sq);
+            *opp &= ~flips;
+        }
+        side ^= 1;
+    }
+    return wrong;
+}
+
+static int bench(const char *weights, const char *positions) {
+    NNEval nn;
+    if (!nn.load(weights)) {
+        fprintf(stderr, "cannot read %s\n", weights);
+        return 1;
+    }
+
+    vector<BoardPair> boards;
+    vector<int> moves;
+    PositionReader reader;
+    if (positions != NULL && reader.open(positions)) {
+        for (size_t i = 0; i < reader.size(); i++) {
+            BoardPair b = { reader.data()[i].own, reader.data()[i].opp };
+            boards.push_back(b);
+        }
+    } else {
+        random_games(boards, moves, 1 << 20);
+    }
+    int n = (int)boards.size();
+    vector<int> scores(n), check(n);
+
+    // AVX2 against the portable code.
+    int mismatches = 0;
+    bool avx2 = nn.use_avx2(false);
+    for (int i = 0; i < n; i++) {
+        scores[i] = nn.evaluate(boards[i].own, boards[i].opp);
+    }
+    if (nn.use_avx2(true)) {
+        avx2 = true;
+        for (int i = 0; i < n; i++) {
+            if (nn.evaluate(boards[i].own, boards[i].opp) != scores[i]) {
+                mismatches++;
+            }
+        }
+    }
+    printf("avx2 %s, %d of %d scores differ from the portable code\n",
+           avx2 ? "on" : "not available", mismatches, n);
+
+    // Incremental updates along random games.
+    vector<BoardPair> games;
+    vector<int> played;
+    random_games(games, played, 1 << 16);
+    long sink = 0;
+    int wrong = walk(nn, games, played, true, &sink);
+    printf("%d of %d incremental updates differ from a refresh\n", wrong,
+           (int)games.size());
+
+    // Timing. sink keeps the compiler from dropping the work.
+    double start = now_ms();
+    for (int i = 0; i < n; i++) sink += evaluate(boards[i].own, boards[i].opp);
+    double handMs = now_ms() - start;
+
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        sink += nn.evaluate(boards[i].own, boards[i].opp);
+    }
+    double fullMs = now_ms() - start;
+
+    start = now_ms();
+    nn.evaluate_batch(&boards[0], &check[0], n);
+    double batchMs = now_ms() - start;
+
+    start = now_ms();
+    walk(nn, games, played, false, &sink);
+    double incMs = now_ms() - start;
+
+    printf("ns per evaluation: handcrafted %.1f, network %.1f, batch %.1f, "
+           "incremental %.1f (%ld)\n", handMs * 1e6 / n, fullMs * 1e6 / n,
+           batchMs * 1e6 / n, incMs * 1e6 / games.size(), sink & 1);
+    return (mismatches == 0 && wrong == 0) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "train") == 0) {
+        return train(argv[2], argv[3], (argc > 4) ? atoi(argv[4]) : 10);
+    }
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0) {
+        return bench(argv[2], (argc > 3) ? argv[3] : NULL);
+    }
+    fprintf(stderr, "usage: nntool train positions out [epochs]\n"
+            "       nntool bench weights [positions]\n");
+    return 1;
+}
@@ -0,0 +1,228 @@
+#include "othello.h"
+#include <pthread.h>
+#include <string>
+#include "player.h"
+#include "endgame.h"
+#include "eval.h"
+
+/*
+ * An engine instance: the position being analysed plus the search state,
+ * guarded by one lock.
+ */
+struct othello_engine {
+    pthread_mutex_t lock;
+    Board board;
+    Side side;
+    Player *player;
+    EndgameSolver *solver;
+    string network;         // files for new players; empty for none
+    string params;
+};
+
+static Side to_side(int side) {
+    return (side == OTHELLO_BLACK) ? BLACK : WHITE;
+}
+
+static Side other_side(Side side) {
+    return (side == BLACK) ? WHITE : BLACK;
+}
+
+/*
+ * Makes an engine holding the standard starting position, black to move.
+ */
+othello_engine *othello_new(void) {
+    othello_engine *e = new othello_engine();
+    pthread_mutex_init(&e->lock, NULL);
+    e->side = BLACK;
+    e->player = NULL;
+    e->solver = NULL;
+    return e;
+}
+
+void othello_free(othello_engine *e) {
+    if (e == NULL) return;
+    delete e->player;
+    delete e->solver;
+    pthread_mutex_destroy(&e->lock);
+    delete e;
+}
+
+int othello_set_position(othello_engine *e, const char *board, int side) {
+    if (e == NULL || board == NULL) return -1;
+    if (side != OTHELLO_BLACK && side != OTHELLO_WHITE) return -1;
+
+    uint64_t black = 0, white = 0;
+    for (int i = 0; i < 64; i++) {
+        if (board[i] == 'b') black |= UINT64_C(1) << i;
+        else if (board[i] == 'w') white |= UINT64_C(1) << i;
+    }
+
+    pthread_mutex_lock(&e->lock);
+    e->board.setBits(black, white);
+    e->side = to_side(side);
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+int othello_get_position(othello_engine *e, char *board, int *side) {
+    if (e == NULL || board == NULL) return -1;
+
+    pthread_mutex_lock(&e->lock);
+    uint64_t black = e->board.getBits(BLACK);
+    uint64_t white = e->board.getBits(WHITE);
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = UINT64_C(1) << i;
+        board[i] = (black & bit) ? 'b' : (white & bit) ? 'w' : '.';
+    }
+    if (side != NULL) *side = (e->side == BLACK) ? OTHELLO_BLACK : OTHELLO_WHITE;
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+int othello_play(othello_engine *e, int x, int y) {
+    if (e == NULL) return -1;
+
+    int ret = -1;
+    pthread_mutex_lock(&e->lock);
+    if (x == -1 && y == -1) {
+        if (!e->board.hasMoves(e->side)) {
+            e->side = other_side(e->side);
+            ret = 0;
+        }
+    } else if (0 <= x && x < 8 && 0 <= y && y < 8) {
+        Move move(x, y);
+        if (e->board.checkMove(&move, e->side)) {
+            e->board.doMove(&move, e->side);
+            e->side = other_side(e->side);
+            ret = 0;
+        }
+    }
+    pthread_mutex_unlock(&e->lock);
+    return ret;
+}
+
+int othello_legal_moves(othello_engine *e, int *xs, int *ys, int max) {
+    if (e == NULL) return -1;
+
+    pthread_mutex_lock(&e->lock);
+    uint64_t moves = bb_moves(e->board.getBits(e->side),
+                              e->board.getBits(other_side(e->side)));
+    pthread_mutex_unlock(&e->lock);
+
+    int n = 0;
+    while (moves) {
+        int sq = bb_first(moves);
+        moves &= moves - 1;
+        if (n < max) {
+            if (xs != NULL) xs[n] = sq % 8;
+            if (ys != NULL) ys[n] = sq / 8;
+        }
+        n++;
+    }
+    return n;
+}
+
+int othello_set_files(othello_engine *e, const char *network,
+                      const char *params) {
+    if (e == NULL) return -1;
+    NNEval nn;
+    TuneParams tuning;
+    if (network != NULL && !nn.load(network)) return -1;
+    if (params != NULL && !tuning.load(params)) return -1;
+
+    pthread_mutex_lock(&e->lock);
+    e->network = (network != NULL) ? network : "";
+    e->params = (params != NULL) ? params : "";
+    // The next search makes a player that loads them.
+    delete e->player;
+    e->player = NULL;
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+/*
+ * Searches the current position with the engine's usual move selection:
+ * minimax, tree search or alpha-beta, and an exact solve near the end of
+ * the game.
+ */
+int othello_search(othello_engine *e, const othello_limits *limits,
+                   othello_result *result) {
+    if (e == NULL || limits == NULL || result == NULL) return -1;
+    int threads = (limits->threads > 0) ? limits->threads : 1;
+
+    pthread_mutex_lock(&e->lock);
+    // The solver and tree search are sized when first used, so a change in
+    // thread count needs a fresh player.
+    if (e->player != NULL && e->player->search_threads != threads) {
+        delete e->player;
+        e->player = NULL;
+    }
+    if (e->player == NULL) {
+        e->player = new Player(e->side, &e->board,
+                               e->network.empty() ? NULL : e->network.c_str(),
+                               e->params.empty() ? NULL : e->params.c_str());
+        e->player->search_threads = threads;
+        e->player->showBoard = false;
+    }
+
+    Player *p = e->player;
+    p->set_position(&e->board, e->side);
+    switch (limits->mode) {
+    case OTHELLO_MODE_MCTS:     p->mode = MODE_MCTS; break;
+    case OTHELLO_MODE_SEARCH:   p->mode = MODE_SEARCH; break;
+    default:                    p->mode = MODE_MINIMAX; break;
+    }
+    p->move_ms = (limits->ms > 0) ? limits->ms : 0;
+
+    int empties = p->empties();
+    Move *move = p->doMove(NULL, -1);
+    result->x = (move != NULL) ? move->getX() : -1;
+    result->y = (move != NULL) ? move->getY() : -1;
+    result->score = p->last_score();
+    result->exact = (move != NULL && empties <= p->tuning.integer(TUNE_ENDGAME_EMPTIES)) ? 1 : 0;
+    delete move;
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+int othello_solve(othello_engine *e, int threads, othello_result *result) {
+    if (e == NULL || result == NULL) return -1;
+    if (threads < 1) threads = 1;
+
+    pthread_mutex_lock(&e->lock);
+    uint64_t own = e->board.getBits(e->side);
+    uint64_t opp = e->board.getBits(other_side(e->side));
+    if (64 - bb_count(own | opp) > OTHELLO_MAX_SOLVE_EMPTIES) {
+        pthread_mutex_unlock(&e->lock);
+        return -1;
+    }
+
+    if (e->solver != NULL && e->solver->threads() != threads) {
+        delete e->solver;
+        e->solver = NULL;
+    }
+    if (e->solver == NULL) e->solver = new EndgameSolver(threads);
+
+    int best;
+    result->score = e->solver->solve(own, opp, &best);
+    result->x = (best >= 0) ? best % 8 : -1;
+    result->y = (best >= 0) ? best / 8 : -1;
+    result->exact = 1;
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+void othello_evaluate_batch(const othello_position *positions, int *scores,
+                            int n) {
+    BoardPair boards[256];
+    for (int start = 0; start < n; start += 256) {
+        int len = (n - start < 256) ? n - start : 256;
+        for (int i = 0; i < len; i++) {
+            const othello_position *p = &positions[start + i];
+            bool black = (p->side == OTHELLO_BLACK);
+            boards[i].own = black ? p->black : p->white;
+            boards[i].opp = black ? p->white : p->black;
+        }
+        evaluate_batch(boards, scores + start, len);
+    }
+}
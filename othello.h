@@ -0,0 +1,92 @@
+#ifndef __OTHELLO_H__
+#define __OTHELLO_H__
+
+/*
+ * C interface to the engine, built as libothello.a / libothello.so.
+ *
+ * Each engine instance holds a position and its own search state. Calls on
+ * one instance are serialized by a lock inside the instance, and separate
+ * instances share nothing, so a host may run many of them from different
+ * threads at once.
+ *
+ * Squares are given as (x, y) with 0 <= x, y < 8 and (0, 0) the upper-left
+ * corner; a move of (-1, -1) is a pass. Functions returning int return 0 on
+ * success and -1 on error unless noted otherwise.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTHELLO_WHITE       0
+#define OTHELLO_BLACK       1
+
+#define OTHELLO_MODE_MINIMAX    0
+#define OTHELLO_MODE_MCTS       1
+#define OTHELLO_MODE_SEARCH     2   /* iterative deepening alpha-beta */
+
+/* Largest number of empties othello_solve accepts. */
+#define OTHELLO_MAX_SOLVE_EMPTIES   30
+
+typedef struct othello_engine othello_engine;
+
+/* A position for batch evaluation, one bitboard per colour (bit x + 8*y). */
+typedef struct {
+    uint64_t black;
+    uint64_t white;
+    int side;
+} othello_position;
+
+typedef struct {
+    int mode;       /* OTHELLO_MODE_* */
+    int ms;         /* time for tree and alpha-beta search; ignored by
+                       minimax */
+    int threads;    /* threads for tree search and the endgame solver */
+} othello_limits;
+
+typedef struct {
+    int x, y;       /* best move, (-1, -1) to pass */
+    int score;      /* for the side to move */
+    int exact;      /* 1 if score is the exact final disc difference */
+} othello_result;
+
+othello_engine *othello_new(void);
+void othello_free(othello_engine *e);
+
+/* board holds 64 characters indexed x + 8*y: 'b' black, 'w' white, anything
+ * else empty. */
+int othello_set_position(othello_engine *e, const char *board, int side);
+int othello_get_position(othello_engine *e, char *board, int *side);
+
+/* Plays a move for the side to move; fails if it is illegal. */
+int othello_play(othello_engine *e, int x, int y);
+
+/* Returns the number of legal moves and stores up to max of them. */
+int othello_legal_moves(othello_engine *e, int *xs, int *ys, int max);
+
+/* Files othello_search reads: network weights (written by nntool) and tuned
+ * parameters (written by spsa). NULL, the default, keeps the handcrafted
+ * evaluation or the default parameters; the library reads nothing from the
+ * working directory on its own. Fails if a file cannot be loaded. */
+int othello_set_files(othello_engine *e, const char *network,
+                      const char *params);
+
+int othello_search(othello_engine *e, const othello_limits *limits,
+                   othello_result *result);
+
+/* Exact solve of the current position (at most OTHELLO_MAX_SOLVE_EMPTIES
+ * empties). */
+int othello_solve(othello_engine *e, int threads, othello_result *result);
+
+/* Static evaluation of n positions, each from its side to move's view.
+ * Needs no engine instance. */
+void othello_evaluate_batch(const othello_position *positions, int *scores,
+                            int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+#include "perfcount.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+bool perf_enabled = false;
+
+static const char *counter_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "branch-misses", "llc-misses"
+};
+
+static const char *region_names[PERF_REGIONS] = {
+    "movegen", "eval", "tt"
+};
+
+/*
+ * The counters of one thread and what they have added up to so far.
+ */
+struct PerfThread {
+    int fds[PERF_COUNTERS];
+    perf_event_mmap_page *pages[PERF_COUNTERS];
+    uint64_t start[PERF_COUNTERS];
+    PerfTotals totals;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static vector<PerfThread *> registry;
+static int open_errors[PERF_COUNTERS];
+static __thread PerfThread *self = NULL;
+
+// Totals at the last per-move report.
+static PerfTotals last_move;
+static long moves = 0;
+
+static int open_counter(int counter) {
+    static const uint64_t configs[PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Opens this thread's counters on first use. Counters that fail to open
+ * stay closed (fd -1) and read as zero.
+ */
+static PerfThread *thread_counters() {
+    if (self != NULL) return self;
+
+    PerfThread *t = new PerfThread();
+    memset(t, 0, sizeof(PerfThread));
+    long page = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        t->fds[i] = open_counter(i);
+        t->pages[i] = NULL;
+        if (t->fds[i] < 0) continue;
+        // The first page of the mapping tells us whether, and with which
+        // index, the counter can be read with rdpmc.
+        void *p = mmap(NULL, page, PROT_READ, MAP_SHARED, t->fds[i], 0);
+        if (p != MAP_FAILED) t->pages[i] = (perf_event_mmap_page *)p;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    registry.push_back(t);
+    pthread_mutex_unlock(&registry_lock);
+    self = t;
+    return t;
+}
+
+static inline uint64_t read_counter(PerfThread *t, int i) {
+    if (t->fds[i] < 0) return 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+    perf_event_mmap_page *pc = t->pages[i];
+    if (pc != NULL && pc->cap_user_rdpmc) {
+        // The kernel bumps lock around updates of the page; retry if it
+        // changed under us.
+        for (;;) {
+            uint32_t seq = pc->lock;
+            __sync_synchronize();
+            uint32_t index = pc->index;
+            int64_t count = pc->offset;
+            if (index == 0) break;
+            int64_t pmc = __builtin_ia32_rdpmc(index - 1);
+            int shift = 64 - pc->pmc_width;
+            count += (pmc << shift) >> shift;
+            __sync_synchronize();
+            if (pc->lock == seq) return (uint64_t)count;
+        }
+    }
+#endif
+
+    uint64_t count = 0;
+    if (read(t->fds[i], &count, sizeof(count)) != sizeof(count)) return 0;
+    return count;
+}
+
+/*
+ * Turns counting on for the whole process. Returns false if this build has
+ * no counting in it, or if none of the hardware counters could be opened;
+ * in the latter case node counts are still kept.
+ */
+bool perf_enable() {
+#ifndef OTHELLO_PERF
+    return false;
+#else
+    bool any = false;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        int fd = open_counter(i);
+        open_errors[i] = (fd < 0) ? errno : 0;
+        if (fd >= 0) {
+            any = true;
+            close(fd);
+        }
+    }
+    memset(&last_move, 0, sizeof(last_move));
+    moves = 0;
+    perf_enabled = true;
+    return any;
+#endif
+}
+
+void perf_begin(int region) {
+    PerfThread *t = thread_counters();
+    for (int i = 0; i < PERF_COUNTERS; i++) t->start[i] = read_counter(t, i);
+    (void)region;
+}
+
+void perf_end(int region) {
+    PerfThread *t = thread_counters();
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        t->totals.counts[region][i] += read_counter(t, i) - t->start[i];
+    }
+    t->totals.calls[region]++;
+}
+
+void perf_node() {
+    thread_counters()->totals.nodes++;
+}
+
+/*
+ * Sums the totals of every thread that has counted anything.
+ */
+void perf_totals(PerfTotals *out) {
+    memset(out, 0, sizeof(PerfTotals));
+    pthread_mutex_lock(&registry_lock);
+    for (size_t k = 0; k < registry.size(); k++) {
+        const PerfTotals &t = registry[k]->totals;
+        for (int r = 0; r < PERF_REGIONS; r++) {
+            for (int i = 0; i < PERF_COUNTERS; i++) {
+                out->counts[r][i] += t.counts[r][i];
+            }
+            out->calls[r] += t.calls[r];
+        }
+        out->nodes += t.nodes;
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static void print_value(char *buf, size_t len, int counter, double value) {
+    if (open_errors[counter] != 0) snprintf(buf, len, "%10s", "n/a");
+    else snprintf(buf, len, "%10.2f", value);
+}
+
+/*
+ * Prints totals per search node for each region, over the given number of
+ * moves.
+ */
+void perf_report(ostream &out, const PerfTotals *t, long nmoves) {
+    double nodes = (t->nodes > 0) ? (double)t->nodes : 1;
+    char line[256], c[4][32];
+    snprintf(line, sizeof(line), "perf: %lu nodes in %ld moves, per node:",
+             (unsigned long)t->nodes, nmoves);
+    out << line << endl;
+    out << "region        calls     cycles       IPC br-misses "
+        "llc-misses" << endl;
+    for (int r = 0; r < PERF_REGIONS; r++) {
+        const uint64_t *v = t->counts[r];
+        print_value(c[0], sizeof(c[0]), PERF_CYCLES, v[PERF_CYCLES] / nodes);
+        double ipc = (v[PERF_CYCLES] > 0)
+            ? (double)v[PERF_INSTRUCTIONS] / v[PERF_CYCLES] : 0;
+        print_value(c[1], sizeof(c[1]), open_errors[PERF_CYCLES]
+                    ? PERF_CYCLES : PERF_INSTRUCTIONS, ipc);
+        print_value(c[2], sizeof(c[2]), PERF_BRANCH_MISSES,
+                    v[PERF_BRANCH_MISSES] / nodes);
+        print_value(c[3], sizeof(c[3]), PERF_LLC_MISSES,
+                    v[PERF_LLC_MISSES] / nodes);
+        snprintf(line, sizeof(line), "%-8s %10.2f %s %s %s %s",
+                 region_names[r], t->calls[r] / nodes, c[0], c[1], c[2], c[3]);
+        out << line << endl;
+    }
+}
+
+/*
+ * Reports what was counted since the previous call, as one move.
+ */
+void perf_move_report(ostream &out) {
+    if (!perf_enabled) return;
+    PerfTotals now, delta;
+    perf_totals(&now);
+    for (int r = 0; r < PERF_REGIONS; r++) {
+        for (int i = 0; i < PERF_COUNTERS; i++) {
+            delta.counts[r][i] = now.counts[r][i] - last_move.counts[r][i];
+        }
+        delta.calls[r] = now.calls[r] - last_move.calls[r];
+    }
+    delta.nodes = now.nodes - last_move.nodes;
+    last_move = now;
+    moves++;
+    perf_report(out, &delta, 1);
+}
+
+/*
+ * Reports the totals of the run, and which counters could not be opened.
+ */
+void perf_final_report(ostream &out) {
+    if (!perf_enabled) return;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (open_errors[i] != 0) {
+            out << "perf: " << counter_names[i] << " unavailable: "
+                << strerror(open_errors[i]) << endl;
+        }
+    }
+    PerfTotals t;
+    perf_totals(&t);
+    perf_report(out, &t, moves);
+}
@@ -0,0 +1,63 @@
+#ifndef __PERFCOUNT_H__
+#define __PERFCOUNT_H__
+
+#include <iostream>
+#include <stdint.h>
+using namespace std;
+
+/*
+ * Hardware performance counters around the search hot paths.
+ *
+ * Builds made with -DOTHELLO_PERF (make PERF=1) wrap move generation,
+ * evaluation and transposition table probes in PERF_BEGIN / PERF_END, which
+ * add the cycles, instructions, branch misses and last level cache misses
+ * spent inside them to per-thread totals. Counting is still off until
+ * perf_enable() is called, and in other builds the macros compile to
+ * nothing.
+ *
+ * Counters come from perf_event_open and are read in user space with rdpmc
+ * where the kernel allows it. Any counter that cannot be opened (no PMU in
+ * a virtual machine, perf_event_paranoid, seccomp) reads as unavailable and
+ * the rest of the report still works.
+ */
+
+enum PerfRegion {
+    PERF_MOVEGEN, PERF_EVAL, PERF_TT, PERF_REGIONS
+};
+
+enum PerfCounter {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES, PERF_LLC_MISSES,
+    PERF_COUNTERS
+};
+
+/*
+ * Counter totals, per region, plus the number of search nodes and calls.
+ */
+struct PerfTotals {
+    uint64_t counts[PERF_REGIONS][PERF_COUNTERS];
+    uint64_t calls[PERF_REGIONS];
+    uint64_t nodes;
+};
+
+extern bool perf_enabled;
+
+bool perf_enable();
+void perf_begin(int region);
+void perf_end(int region);
+void perf_node();
+void perf_totals(PerfTotals *out);
+void perf_report(ostream &out, const PerfTotals *t, long moves);
+void perf_move_report(ostream &out);
+void perf_final_report(ostream &out);
+
+#ifdef OTHELLO_PERF
+#define PERF_BEGIN(r)   do { if (perf_enabled) perf_begin(r); } while (0)
+#define PERF_END(r)     do { if (perf_enabled) perf_end(r); } while (0)
+#define PERF_NODE()     do { if (perf_enabled) perf_node(); } while (0)
+#else
+#define PERF_BEGIN(r)   do { } while (0)
+#define PERF_END(r)     do { } while (0)
+#define PERF_NODE()     do { } while (0)
+#endif
+
+#endif
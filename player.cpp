@@ -1,4 +1,6 @@
 #include "player.h"
+#include "perfcount.h"
+#include "threadpool.h"
 
 /*
  * Constructor for the player; initialize everything here. The side your AI is
@@ -10,25 +12,121 @@ Player::Player(Side side) {
     testingMinimax = false;
 
     pside = side;
+    search_score = 0;
+    proof_result = DFPN_UNKNOWN;
+    proof_ms = 0;
+    solver = NULL;
+    prover = NULL;
+    mcts = NULL;
+    search = NULL;
+    engine = NULL;
+    policy = NULL;
+    search_threads = 1;
+    mode = MODE_MINIMAX;
+    search_algorithm = SEARCH_ASPIRATION;
+    search_trace = NULL;
+    proof_empties = 0;
+    move_ms = 0;
+    showBoard = true;
+
+    // Map the results of earlier games so common positions are answered
+    // without searching.
+    use_cache = true;
+    cache.load(SEARCH_CACHE_FILE);
+    end_cache.open(ENDGAME_CACHE_FILE);
+    nn.load(NN_WEIGHTS_FILE);
+    tuning.load(TUNE_FILE);
 }
 
 /* Alternative constructor for the player which sets the initial board state
- * to that contained in board. This is for testing with testminimax.
+ * to that contained in board. This is for testing with testminimax. The
+ * network weights and tuned parameters are read from nnPath and tunePath;
+ * NULL leaves the handcrafted evaluation or the default parameters.
  */
-Player::Player(Side side, Board* start_board) {
+Player::Player(Side side, Board* start_board, const char *nnPath,
+               const char *tunePath) {
     
     testingMinimax = false;
     pside = side;
     board = *start_board;
+    search_score = 0;
+    proof_result = DFPN_UNKNOWN;
+    proof_ms = 0;
+    solver = NULL;
+    prover = NULL;
+    mcts = NULL;
+    search = NULL;
+    engine = NULL;
+    policy = NULL;
+    search_threads = 1;
+    mode = MODE_MINIMAX;
+    search_algorithm = SEARCH_ASPIRATION;
+    search_trace = NULL;
+    proof_empties = 0;
+    move_ms = 0;
+    showBoard = true;
+    use_cache = false;
+    if(nnPath != NULL)
+    {
+        nn.load(nnPath);
+    }
+    if(tunePath != NULL)
+    {
+        tuning.load(tunePath);
+    }
 }
 
 /*
  * Destructor for the player.
  */
 Player::~Player() {
+    save_cache();
+    delete solver;
+    delete prover;
+    delete mcts;
+    delete search;
+    delete engine;
+}
 
-    // Default Destructors should be sufficient
+/*
+ * Writes this game's search and endgame results to the cache files. Called
+ * after every endgame move and when the game is over; calls with nothing new
+ * to write do nothing.
+ */
+void Player::save_cache()
+{
+    if(use_cache)
+    {
+        cache.save(SEARCH_CACHE_FILE, SEARCH_DEPTH);
+        end_cache.flush(ENDGAME_CACHE_FILE);
+    }
+}
 
+// Number of empty squares on the player's board.
+int Player::empties()
+{
+    return 64 - board.countBlack() - board.countWhite();
+}
+
+// Replaces the player's board, e.g. to analyse a position; side becomes the
+// side the player moves for.
+void Player::set_position(Board *b, Side side)
+{
+    board = *b;
+    pside = side;
+}
+
+// Chooses moves the way a registry entry says (see engine.h).
+void Player::use_engine(const EngineEntry *entry)
+{
+    mode = entry->mode;
+    search_algorithm = entry->algorithm;
+    if(entry->mode == MODE_POLICY && entry != policy)
+    {
+        delete engine;
+        engine = NULL;
+        policy = entry;
+    }
 }
 
 void Player::update_board(Move *move, Side side)
@@ -38,6 +136,8 @@ void Player::update_board(Move *move, Side side)
 
 std::vector<Move*> Player::get_valid_moves(Board* b, Side side)
 {
+    PERF_NODE();
+    PERF_BEGIN(PERF_MOVEGEN);
     std::vector<Move*> moves;
     bool valid_move;
     // Return a vector of all valid moves:
@@ -59,6 +159,7 @@ std::vector<Move*> Player::get_valid_moves(Board* b, Side side)
         }
     } 
 
+    PERF_END(PERF_MOVEGEN);
     return moves;
 }
 
@@ -148,6 +249,16 @@ bool Player::iscornervalid(Move *move, Board *b, Side side)
 // Associate a score with the board state that results if we play move
 int Player::score_move(Board *b, Move* move, Side side_to_score, bool downweight)//, Side side_to_score)
 {
+    PERF_BEGIN(PERF_EVAL);
+
+    // Use the network instead of the terms below if weights were loaded:
+    if(nn.loaded())
+    {
+        Side other = (side_to_score == BLACK) ? WHITE : BLACK;
+        int nn_score = nn.evaluate(b->getBits(side_to_score), b->getBits(other));
+        PERF_END(PERF_EVAL);
+        return nn_score;
+    }
     
     // Determine whether the corners are valid moves:
     //bool corner_valid_before = iscornervalid(move, test_board, side_to_play);
@@ -177,14 +288,16 @@ int Player::score_move(Board *b, Move* move, Side side_to_score, bool downweight
     }
 
     // Weight the two respective score
-    int score = 0.25 * count_score + 0.5 * mobility_score + 
-    0.25 * frontier_score;
+    int score = tuning.value[TUNE_SCORE_COUNT] * count_score
+        + tuning.value[TUNE_SCORE_MOBILITY] * mobility_score
+        + tuning.value[TUNE_SCORE_FRONTIER] * frontier_score;
+    double corner = tuning.value[TUNE_SCORE_CORNER];
 
     if(downweight)    
     {
         if(in_corner(move))
         {
-            score *= -3;
+            score *= -corner;
         }
     //    else if(on_edge(move))
     //    {
@@ -195,7 +308,7 @@ int Player::score_move(Board *b, Move* move, Side side_to_score, bool downweight
     {
         if(in_corner(move))
         {
-            score *= 3;
+            score *= corner;
         }
     //    else if(on_edge(move))
     //    {
@@ -210,6 +323,7 @@ int Player::score_move(Board *b, Move* move, Side side_to_score, bool downweight
         score *= -3;
     }
     */
+    PERF_END(PERF_EVAL);
     return score;
 }
 
@@ -345,6 +459,21 @@ Move* Player::minimax2(vector<Move*> valid_moves)
 }
 */
 
+// Deletes the moves made by get_valid_moves, except keep. The minimax
+// search used to leak them, which mattered once games were played in
+// process (spsa).
+static void free_moves(vector<Move*> &moves, Move *keep = NULL)
+{
+    for(unsigned int i = 0; i < moves.size(); i++)
+    {
+        if(moves[i] != keep)
+        {
+            delete moves[i];
+        }
+    }
+    moves.clear();
+}
+
 Move* Player::minimax_init(vector<Move*> valid_moves)
 {
     int nmoves = (int)valid_moves.size();
@@ -387,6 +516,7 @@ Move* Player::minimax_init(vector<Move*> valid_moves)
             {
                 min_end_score[i] = score_move(test_board, test_moves[0], pside, true);
             }
+            free_moves(valid_moves_after_test);
 
             for(int j = 1; j < (int)test_moves.size(); j++)
             {
@@ -405,6 +535,7 @@ Move* Player::minimax_init(vector<Move*> valid_moves)
                 {
                     end_score = score_move(test_board, test_moves[i], pside, true);
                 }
+                free_moves(valid_moves_after_test);
 
                 if(end_score < min_end_score[i])
                 {
@@ -414,12 +545,14 @@ Move* Player::minimax_init(vector<Move*> valid_moves)
 
             // Reset the test board
             test_board->setBoard(base_board);
+            delete[] base_board2;
         }
         else
         {
             // This means the opponent will have to pass:
             min_end_score[i] = score_move(test_board, valid_moves[i], pside, false);
         }
+        free_moves(test_moves);
 
     }
 
@@ -436,10 +569,245 @@ Move* Player::minimax_init(vector<Move*> valid_moves)
         }
     }
 
+    delete test_board;
+    delete[] base_board;
+    delete[] min_end_score;
+
+    search_score = final_max_score;
     return valid_moves[final_max_ind];
 
 }
 
+// Exact search to the end of the game; the score is the final disc
+// difference for our side. Positions solved in earlier games are looked up
+// instead of solved again.
+Move* Player::solve_endgame(vector<Move*> valid_moves)
+{
+    Side oside = (pside == BLACK) ? WHITE : BLACK;
+    uint64_t own = board.getBits(pside);
+    uint64_t opp = board.getBits(oside);
+    bool stored = use_cache && empties() >= ENDCACHE_MIN_EMPTIES;
+    int best;
+
+    if(!stored || !end_cache.probe(own, opp, &search_score, &best))
+    {
+        if(solver == NULL)
+        {
+            solver = new EndgameSolver(search_threads);
+        }
+
+        search_score = solver->solve(own, opp, &best);
+        if(stored)
+        {
+            end_cache.add(own, opp, search_score, best);
+        }
+    }
+
+    for(unsigned int i = 0; i < valid_moves.size(); i++)
+    {
+        if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == best)
+        {
+            return valid_moves[i];
+        }
+    }
+
+    return valid_moves[0];
+}
+
+// Proof-number search for a win, or failing that a draw, within half of the
+// move's time. Returns the move that secures it, or NULL if there is none or
+// the time ran out; the search that follows then has the rest of the time,
+// since the time spent here goes in proof_ms.
+// Proofs stay in the table, so once a win is proven the next moves only
+// have to follow it, and go in the endgame cache for later games. The
+// outcome goes in proof_result; search_score is left alone, since a proof
+// has no score.
+Move* Player::prove_move(vector<Move*> valid_moves, int msLeft)
+{
+    Side oside = (pside == BLACK) ? WHITE : BLACK;
+    uint64_t own = board.getBits(pside);
+    uint64_t opp = board.getBits(oside);
+    int empties = 64 - board.countBlack() - board.countWhite();
+    bool stored = use_cache && empties >= ENDCACHE_MIN_EMPTIES;
+    int outcome, best;
+
+    if(stored && end_cache.probe_outcome(own, opp, &outcome, &best))
+    {
+        proof_result = (DfpnResult)outcome;
+    }
+    else
+    {
+        if(prover == NULL)
+        {
+            prover = new DfpnSolver(PROOF_TABLE_BYTES, search_threads);
+        }
+
+        double budget = PROOF_UNTIMED_MS;
+        if(move_ms > 0 || msLeft >= 0)
+        {
+            budget = move_budget(msLeft, empties) / 2;
+        }
+
+        double start = now_ms();
+        proof_result = prover->solve(own, opp, budget, &best);
+        proof_ms = now_ms() - start;
+        if(stored && proof_result != DFPN_UNKNOWN)
+        {
+            end_cache.add_proof(own, opp, proof_result, best);
+        }
+    }
+
+    if(proof_result != DFPN_WIN && proof_result != DFPN_DRAW)
+    {
+        return NULL;
+    }
+
+    for(unsigned int i = 0; i < valid_moves.size(); i++)
+    {
+        if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == best)
+        {
+            return valid_moves[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Time for one move out of msLeft: a share of the clock spread over the
+// moves we still expect to make.
+double Player::time_share(int msLeft, int empties)
+{
+    int moves = (int)(empties / tuning.value[TUNE_TIME_EMPTIES]);
+    return tuning.value[TUNE_TIME_SHARE] * msLeft / (moves + 1);
+}
+
+// Time for this move's search: the fixed time per move, or a share of
+// msLeft, less what proof-number search has already spent on the move.
+// Only for timed games.
+double Player::move_budget(int msLeft, int empties)
+{
+    double budget = (move_ms > 0) ? move_ms : time_share(msLeft, empties);
+    budget -= proof_ms;
+    return (budget > 1) ? budget : 1;
+}
+
+// Monte Carlo tree search, given an even share of the remaining time.
+Move* Player::mcts_move(vector<Move*> valid_moves, int msLeft)
+{
+    if(mcts == NULL)
+    {
+        mcts = new MctsEngine(search_threads, MCTS_NODES, true);
+    }
+
+    int empties = 64 - board.countBlack() - board.countWhite();
+    double budget = MCTS_DEFAULT_MS;
+    if(move_ms > 0 || msLeft >= 0)
+    {
+        budget = move_budget(msLeft, empties);
+    }
+
+    Side oside = (pside == BLACK) ? WHITE : BLACK;
+    double win_rate;
+    int best = mcts->search(board.getBits(pside), board.getBits(oside), budget, &win_rate);
+    search_score = (int)(100 * win_rate);
+
+    for(unsigned int i = 0; i < valid_moves.size(); i++)
+    {
+        if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == best)
+        {
+            return valid_moves[i];
+        }
+    }
+
+    return valid_moves[0];
+}
+
+// Iterative deepening alpha-beta, given the same share of the remaining
+// time as tree search, or a fixed depth when the game is untimed.
+Move* Player::search_move(vector<Move*> valid_moves, int msLeft)
+{
+    if(search == NULL)
+    {
+        search = new Search(SEARCH_TT_BYTES);
+        search->eval.set_nn(&nn);
+    }
+    search->algorithm = search_algorithm;
+    search->set_trace(search_trace);
+    search->eval.weights.disc = tuning.integer(TUNE_EVAL_DISC);
+    search->eval.weights.mobility = tuning.integer(TUNE_EVAL_MOBILITY);
+    search->eval.weights.frontier = tuning.integer(TUNE_EVAL_FRONTIER);
+    search->eval.weights.corner = tuning.integer(TUNE_EVAL_CORNER);
+    search->window = tuning.integer(TUNE_SEARCH_WINDOW);
+    search->sortDepth = tuning.integer(TUNE_SEARCH_SORT_DEPTH);
+
+    int empties = 64 - board.countBlack() - board.countWhite();
+    int depth = SEARCH_MAX_PLY;
+    double budget = 0;
+    if(move_ms > 0 || msLeft >= 0)
+    {
+        budget = move_budget(msLeft, empties);
+    }
+    else
+    {
+        depth = SEARCH_UNTIMED_DEPTH;
+    }
+
+    Side oside = (pside == BLACK) ? WHITE : BLACK;
+    int best;
+    search_score = search->run(board.getBits(pside), board.getBits(oside), depth, budget, &best);
+
+    for(unsigned int i = 0; i < valid_moves.size(); i++)
+    {
+        if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == best)
+        {
+            return valid_moves[i];
+        }
+    }
+
+    return valid_moves[0];
+}
+
+// A policy engine from the registry, timed like alpha-beta search.
+Move* Player::policy_move(vector<Move*> valid_moves, int msLeft)
+{
+    if(engine == NULL)
+    {
+        engine = policy->create();
+    }
+
+    int empties = 64 - board.countBlack() - board.countWhite();
+    int depth = SEARCH_MAX_PLY;
+    double budget = 0;
+    if(move_ms > 0 || msLeft >= 0)
+    {
+        budget = move_budget(msLeft, empties);
+    }
+    else
+    {
+        depth = SEARCH_UNTIMED_DEPTH;
+    }
+
+    Side oside = (pside == BLACK) ? WHITE : BLACK;
+    int best;
+    search_score = engine->run(board.getBits(pside), board.getBits(oside), depth, budget, &best);
+
+    for(unsigned int i = 0; i < valid_moves.size(); i++)
+    {
+        if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == best)
+        {
+            return valid_moves[i];
+        }
+    }
+
+    return valid_moves[0];
+}
+
+// Any legal move.
+Move* Player::random_move(vector<Move*> valid_moves)
+{
+    return valid_moves[rand() % valid_moves.size()];
+}
+
 int Player::minimax(vector<Move*> valid_moves, Board* board_state, bool call_again)
 {
     int nmoves = (int)valid_moves.size();
@@ -510,12 +878,14 @@ int Player::minimax(vector<Move*> valid_moves, Board* board_state, bool call_aga
 
             // Reset the test board
             test_board->setBoard(base_board);
+            delete[] base_board2;
         }
         else
         {
             // This means the opponent will have to pass:
             min_end_score[i] = score_move(test_board, valid_moves[i], pside, false);
         }
+        free_moves(test_moves);
 
     }
 
@@ -530,10 +900,12 @@ int Player::minimax(vector<Move*> valid_moves, Board* board_state, bool call_aga
         }
     }
 
-    return final_max_score;
+    delete test_board;
+    delete[] base_board;
+    delete[] min_end_score;
+    free_moves(valid_moves);
 
-    //delete base_board[];
-    //delete base_board2[];
+    return final_max_score;
 }
 
 
@@ -565,6 +937,13 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
         update_board(opponentsMove, BLACK);
     }
 
+    // The opponent's move may have ended the game:
+    if(board.isDone())
+    {
+        save_cache();
+        return NULL;
+    }
+
     // Print out the board for debugging purposes:
     // board.draw();
 
@@ -581,23 +960,97 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
     // If no valid moves, pass:
     if(!valid_moves.empty())
     {
-        // Random choice:
-        //Move* move_to_make = valid_moves[rand() % valid_moves.size()];
+        // Near the end of the game, search all the way to the end:
+        int empties = 64 - board.countBlack() - board.countWhite();
+        bool endgame = (empties <= tuning.integer(TUNE_ENDGAME_EMPTIES));
+        int depth = endgame ? empties : SEARCH_DEPTH;
+
+        // Only minimax results go through the search cache: tree search
+        // results are not depth limited, and exact results have their own.
+        bool cacheable = use_cache && !endgame && mode == MODE_MINIMAX;
+
+        // Use a result from an earlier game if we have one:
+        Move *move_to_make = NULL;
+        CacheEntry cached;
+        if(cacheable && cache.probe(&board, pside, depth, &cached))
+        {
+            for(unsigned int i = 0; i < valid_moves.size(); i++)
+            {
+                if(valid_moves[i]->getX() + 8 * valid_moves[i]->getY() == cached.move)
+                {
+                    move_to_make = valid_moves[i];
+                }
+            }
+        }
 
-        // Greedy heuristic:
-        
-        //Move* move_to_make = greedy_heuristic(valid_moves);
+        // Settle the result early if it can be proven:
+        proof_result = DFPN_UNKNOWN;
+        proof_ms = 0;
+        if(move_to_make == NULL && !endgame && empties <= proof_empties)
+        {
+            move_to_make = prove_move(valid_moves, msLeft);
+            if(move_to_make != NULL)
+            {
+                cacheable = false;
+            }
+        }
 
         // 4 stage minmax tree:
         
-        Move *move_to_make = minimax_init(valid_moves);
+        if(move_to_make == NULL)
+        {
+            if(endgame)
+            {
+                move_to_make = solve_endgame(valid_moves);
+            }
+            else if(mode == MODE_MCTS)
+            {
+                move_to_make = mcts_move(valid_moves, msLeft);
+            }
+            else if(mode == MODE_SEARCH)
+            {
+                move_to_make = search_move(valid_moves, msLeft);
+            }
+            else if(mode == MODE_POLICY && policy != NULL)
+            {
+                move_to_make = policy_move(valid_moves, msLeft);
+            }
+            else if(mode == MODE_RANDOM)
+            {
+                move_to_make = random_move(valid_moves);
+            }
+            else if(mode == MODE_GREEDY)
+            {
+                move_to_make = greedy_heuristic(valid_moves);
+            }
+            else
+            {
+                move_to_make = minimax_init(valid_moves);
+            }
+
+            if(cacheable)
+            {
+                cache.store(&board, pside, depth, move_to_make, search_score);
+            }
+        }
+
+        // The caller owns the move made; the rest are ours to free.
+        free_moves(valid_moves, move_to_make);
 
         // Update board accordingly
         update_board(move_to_make, pside);
-        board.draw();
+        if(showBoard)
+        {
+            board.draw();
+        }
+        // Nothing is added to the search cache in the endgame, and the move
+        // that ends the game may never reach us, so save from here on:
+        if(endgame || board.isDone())
+        {
+            save_cache();
+        }
         return move_to_make;
     }
 
-
     return NULL;
 }
@@ -5,18 +5,73 @@
 #include <vector>
 #include "common.h"
 #include "board.h"
+#include "searchcache.h"
+#include "endcache.h"
+#include "endgame.h"
+#include "dfpn.h"
+#include "mcts.h"
+#include "search.h"
+#include "nneval.h"
+#include "tune.h"
+#include "engine.h"
 #include <cstdlib>
 using namespace std;
 
+// Number of plies searched by minimax_init.
+#define SEARCH_DEPTH        4
+
+// Proof-number search before the endgame (see proof_empties): table size,
+// and the time per attempt when the game is untimed.
+#define PROOF_TABLE_BYTES   (32 << 20)
+#define PROOF_UNTIMED_MS    2000
+
+// Tree search: node arena size, and the time per move when the game is
+// untimed.
+#define MCTS_NODES          (1 << 21)
+#define MCTS_DEFAULT_MS     1000
+
+// Alpha-beta search: iterative deepening to this depth when the game is
+// untimed, otherwise as deep as its share of the remaining time allows.
+#define SEARCH_UNTIMED_DEPTH    8
+
+// Search results are kept in this file between games.
+#define SEARCH_CACHE_FILE   "shakespeare.cache"
+
+// Exact endgame results are kept in this file between games.
+#define ENDGAME_CACHE_FILE  "shakespeare.endgame"
+
+// Network weights (written by nntool); without them the handcrafted
+// evaluation is used.
+#define NN_WEIGHTS_FILE     "shakespeare.nn"
+
+// Tuned parameters (written by spsa); without it the defaults in tune.cpp
+// are used.
+#define TUNE_FILE           "shakespeare.params"
+
 class Player {
 
 private: 
 	Board board;
 	Side pside;
+	SearchCache cache;
+	EndCache end_cache;
+	bool use_cache;
+	int search_score;
+	DfpnResult proof_result;
+	double proof_ms;            // spent on the proof of this move
+	EndgameSolver *solver;
+	DfpnSolver *prover;
+	MctsEngine *mcts;
+	Search *search;
+	Engine *engine;
+	const EngineEntry *policy;
+	NNEval nn;
 
 public:
     Player(Side side);
-    Player(Side side, Board* start_board);
+    Player(Side side, Board* start_board,
+           const char *nnPath = NN_WEIGHTS_FILE,
+           const char *tunePath = TUNE_FILE);
     ~Player();
 	void update_player();
 	bool in_corner(Move *move);
@@ -26,12 +81,57 @@ public:
 	Move *greedy_heuristic(vector<Move*> valid_moves);	
 	int minimax(vector<Move*> valid_moves, Board* board_state, bool call_again);
 	Move* minimax_init(vector<Move*> valid_moves);
+	Move* solve_endgame(vector<Move*> valid_moves);
+	Move* prove_move(vector<Move*> valid_moves, int msLeft);
+	Move* mcts_move(vector<Move*> valid_moves, int msLeft);
+	Move* search_move(vector<Move*> valid_moves, int msLeft);
+	Move* policy_move(vector<Move*> valid_moves, int msLeft);
+	Move* random_move(vector<Move*> valid_moves);
+	double time_share(int msLeft, int empties);
+	double move_budget(int msLeft, int empties);
 	void update_board(Move* move, Side side);
+	void save_cache();
 	std::vector<Move*> get_valid_moves(Board *b, Side side);    
     Move *doMove(Move *opponentsMove, int msLeft);
+    int empties();
+    void set_position(Board *b, Side side);
+    void use_engine(const EngineEntry *entry);
+    int last_score() { return search_score; }
+
+    // What proof-number search settled for the last move: a win, draw or
+    // loss for us, or DFPN_UNKNOWN if it was not tried or ran out of time.
+    DfpnResult last_proof() { return proof_result; }
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
+
+    // Threads used by the endgame solver and the tree search.
+    int search_threads;
+
+    // Search used before the endgame; MODE_MINIMAX unless set otherwise
+    // (see engine.h).
+    EngineMode mode;
+
+    // Root search of MODE_SEARCH.
+    SearchAlgorithm search_algorithm;
+
+    // Where MODE_SEARCH records what it did, or NULL; not owned.
+    SearchTrace *search_trace;
+
+    // Evaluation, search and time parameters, read from TUNE_FILE.
+    TuneParams tuning;
+
+    // Positions with this many empties or fewer, but too many to solve
+    // exactly, first get half of the move's time to prove a win or a draw;
+    // 0 never tries.
+    int proof_empties;
+
+    // Fixed time per move for tree and alpha-beta search; 0 shares msLeft
+    // over the game.
+    int move_ms;
+
+    // Print the board after every move (for debugging).
+    bool showBoard;
 };
 
 #endif
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "positions.h"
+#include "threadpool.h"
+
+/*
+ * Generates positions from random or epsilon-greedy games and writes them to
+ * a position file, or prints a summary of an existing file.
+ *
+ * usage: posgen out count [threads] [min empties] [max empties] [epsilon]
+ *               [sample rate] [seed]
+ *        posgen -s file
+ */
+
+// Duplicate table size; 2^24 keys (128 MB) holds several million positions.
+#define POSGEN_DEDUP_LOG2   24
+
+static int summary(const char *path) {
+    PositionReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+
+    long byEmpties[65];
+    memset(byEmpties, 0, sizeof(byEmpties));
+    PositionRecord rec;
+    while (reader.next(&rec)) byEmpties[64 - bb_count(rec.own | rec.opp)]++;
+
+    printf("%ld positions\n", (long)reader.size());
+    printf("empties  positions\n");
+    for (int e = 0; e <= 64; e++) {
+        if (byEmpties[e] > 0) printf("%7d %10ld\n", e, byEmpties[e]);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "-s") == 0) return summary(argv[2]);
+    if (argc < 3) {
+        fprintf(stderr, "usage: posgen out count [threads] [min empties] "
+                "[max empties] [epsilon] [sample rate] [seed]\n"
+                "       posgen -s file\n");
+        return 1;
+    }
+
+    long count = atol(argv[2]);
+    int threads = (argc > 3) ? atoi(argv[3]) : online_cpus();
+    PositionGenerator gen(threads, POSGEN_DEDUP_LOG2);
+    if (argc > 4) gen.minEmpties = atoi(argv[4]);
+    if (argc > 5) gen.maxEmpties = atoi(argv[5]);
+    if (argc > 6) gen.epsilon = atof(argv[6]);
+    if (argc > 7) gen.sampleRate = atof(argv[7]);
+    uint64_t seed = (argc > 8) ? strtoull(argv[8], NULL, 0) : 1;
+
+    PositionWriter writer;
+    if (!writer.open(argv[1], false)) {
+        fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    double start = now_ms();
+    long n = gen.generate(&writer, count, seed);
+    writer.close();
+    double ms = now_ms() - start;
+
+    printf("%ld positions from %ld games in %.0f ms (%.2f M/s), "
+           "%ld duplicates dropped\n", n, gen.games, ms,
+           (ms > 0) ? n / ms / 1000 : 0, gen.duplicates());
+    return (n == count) ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+#include "positions.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eval.h"
+#include "searchcache.h"
+
+// Positions each thread collects before taking the lock to write them.
+#define POS_BATCH           4096
+
+// Slots of the duplicate table checked before a position is let through.
+#define POS_DEDUP_PROBES    16
+
+// A thread gives up after this many games in a row without a new position,
+// e.g. when asked for more distinct positions than the empties range holds.
+#define POS_MAX_IDLE_GAMES  100000
+
+PositionWriter::PositionWriter() {
+    fp = NULL;
+}
+
+PositionWriter::~PositionWriter() {
+    close();
+}
+
+/*
+ * Opens a position file for writing. With append set, positions are added
+ * to the end of an existing file; a new or truncated file gets a fresh file
+ * header.
+ */
+bool PositionWriter::open(const char *path, bool append) {
+    close();
+    fp = fopen(path, append ? "ab" : "wb");
+    if (fp == NULL) return false;
+
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) {
+        unsigned char header[POS_FILE_HEADER];
+        memset(header, 0, sizeof(header));
+        memcpy(header, POS_MAGIC, 4);
+        if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PositionWriter::write(const PositionRecord *recs, size_t n) {
+    if (fp == NULL) return false;
+    return fwrite(recs, sizeof(PositionRecord), n, fp) == n;
+}
+
+void PositionWriter::close() {
+    if (fp != NULL) {
+        fclose(fp);
+        fp = NULL;
+    }
+}
+
+PositionReader::PositionReader() {
+    recs = NULL;
+    count = 0;
+    pos = 0;
+    mapSize = 0;
+}
+
+PositionReader::~PositionReader() {
+    close();
+}
+
+/*
+ * Maps a position file into memory. Returns false if the file cannot be
+ * mapped or does not start with a valid file header; a partly written last
+ * record is ignored.
+ */
+bool PositionReader::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < POS_FILE_HEADER) {
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    const char *base = (const char *)p;
+    if (memcmp(base, POS_MAGIC, 4) != 0) {
+        munmap(p, st.st_size);
+        return false;
+    }
+
+    recs = (const PositionRecord *)(base + POS_FILE_HEADER);
+    count = (st.st_size - POS_FILE_HEADER) / sizeof(PositionRecord);
+    pos = 0;
+    mapSize = st.st_size;
+    return true;
+}
+
+bool PositionReader::next(PositionRecord *rec) {
+    if (pos >= count) return false;
+    *rec = recs[pos++];
+    return true;
+}
+
+void PositionReader::close() {
+    if (recs != NULL) {
+        munmap((char *)recs - POS_FILE_HEADER, mapSize);
+        recs = NULL;
+    }
+    count = 0;
+    pos = 0;
+    mapSize = 0;
+}
+
+/*
+ * Makes a generator using nthreads threads (at least 1) and a duplicate
+ * table of 2^dedupLog2 entries. A dedupLog2 of 0 turns deduplication off.
+ */
+PositionGenerator::PositionGenerator(int nthreads, int dedupLog2) {
+    this->nthreads = (nthreads < 1) ? 1 : nthreads;
+    seen = NULL;
+    seenMask = 0;
+    if (dedupLog2 > 0) {
+        seen = new uint64_t[UINT64_C(1) << dedupLog2]();
+        seenMask = (UINT64_C(1) << dedupLog2) - 1;
+    }
+    out = NULL;
+    target = 0;
+    produced = 0;
+    dups = 0;
+    pthread_mutex_init(&writeLock, NULL);
+
+    minEmpties = 12;
+    maxEmpties = 50;
+    epsilon = 1.0;
+    sampleRate = 1.0;
+    games = 0;
+}
+
+PositionGenerator::~PositionGenerator() {
+    delete[] seen;
+    pthread_mutex_destroy(&writeLock);
+}
+
+/*
+ * Returns true the first time the position or any of its symmetric images is
+ * seen. The table holds position keys and is filled without locks; once the
+ * probe window of a key is full, positions that hash there are let through.
+ */
+bool PositionGenerator::first_seen(uint64_t own, uint64_t opp) {
+    if (seen == NULL) return true;
+
+    uint64_t cOwn, cOpp;
+    bb_canonical(own, opp, &cOwn, &cOpp);
+    uint64_t key = position_key(cOwn, cOpp, 0) | 1;
+
+    for (int i = 0; i < POS_DEDUP_PROBES; i++) {
+        volatile uint64_t *slot = &seen[(key + i) & seenMask];
+        uint64_t cur = *slot;
+        if (cur == key) return false;
+        if (cur == 0) {
+            cur = __sync_val_compare_and_swap(slot, (uint64_t)0, key);
+            if (cur == 0) return true;
+            if (cur == key) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Picks a move for own: a random one with probability epsilon, otherwise the
+ * one leaving the opponent the worst position by the static evaluation.
+ */
+int PositionGenerator::pick_move(uint64_t own, uint64_t opp, uint64_t moves,
+                                 uint64_t *rng) {
+    if (epsilon >= 1.0 || pos_random_unit(rng) < epsilon) {
+        return pos_random_move(moves, rng);
+    }
+
+    int best = -1, bestScore = 0;
+    while (moves) {
+        int sq = bb_first(moves);
+        moves &= moves - 1;
+        uint64_t flips = bb_flips(own, opp, sq);
+        int score = -evaluate(opp & ~flips, own | flips | (UINT64_C(1) << sq));
+        if (best < 0 || score > bestScore) {
+            best = sq;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+void *PositionGenerator::worker(void *arg) {
+    Worker *w = (Worker *)arg;
+    w->gen->run(w);
+    return NULL;
+}
+
+/*
+ * Hands a batch of positions to the writer, trimmed so the total does not
+ * pass the target. Returns true once the target is reached.
+ */
+bool PositionGenerator::flush(vector<PositionRecord> &batch) {
+    long start = __sync_fetch_and_add(&produced, (long)batch.size());
+    long n = target - start;
+    if (n > (long)batch.size()) n = batch.size();
+    if (n > 0) {
+        pthread_mutex_lock(&writeLock);
+        out->write(&batch[0], n);
+        pthread_mutex_unlock(&writeLock);
+    }
+    batch.clear();
+    return start + n >= target;
+}
+
+/*
+ * Plays games until the generator has written its target number of
+ * positions, handing them over in batches.
+ */
+void PositionGenerator::run(Worker *w) {
+    uint64_t rng = w->seed | 1;
+    vector<PositionRecord> batch;
+    batch.reserve(POS_BATCH);
+    long idle = 0;
+
+    while (produced < target) {
+        size_t before = batch.size();
+        uint64_t own = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+        uint64_t opp = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+        for (;;) {
+            uint64_t moves = bb_moves(own, opp);
+            if (moves == 0) {
+                if (bb_moves(opp, own) == 0) break;
+            } else {
+                int empties = 64 - bb_count(own | opp);
+                if (minEmpties <= empties && empties <= maxEmpties
+                    && (sampleRate >= 1.0
+                        || pos_random_unit(&rng) < sampleRate)) {
+                    if (first_seen(own, opp)) {
+                        PositionRecord rec = { own, opp };
+                        batch.push_back(rec);
+                    } else {
+                        __sync_fetch_and_add(&dups, 1);
+                    }
+                }
+
+                int sq = pick_move(own, opp, moves, &rng);
+                uint64_t flips = bb_flips(own, opp, sq);
+                own |= flips | (UINT64_C(1) << sq);
+                opp &= ~flips;
+            }
+            uint64_t t = own;
+            own = opp;
+            opp = t;
+        }
+        w->games++;
+
+        idle = (batch.size() > before) ? 0 : idle + 1;
+        if (idle >= POS_MAX_IDLE_GAMES) break;
+        // A game adds at most 60 positions, so this never overflows.
+        if (batch.size() + 60 > POS_BATCH && flush(batch)) break;
+    }
+
+    if (!batch.empty()) flush(batch);
+}
+
+/*
+ * Writes count positions to out and returns the number written. seed fixes
+ * the games played by each thread, although with several threads the order
+ * of the output (and which duplicates are dropped) varies between runs.
+ */
+long PositionGenerator::generate(PositionWriter *out, long count,
+                                 uint64_t seed) {
+    this->out = out;
+    target = count;
+    produced = 0;
+    dups = 0;
+    games = 0;
+
+    vector<Worker> workers(nthreads);
+    vector<pthread_t> threads(nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        workers[i].gen = this;
+        workers[i].seed = (seed + i) * UINT64_C(0x9E3779B97F4A7C15);
+        workers[i].games = 0;
+    }
+    // Generate with the threads that start.
+    int started = 1;
+    while (started < nthreads
+           && pthread_create(&threads[started], NULL, worker,
+                             &workers[started]) == 0) {
+        started++;
+    }
+    run(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < nthreads; i++) games += workers[i].games;
+    return (produced < target) ? produced : target;
+}
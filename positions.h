@@ -0,0 +1,179 @@
+#ifndef __POSITIONS_H__
+#define __POSITIONS_H__
+
+#include <cstdio>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+#include "bitboard.h"
+using namespace std;
+
+/*
+ * Streams of positions for benchmarks, training and regression runs.
+ *
+ * A position file starts with an 8 byte header ("OPS1" followed by four
+ * reserved bytes) and then holds 16 byte records back to back: the stones
+ * of the side to move, then the stones of the other side, each as a
+ * little-endian bitboard.
+ */
+
+#define POS_MAGIC           "OPS1"
+#define POS_FILE_HEADER     8
+
+// Seed of the random games the benchmarks and tools play, so that every run
+// sees the same positions.
+#define POS_SEED            UINT64_C(0x2545F4914F6CDD1D)
+
+struct PositionRecord {
+    uint64_t own;
+    uint64_t opp;
+};
+
+/*
+ * Xorshift random numbers. The caller keeps the state, one per thread, and
+ * starts it at any value but 0.
+ */
+static inline uint64_t pos_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/*
+ * Uniform random number in [0, 1).
+ */
+static inline double pos_random_unit(uint64_t *state) {
+    return (pos_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * A uniformly random square of the bitboard moves, which must not be empty.
+ */
+static inline int pos_random_move(uint64_t moves, uint64_t *state) {
+    int n = (int)(pos_random(state) % bb_count(moves));
+    while (n--) moves &= moves - 1;
+    return bb_first(moves);
+}
+
+/*
+ * Plays random moves from the start position until the given number of
+ * empties remain with the side to move (own) having a legal move, starting
+ * over from a game that ends too soon. Inline, like the generator, so that
+ * benchmarks can use it without linking the position generator.
+ */
+static inline void pos_random_position(int empties, uint64_t *state,
+                                       uint64_t *own, uint64_t *opp) {
+    for (;;) {
+        uint64_t a = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+        uint64_t b = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+        while (64 - bb_count(a | b) > empties) {
+            uint64_t moves = bb_moves(a, b);
+            if (moves == 0) {
+                if (bb_moves(b, a) == 0) break;
+            } else {
+                int sq = pos_random_move(moves, state);
+                uint64_t flips = bb_flips(a, b, sq);
+                a |= flips | (UINT64_C(1) << sq);
+                b &= ~flips;
+            }
+            uint64_t t = a;
+            a = b;
+            b = t;
+        }
+        if (64 - bb_count(a | b) == empties && bb_moves(a, b) != 0) {
+            *own = a;
+            *opp = b;
+            return;
+        }
+    }
+}
+
+/*
+ * Appends positions to a file, writing the file header when the file is new.
+ */
+class PositionWriter {
+
+private:
+    FILE *fp;
+
+public:
+    PositionWriter();
+    ~PositionWriter();
+    bool open(const char *path, bool append);
+    bool write(const PositionRecord *recs, size_t n);
+    void close();
+};
+
+/*
+ * Reads a position file through a read-only mapping.
+ */
+class PositionReader {
+
+private:
+    const PositionRecord *recs;
+    size_t count;
+    size_t pos;
+    size_t mapSize;
+
+public:
+    PositionReader();
+    ~PositionReader();
+    bool open(const char *path);
+    bool next(PositionRecord *rec);
+    size_t size() { return count; }
+    const PositionRecord *data() { return recs; }
+    void close();
+};
+
+/*
+ * Plays games from the start position on several threads and writes out
+ * positions reached along the way. Each move is a uniformly random legal
+ * move with probability epsilon and the best move by the static evaluation
+ * otherwise, so epsilon = 1 gives purely random games.
+ *
+ * Positions with minEmpties to maxEmpties empty squares and a legal move for
+ * the side to move are kept with probability sampleRate. Positions that are
+ * symmetric images of one already written are dropped, using a table shared
+ * by all threads.
+ */
+class PositionGenerator {
+
+private:
+    struct Worker {
+        PositionGenerator *gen;
+        uint64_t seed;
+        long games;
+    };
+
+    int nthreads;
+    uint64_t *seen;
+    uint64_t seenMask;
+    PositionWriter *out;
+    long target;
+    volatile long produced;
+    volatile long dups;
+    pthread_mutex_t writeLock;
+
+    static void *worker(void *arg);
+    void run(Worker *w);
+    bool flush(vector<PositionRecord> &batch);
+    bool first_seen(uint64_t own, uint64_t opp);
+    int pick_move(uint64_t own, uint64_t opp, uint64_t moves, uint64_t *rng);
+
+public:
+    int minEmpties;
+    int maxEmpties;
+    double epsilon;
+    double sampleRate;
+    long games;
+
+    PositionGenerator(int nthreads, int dedupLog2);
+    ~PositionGenerator();
+    long generate(PositionWriter *out, long count, uint64_t seed);
+    long duplicates() { return dups; }
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bitboard.h"
+#include "protocol.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Measures the round trip of the referee protocol at the engine's end: it
+ * plays the program against itself, as the java wrapper would, and times
+ * each request from the write to the last byte of the reply. Run it with a
+ * move chooser that costs next to nothing, so that what is left is the
+ * pipes, the parsing and the process wakeups. Text framing and binary
+ * framing are measured in turn.
+ *
+ * usage: protobench [games] [program] [engine]
+ *        (defaults 100, ./shakespeare, random)
+ */
+
+struct EngineProcess {
+    pid_t pid;
+    int in;     // the engine's stdout
+    int out;    // the engine's stdin
+    char buf[PROTOCOL_BUFFER];
+    int start;
+    int end;
+};
+
+/*
+ * Starts program for side with its stdin and stdout on pipes and its stderr
+ * discarded, and waits for it to finish initializing.
+ */
+static bool start_engine(EngineProcess *e, const char *program,
+                         const char *side, const char *engine, bool binary) {
+    int toEngine[2], fromEngine[2];
+    if (pipe(toEngine) != 0 || pipe(fromEngine) != 0) return false;
+
+    e->pid = fork();
+    if (e->pid < 0) return false;
+    if (e->pid == 0) {
+        dup2(toEngine[0], STDIN_FILENO);
+        dup2(fromEngine[1], STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) dup2(devnull, STDERR_FILENO);
+        close(toEngine[0]);
+        close(toEngine[1]);
+        close(fromEngine[0]);
+        close(fromEngine[1]);
+        if (binary) setenv("OTHELLO_FRAMING", "binary", 1);
+        else unsetenv("OTHELLO_FRAMING");
+        setenv("OTHELLO_QUIET", "1", 1);
+        execl(program, program, side, engine, (char *)NULL);
+        _exit(127);
+    }
+    close(toEngine[0]);
+    close(fromEngine[1]);
+    // Keep our ends out of the other engine, or it would hold this one's
+    // stdin open after stop_engine.
+    fcntl(toEngine[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fromEngine[0], F_SETFD, FD_CLOEXEC);
+    e->in = fromEngine[0];
+    e->out = toEngine[1];
+    e->start = 0;
+    e->end = 0;
+
+    // "Init done"
+    char c;
+    do {
+        if (read(e->in, &c, 1) != 1) return false;
+    } while (c != '\n');
+    return true;
+}
+
+static void stop_engine(EngineProcess *e) {
+    close(e->out);
+    close(e->in);
+    waitpid(e->pid, NULL, 0);
+}
+
+static int next_byte(EngineProcess *e) {
+    if (e->start == e->end) {
+        ssize_t n = read(e->in, e->buf, sizeof(e->buf));
+        if (n <= 0) return -1;
+        e->start = 0;
+        e->end = (int)n;
+    }
+    return (unsigned char)e->buf[e->start++];
+}
+
+/*
+ * Sends the opponent's move and reads the reply; returns the reply as
+ * x + 8*y, -1 for a pass, or -2 if the engine has gone away.
+ */
+static int exchange(EngineProcess *e, bool binary, int x, int y) {
+    char req[32];
+    int len;
+    if (binary) {
+        len = protocol_encode_request(req, x, y, -1);
+    } else {
+        len = snprintf(req, sizeof(req), "%d %d -1\n", x, y);
+    }
+    if (write(e->out, req, len) != len) return -2;
+
+    int mx, my;
+    if (binary) {
+        int a = next_byte(e);
+        int b = next_byte(e);
+        if (a < 0 || b < 0) return -2;
+        mx = (signed char)a;
+        my = (signed char)b;
+    } else {
+        char line[32];
+        int n = 0;
+        int c;
+        while ((c = next_byte(e)) != '\n') {
+            if (c < 0) return -2;
+            if (n < (int)sizeof(line) - 1) line[n++] = (char)c;
+        }
+        line[n] = '\0';
+        if (sscanf(line, "%d %d", &mx, &my) != 2) return -2;
+    }
+    return (mx < 0) ? -1 : mx + 8 * my;
+}
+
+/*
+ * Plays games of program against itself and appends the round trips, in
+ * microseconds, to times. Returns false if an engine fails.
+ */
+static bool run(const char *program, const char *engine, bool binary,
+                int games, vector<double> &times) {
+    for (int g = 0; g < games; g++) {
+        EngineProcess engines[2];
+        if (!start_engine(&engines[0], program, "Black", engine, binary)
+            || !start_engine(&engines[1], program, "White", engine, binary)) {
+            return false;
+        }
+
+        // Black to move from the start position.
+        uint64_t own = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+        uint64_t opp = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+        int side = 0;
+        int last = -1;
+        bool ok = true;
+        while (bb_moves(own, opp) != 0 || bb_moves(opp, own) != 0) {
+            double start = now_ms();
+            int sq = exchange(&engines[side], binary,
+                              (last < 0) ? -1 : last % 8,
+                              (last < 0) ? -1 : last / 8);
+            times.push_back(1000 * (now_ms() - start));
+
+            uint64_t moves = bb_moves(own, opp);
+            if (sq == -2 || (sq == -1 && moves != 0)
+                || (sq >= 0 && !(moves & (UINT64_C(1) << sq)))) {
+                fprintf(stderr, "bad reply from %s\n", program);
+                ok = false;
+                break;
+            }
+            if (sq >= 0) {
+                uint64_t flips = bb_flips(own, opp, sq);
+                own |= flips | (UINT64_C(1) << sq);
+                opp &= ~flips;
+            }
+            uint64_t t = own;
+            own = opp;
+            opp = t;
+            side ^= 1;
+            last = sq;
+        }
+        stop_engine(&engines[0]);
+        stop_engine(&engines[1]);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static void report(const char *name, vector<double> &times) {
+    sort(times.begin(), times.end());
+    double sum = 0;
+    for (size_t i = 0; i < times.size(); i++) sum += times[i];
+    size_t n = times.size();
+    printf("%-8s %7lu moves  mean %7.1f  p50 %7.1f  p99 %7.1f  max %8.1f us\n",
+           name, (unsigned long)n, sum / n, times[n / 2],
+           times[n * 99 / 100], times[n - 1]);
+}
+
+int main(int argc, char *argv[]) {
+    int games = (argc > 1) ? atoi(argv[1]) : 100;
+    const char *program = (argc > 2) ? argv[2] : "./shakespeare";
+    const char *engine = (argc > 3) ? argv[3] : "random";
+    if (games < 1) games = 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    const char *names[2] = { "text", "binary" };
+    for (int mode = 0; mode < 2; mode++) {
+        vector<double> times;
+        // Builds from before the binary framing fail it; go on regardless.
+        if (!run(program, engine, mode == 1, games, times)) {
+            fprintf(stderr, "cannot run %s %s with %s framing\n", program,
+                    engine, names[mode]);
+            continue;
+        }
+        report(names[mode], times);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+RefereeLink::RefereeLink(int in, int out, bool binary) {
+    this->in = in;
+    this->out = out;
+    this->binary = binary;
+    start = 0;
+    end = 0;
+}
+
+/*
+ * The next input byte, blocking until there is one, or -1 at the end of
+ * the input.
+ */
+int RefereeLink::next_byte() {
+    if (start == end) {
+        ssize_t n;
+        do {
+            n = read(in, buf, sizeof(buf));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return -1;
+        start = 0;
+        end = (int)n;
+    }
+    return (unsigned char)buf[start++];
+}
+
+/*
+ * Reads an optionally negative decimal integer, skipping whitespace before
+ * it.
+ */
+bool RefereeLink::read_int(int *value) {
+    int c = next_byte();
+    while (c == ' ' || c == '\n' || c == '\r' || c == '\t') c = next_byte();
+
+    bool negative = (c == '-');
+    if (negative) c = next_byte();
+    if (c < '0' || c > '9') return false;
+
+    int v = 0;
+    while (c >= '0' && c <= '9') {
+        v = 10 * v + (c - '0');
+        c = next_byte();
+    }
+    // The byte after the number is a separator, so dropping it is safe.
+    *value = negative ? -v : v;
+    return true;
+}
+
+/*
+ * Waits for the next request. Returns false at the end of the input or on
+ * a malformed request.
+ */
+bool RefereeLink::read_request(int *x, int *y, int *msLeft) {
+    if (!binary) return read_int(x) && read_int(y) && read_int(msLeft);
+
+    char frame[PROTOCOL_REQUEST];
+    for (int i = 0; i < PROTOCOL_REQUEST; i++) {
+        int c = next_byte();
+        if (c < 0) return false;
+        frame[i] = (char)c;
+    }
+    protocol_decode_request(frame, x, y, msLeft);
+    return true;
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+/*
+ * Sends our move, -1 -1 to pass, with a single write.
+ */
+bool RefereeLink::write_move(int x, int y) {
+    if (binary) {
+        char frame[PROTOCOL_REPLY] = { (char)x, (char)y };
+        return write_all(out, frame, sizeof(frame));
+    }
+
+    char line[16];
+    int n = 0;
+    int v[2] = { x, y };
+    for (int i = 0; i < 2; i++) {
+        if (v[i] < 0) {
+            line[n++] = '-';
+            v[i] = -v[i];
+        }
+        if (v[i] >= 10) line[n++] = (char)('0' + v[i] / 10 % 10);
+        line[n++] = (char)('0' + v[i] % 10);
+        line[n++] = (i == 0) ? ' ' : '\n';
+    }
+    return write_all(out, line, n);
+}
+
+bool RefereeLink::write_line(const char *line) {
+    return write_all(out, line, strlen(line)) && write_all(out, "\n", 1);
+}
+
+/*
+ * Packs a binary request into frame; returns its size.
+ */
+int protocol_encode_request(char *frame, int x, int y, int msLeft) {
+    unsigned int ms = (unsigned int)msLeft;
+    frame[0] = (char)x;
+    frame[1] = (char)y;
+    frame[2] = (char)(ms >> 24);
+    frame[3] = (char)(ms >> 16);
+    frame[4] = (char)(ms >> 8);
+    frame[5] = (char)ms;
+    return PROTOCOL_REQUEST;
+}
+
+void protocol_decode_request(const char *frame, int *x, int *y, int *msLeft) {
+    const unsigned char *f = (const unsigned char *)frame;
+    *x = (signed char)f[0];
+    *y = (signed char)f[1];
+    *msLeft = (int)((unsigned int)f[2] << 24 | (unsigned int)f[3] << 16
+                    | (unsigned int)f[4] << 8 | (unsigned int)f[5]);
+}
@@ -0,0 +1,55 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+/*
+ * The engine's end of the referee protocol, on raw file descriptors with
+ * its own buffer instead of iostreams.
+ *
+ * After starting, the engine writes the line "Init done". Then, for each
+ * move, the referee sends the opponent's move (-1 -1 for none) and the
+ * milliseconds left on our clock (-1 if untimed), and the engine replies
+ * with its move (-1 -1 to pass). In text framing, the default, these are
+ * lines of decimal numbers:
+ *
+ *     request  "x y msLeft\n"
+ *     reply    "x y\n"
+ *
+ * In binary framing, chosen by the referee by setting OTHELLO_FRAMING=binary
+ * in the engine's environment, they are fixed size frames:
+ *
+ *     request  6 bytes: x, y (signed bytes), msLeft (signed 32 bits, big
+ *              endian)
+ *     reply    2 bytes: x, y (signed bytes)
+ */
+
+#define PROTOCOL_BUFFER     4096
+
+// Bytes in a binary frame.
+#define PROTOCOL_REQUEST    6
+#define PROTOCOL_REPLY      2
+
+class RefereeLink {
+
+private:
+    int in;
+    int out;
+    bool binary;
+    char buf[PROTOCOL_BUFFER];
+    int start;
+    int end;
+
+    int next_byte();
+    bool read_int(int *value);
+
+public:
+    RefereeLink(int in, int out, bool binary);
+    bool read_request(int *x, int *y, int *msLeft);
+    bool write_move(int x, int y);
+    bool write_line(const char *line);
+    bool is_binary() { return binary; }
+};
+
+int protocol_encode_request(char *frame, int x, int y, int msLeft);
+void protocol_decode_request(const char *frame, int *x, int *y, int *msLeft);
+
+#endif
@@ -0,0 +1,521 @@
+#include "search.h"
+#include <cstdlib>
+#include <cstring>
+#include "common.h"
+#include "endgame.h"
+#include "engine.h"
+#include "eval.h"
+#include "threadpool.h"
+
+static const char *algorithm_names[SEARCH_ALGORITHMS] = {
+    "alphabeta", "pvs", "aspiration", "mtdf"
+};
+
+const char *search_algorithm_name(int algorithm) {
+    if (algorithm < 0 || algorithm >= SEARCH_ALGORITHMS) return "unknown";
+    return algorithm_names[algorithm];
+}
+
+/*
+ * Looks up an algorithm by the name search_algorithm_name() gives it.
+ */
+bool search_algorithm_parse(const char *name, SearchAlgorithm *algorithm) {
+    for (int i = 0; i < SEARCH_ALGORITHMS; i++) {
+        if (!strcmp(name, algorithm_names[i])) {
+            *algorithm = (SearchAlgorithm)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+NetworkEval::NetworkEval() {
+    nn = NULL;
+    void *p = NULL;
+    if (posix_memalign(&p, 64, (SEARCH_MAX_PLY + 1) * sizeof(NNAccumulator))
+        != 0) {
+        p = NULL;
+    }
+    acc = (NNAccumulator *)p;
+}
+
+NetworkEval::~NetworkEval() {
+    free(acc);
+}
+
+/*
+ * Scores leaves with the network instead of the handcrafted evaluation.
+ * Ignored unless the network has weights.
+ */
+void NetworkEval::set_nn(NNEval *nn) {
+    bool usable = nn != NULL && nn->loaded() && acc != NULL;
+    this->nn = usable ? nn : NULL;
+}
+
+template <class Eval, class Order, class Table>
+PolicyEngine<Eval, Order, Table>::PolicyEngine(size_t ttBytes)
+    : table(ttBytes, true) {
+    nodeCount = 0;
+    deadline = 0;
+    timeUp = false;
+    completed = 0;
+    trace = NULL;
+    iteration = 0;
+    ttProbes = ttHits = ttCutoffs = 0;
+    algorithm = SEARCH_ASPIRATION;
+    window = SEARCH_WINDOW;
+    sortDepth = SEARCH_SORT_DEPTH;
+}
+
+/*
+ * Forgets everything the table has learned, so that the next search starts
+ * from scratch (for benchmarks).
+ */
+template <class Eval, class Order, class Table>
+void PolicyEngine<Eval, Order, Table>::clear() {
+    table.clear();
+}
+
+/*
+ * Depth limited alpha-beta, with null window scouts for all but the first
+ * move unless the algorithm is plain alpha-beta. side is the accumulator
+ * index of the side to move. bestMove is only requested at the root, which
+ * never returns a table score without searching.
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::alphabeta(uint64_t own, uint64_t opp,
+                                                int alpha, int beta,
+                                                int depth, int ply, int side,
+                                                int *bestMove) {
+    nodeCount++;
+    PERF_NODE();
+    if ((nodeCount & (SEARCH_CHECK_NODES - 1)) == 0 && deadline > 0) {
+        double now = now_ms();
+        note(TRACE_TIME_CHECK, -1, (int)(deadline - now), nodeCount, 0);
+        if (now > deadline) {
+            timeUp = true;
+            note(TRACE_TIMEOUT, -1, 0, nodeCount, 0);
+        }
+    }
+    if (timeUp) return 0;
+
+    PERF_BEGIN(PERF_MOVEGEN);
+    uint64_t moves = bb_moves(own, opp);
+    PERF_END(PERF_MOVEGEN);
+    if (moves == 0) {
+        if (bestMove != NULL) *bestMove = -1;
+        if (bb_moves(opp, own) == 0) {
+            int diff = endgame_final_score(own, opp);
+            if (diff > 0) return SEARCH_WIN + diff;
+            if (diff < 0) return -SEARCH_WIN + diff;
+            return 0;
+        }
+        if (ply >= SEARCH_MAX_PLY) return leaf(own, opp, ply, side);
+        eval.pass(ply);
+        return -alphabeta(opp, own, -beta, -alpha, depth, ply + 1, 1 - side,
+                          NULL);
+    }
+    if (depth == 0 || ply >= SEARCH_MAX_PLY) {
+        return leaf(own, opp, ply, side);
+    }
+
+    uint64_t key = tt_key(own, opp);
+    TTData hit;
+    int ttMove = -1;
+    ttProbes++;
+    PERF_BEGIN(PERF_TT);
+    bool found = table.probe(key, &hit);
+    PERF_END(PERF_TT);
+    if (found) {
+        ttHits++;
+        if (bestMove == NULL && hit.depth >= depth) {
+            if (hit.lower >= beta || hit.lower == hit.upper) {
+                ttCutoffs++;
+                return hit.lower;
+            }
+            if (hit.upper <= alpha) {
+                ttCutoffs++;
+                return hit.upper;
+            }
+        }
+        ttMove = hit.move;
+    }
+
+    int *list = moveStack[ply];
+    int n = orderer.order(own, opp, moves, ttMove, depth >= sortDepth,
+                          list, table);
+    int alphaIn = alpha;
+    int best = -SEARCH_INFINITY;
+    int bm = list[0];
+    bool traced = (trace != NULL && bestMove != NULL);
+    for (int i = 0; i < n; i++) {
+        int sq = list[i];
+        PERF_BEGIN(PERF_MOVEGEN);
+        uint64_t flips = bb_flips(own, opp, sq);
+        PERF_END(PERF_MOVEGEN);
+        uint64_t newOwn = opp & ~flips;
+        uint64_t newOpp = own | flips | (UINT64_C(1) << sq);
+        eval.update(ply, side, sq, flips);
+        long before = nodeCount;
+        uint32_t started = traced ? trace->micros() : 0;
+
+        int score;
+        if (i == 0 || algorithm == SEARCH_ALPHABETA) {
+            score = -alphabeta(newOwn, newOpp, -beta, -alpha, depth - 1,
+                               ply + 1, 1 - side, NULL);
+        } else {
+            score = -alphabeta(newOwn, newOpp, -alpha - 1, -alpha, depth - 1,
+                               ply + 1, 1 - side, NULL);
+            if (score > alpha && score < beta) {
+                score = -alphabeta(newOwn, newOpp, -beta, -alpha, depth - 1,
+                                   ply + 1, 1 - side, NULL);
+            }
+        }
+        if (timeUp) return 0;
+        if (traced) {
+            trace->record(TRACE_ROOT_MOVE, iteration, sq, score,
+                          nodeCount - before, trace->micros() - started);
+        }
+
+        if (score > best) {
+            best = score;
+            bm = sq;
+            if (score > alpha) alpha = score;
+            if (score >= beta) break;
+        }
+    }
+
+    PERF_BEGIN(PERF_TT);
+    table.store(key, (best > alphaIn) ? best : -SEARCH_INFINITY,
+                 (best < beta) ? best : SEARCH_INFINITY, bm, depth);
+    PERF_END(PERF_TT);
+    if (bestMove != NULL) *bestMove = bm;
+    return best;
+}
+
+/*
+ * Searches the root with a window around guess, widening the side the
+ * score falls outside of until it lands inside.
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::aspiration(uint64_t own, uint64_t opp,
+                                                 int guess, int depth,
+                                                 int *bestMove) {
+    int below = window, above = window;
+    for (;;) {
+        int alpha = guess - below, beta = guess + above;
+        if (alpha < -SEARCH_INFINITY) alpha = -SEARCH_INFINITY;
+        if (beta > SEARCH_INFINITY) beta = SEARCH_INFINITY;
+
+        int score = alphabeta(own, opp, alpha, beta, depth, 0, BLACK,
+                              bestMove);
+        if (timeUp) return score;
+        if (score <= alpha && alpha > -SEARCH_INFINITY) below *= 2;
+        else if (score >= beta && beta < SEARCH_INFINITY) above *= 2;
+        else return score;
+    }
+}
+
+/*
+ * MTD(f): null window searches of the root, each moving a bound on the
+ * score towards the guess's side, until the bounds meet. Only a search that
+ * fails high proves its move.
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::mtdf(uint64_t own, uint64_t opp,
+                                           int guess, int depth,
+                                           int *bestMove) {
+    int lower = -SEARCH_INFINITY, upper = SEARCH_INFINITY;
+    int score = guess;
+    int move = -1;
+    while (lower < upper) {
+        int beta = (score == lower) ? score + 1 : score;
+        int m;
+        score = alphabeta(own, opp, beta - 1, beta, depth, 0, BLACK, &m);
+        if (timeUp) break;
+        if (score >= beta) {
+            lower = score;
+            move = m;
+        } else {
+            upper = score;
+            if (move == -1) move = m;
+        }
+    }
+    *bestMove = move;
+    return score;
+}
+
+/*
+ * Resets the counters and the clock for a new search from own, opp.
+ */
+template <class Eval, class Order, class Table>
+void PolicyEngine<Eval, Order, Table>::start(uint64_t own, uint64_t opp,
+                                             double ms) {
+    nodeCount = 0;
+    completed = 0;
+    timeUp = false;
+    deadline = (ms > 0) ? now_ms() + ms : 0;
+    table.new_search();
+    eval.refresh(own, opp);
+
+    iteration = 0;
+    ttProbes = ttHits = ttCutoffs = 0;
+    if (trace != NULL) {
+        trace->begin();
+        trace->record(TRACE_SEARCH, 0, -1, 64 - bb_count(own | opp),
+                      tt_key(own, opp), (uint32_t)ms);
+    }
+}
+
+/*
+ * Adds a record for the current iteration to the trace, if there is one.
+ */
+template <class Eval, class Order, class Table>
+void PolicyEngine<Eval, Order, Table>::note(int type, int move, int score,
+                                            uint64_t nodes, uint32_t extra) {
+    if (trace != NULL) {
+        trace->record(type, iteration, move, score, nodes, extra);
+    }
+}
+
+/*
+ * Marks the start of an iteration, saving the node and table counters that
+ * end_iteration() reports the iteration's share of.
+ */
+template <class Eval, class Order, class Table>
+void PolicyEngine<Eval, Order, Table>::begin_iteration(int depth, long *nodes,
+                                                       long *tt) {
+    iteration = depth;
+    note(TRACE_ITERATION, -1, 0, nodeCount, 0);
+    *nodes = nodeCount;
+    tt[0] = ttProbes;
+    tt[1] = ttHits;
+    tt[2] = ttCutoffs;
+}
+
+template <class Eval, class Order, class Table>
+void PolicyEngine<Eval, Order, Table>::end_iteration(int move, int score,
+                                                     long nodes, long *tt) {
+    note(TRACE_ITERATION_END, move, score, nodeCount - nodes, 0);
+    note(TRACE_TT, -1, (int)(ttCutoffs - tt[2]), ttProbes - tt[0],
+         (uint32_t)(ttHits - tt[1]));
+}
+
+/*
+ * Follows the table moves from own, opp for at most max moves, storing them
+ * in pv. Returns the number stored.
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::principal_variation(uint64_t own,
+                                                          uint64_t opp,
+                                                          int *pv, int max) {
+    int n = 0;
+    while (n < max) {
+        uint64_t moves = bb_moves(own, opp);
+        if (moves == 0) {
+            if (bb_moves(opp, own) == 0) break;
+            pv[n++] = -1;
+        } else {
+            TTData hit;
+            if (!table.probe(tt_key(own, opp), &hit) || hit.move < 0
+                || !(moves & (UINT64_C(1) << hit.move))) {
+                break;
+            }
+            uint64_t flips = bb_flips(own, opp, hit.move);
+            own |= flips | (UINT64_C(1) << hit.move);
+            opp &= ~flips;
+            pv[n++] = hit.move;
+        }
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+    }
+    return n;
+}
+
+/*
+ * Iterative deepening up to maxDepth plies, or until ms milliseconds have
+ * passed if ms is positive. Returns the score of the deepest iteration that
+ * finished and stores its move (x + 8*y, or -1 to pass) in bestMove.
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::run(uint64_t own, uint64_t opp,
+                                          int maxDepth, double ms,
+                                          int *bestMove) {
+    start(own, opp, ms);
+
+    int empties = 64 - bb_count(own | opp);
+    if (maxDepth > empties) maxDepth = empties;
+
+    // If not even the first iteration finishes, play any legal move.
+    uint64_t moves = bb_moves(own, opp);
+    int move = (moves != 0) ? bb_first(moves) : -1;
+    int score = 0;
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        long nodes, tt[3];
+        begin_iteration(depth, &nodes, tt);
+        int m = -1;
+        int s;
+        if (algorithm == SEARCH_ASPIRATION && depth > 1) {
+            s = aspiration(own, opp, score, depth, &m);
+        } else if (algorithm == SEARCH_MTDF) {
+            s = mtdf(own, opp, score, depth, &m);
+        } else {
+            s = alphabeta(own, opp, -SEARCH_INFINITY, SEARCH_INFINITY, depth,
+                          0, BLACK, &m);
+        }
+        if (timeUp) break;
+        score = s;
+        move = m;
+        completed = depth;
+        end_iteration(move, score, nodes, tt);
+    }
+
+    iteration = completed;
+    note(TRACE_SEARCH_END, move, score, nodeCount, 0);
+    if (bestMove != NULL) *bestMove = move;
+    return score;
+}
+
+/*
+ * Multi-PV analysis: finds the best lines moves in the position, best
+ * first, with their scores and principal variations. Each iteration of
+ * iterative deepening searches every root move, in the order of the
+ * previous iteration's scores. Until lines moves have been scored each one
+ * gets a full window; after that a move is first scouted with a null window
+ * at the worst score still reported, and only searched exactly if it beats
+ * it, displacing that line. Moves scored in the previous iteration are
+ * searched with an aspiration window around that score. Stops at maxDepth
+ * or after ms milliseconds if ms is positive, and returns the number of
+ * lines of the deepest iteration that finished.
+ *
+ * With few lines this costs a fraction of searching after every move
+ * (searchbench: 0.28 for one line, 0.44 for three). Asking for all lines
+ * does not get much below that: every move then needs an exact score, and
+ * an exact score cannot be had with fewer nodes than a separate search of
+ * the move, so only the shared table and move order help (0.96).
+ */
+template <class Eval, class Order, class Table>
+int PolicyEngine<Eval, Order, Table>::analyze(uint64_t own, uint64_t opp,
+                                              int lines, int maxDepth,
+                                              double ms, SearchLine *out) {
+    start(own, opp, ms);
+    nodeCount++;
+
+    uint64_t moves = bb_moves(own, opp);
+    int order[MAX_MOVES];
+    int nmoves = 0;
+    for (; moves; moves &= moves - 1) order[nmoves++] = bb_first(moves);
+    if (lines > nmoves) lines = nmoves;
+    if (lines <= 0) return 0;
+    int empties = 64 - bb_count(own | opp);
+    if (maxDepth > empties) maxDepth = empties;
+
+    SearchLine found[MAX_MOVES];
+    bool scored[64];
+    int last[64];
+    memset(scored, 0, sizeof(scored));
+    int done = 0;
+    for (int depth = 1; depth <= maxDepth && !timeUp; depth++) {
+        long nodes, tt[3];
+        begin_iteration(depth, &nodes, tt);
+        int n = 0;
+        for (int i = 0; i < nmoves && !timeUp; i++) {
+            int sq = order[i];
+            uint64_t flips = bb_flips(own, opp, sq);
+            uint64_t newOwn = opp & ~flips;
+            uint64_t newOpp = own | flips | (UINT64_C(1) << sq);
+            eval.update(0, BLACK, sq, flips);
+            long before = nodeCount;
+            uint32_t started = (trace != NULL) ? trace->micros() : 0;
+
+            int floor = (n < lines) ? -SEARCH_INFINITY : found[n - 1].score;
+            int score = floor;
+            if (n == lines) {
+                score = -alphabeta(newOwn, newOpp, -floor - 1, -floor,
+                                   depth - 1, 1, WHITE, NULL);
+            }
+
+            // A move scored last iteration gets an aspiration window around
+            // that score, widened on the side it fails; only the side above
+            // floor matters.
+            int below = window, above = window;
+            while (n < lines || score > floor) {
+                int alpha = floor, beta = SEARCH_INFINITY;
+                if (scored[sq]) {
+                    if (last[sq] - below > alpha) alpha = last[sq] - below;
+                    if (last[sq] + above < beta) beta = last[sq] + above;
+                }
+                score = -alphabeta(newOwn, newOpp, -beta, -alpha, depth - 1,
+                                   1, WHITE, NULL);
+                if (timeUp) break;
+                if (score <= alpha && alpha > floor) below *= 2;
+                else if (score >= beta && beta < SEARCH_INFINITY) above *= 2;
+                else break;
+            }
+            if (timeUp) break;
+            if (trace != NULL) {
+                trace->record(TRACE_ROOT_MOVE, depth, sq, score,
+                              nodeCount - before, trace->micros() - started);
+            }
+            if (score <= floor) continue;
+
+            // Insert the line, dropping the worst if there are too many.
+            if (n == lines) n--;
+            int j = n++;
+            while (j > 0 && found[j - 1].score < score) {
+                found[j] = found[j - 1];
+                j--;
+            }
+            SearchLine *line = &found[j];
+            line->move = sq;
+            line->score = score;
+            line->exact = (depth >= empties);
+            line->pv[0] = sq;
+            line->length = 1 + principal_variation(newOwn, newOpp,
+                                                   line->pv + 1, depth - 1);
+        }
+        if (timeUp) break;
+
+        for (int i = 0; i < n; i++) {
+            out[i] = found[i];
+            if (out[i].exact) {
+                if (out[i].score > 0) out[i].score -= SEARCH_WIN;
+                if (out[i].score < 0) out[i].score += SEARCH_WIN;
+            }
+        }
+        done = n;
+        completed = depth;
+        end_iteration(found[0].move, found[0].score, nodes, tt);
+
+        // Search the reported moves first next time, best first, each
+        // around its score.
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            order[k++] = found[i].move;
+            scored[found[i].move] = true;
+            last[found[i].move] = found[i].score;
+        }
+        for (uint64_t m = bb_moves(own, opp); m; m &= m - 1) {
+            int sq = bb_first(m);
+            bool reported = false;
+            for (int i = 0; i < n; i++) reported |= (found[i].move == sq);
+            if (!reported) order[k++] = sq;
+        }
+    }
+
+    iteration = completed;
+    note(TRACE_SEARCH_END, (done > 0) ? out[0].move : -1,
+         (done > 0) ? out[0].score : 0, nodeCount, 0);
+    return done;
+}
+
+template class PolicyEngine<DiscEval, BoardOrder, NoTable>;
+template class PolicyEngine<DiscEval, BoardOrder, TTable>;
+template class PolicyEngine<DiscEval, MobilityOrder, NoTable>;
+template class PolicyEngine<DiscEval, MobilityOrder, TTable>;
+template class PolicyEngine<HandcraftedEval, BoardOrder, NoTable>;
+template class PolicyEngine<HandcraftedEval, BoardOrder, TTable>;
+template class PolicyEngine<HandcraftedEval, MobilityOrder, NoTable>;
+template class PolicyEngine<HandcraftedEval, MobilityOrder, TTable>;
+template class PolicyEngine<NetworkEval, MobilityOrder, TTable>;
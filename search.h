@@ -0,0 +1,77 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+#include "ttable.h"
+
+#define SEARCH_MAX_PLY          64
+
+// Size of the transposition table.
+#define SEARCH_TT_BYTES         (16 << 20)
+
+// Bounds on scores. A finished game scores SEARCH_WIN plus the final disc
+// difference for the winner (empty squares counted for the winner, as in
+// endgame_final_score), so it outranks any evaluation.
+#define SEARCH_INFINITY         30000
+#define SEARCH_WIN              20000
+
+// Default half width of the first aspiration window, in evaluation units.
+// A search that falls outside it is repeated with the window on that side
+// doubled.
+#define SEARCH_WINDOW           16
+
+// By default nodes at least this far from the leaves sort their moves by
+// the opponent's mobility; shallower ones only put the table move first.
+#define SEARCH_SORT_DEPTH       2
+
+// How often, in nodes, the clock is checked.
+#define SEARCH_CHECK_NODES      4096
+
+/*
+ * How each iteration of iterative deepening searches the root:
+ *   SEARCH_ALPHABETA   full window alpha-beta everywhere
+ *   SEARCH_PVS         principal variation search: the first move of a node
+ *                      gets the full window, the rest a null window scout
+ *                      that is only re-searched if it fails high
+ *   SEARCH_ASPIRATION  PVS with a window around the previous iteration's
+ *                      score
+ *   SEARCH_MTDF        MTD(f): only null window searches, converging on the
+ *                      score from the previous iteration through the bounds
+ *                      kept in the transposition table
+ */
+enum SearchAlgorithm {
+    SEARCH_ALPHABETA, SEARCH_PVS, SEARCH_ASPIRATION, SEARCH_MTDF,
+    SEARCH_ALGORITHMS
+};
+
+const char *search_algorithm_name(int algorithm);
+bool search_algorithm_parse(const char *name, SearchAlgorithm *algorithm);
+
+/*
+ * One line of a multi-PV analysis: a root move, its score, and the moves
+ * expected to follow it (pv[0] is the move itself; -1 is a pass). If the
+ * search reached the end of the game the score is exact, as the final disc
+ * difference; otherwise it is in evaluation units.
+ */
+struct SearchLine {
+    int move;
+    int score;
+    bool exact;
+    int length;
+    int pv[SEARCH_MAX_PLY];
+};
+
+/*
+ * The search the player uses: PolicyEngine (engine.h) composed of the
+ * network (or tuned handcrafted) evaluation, mobility ordering and the
+ * transposition table. Include engine.h to create one.
+ */
+template <class Eval, class Order, class Table> class PolicyEngine;
+class NetworkEval;
+class MobilityOrder;
+
+typedef PolicyEngine<NetworkEval, MobilityOrder, TTable> Search;
+
+#endif
@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstdlib>
+#include "search.h"
+#include "engine.h"
+#include "positions.h"
+#include "threadpool.h"
+
+/*
+ * Compares the search algorithms by the nodes they need to search the same
+ * positions to the same depth. Positions are reached by random play from
+ * the start with a fixed seed, so every run searches the same set. The table
+ * is cleared before each search, so each one starts from nothing.
+ *
+ * Then finds the best 1, 3 and all moves of each position with one multi-PV
+ * analysis, and compares its nodes with searching the position after each
+ * move separately.
+ *
+ * Last, searches the positions with each engine the registry creates. The
+ * first four are Search with each root algorithm, without the network;
+ * eval/mobility/tt differs from pvs only in its evaluator not being able to
+ * take one, so it searches the same nodes.
+ *
+ * usage: searchbench [depth] [positions] [min empties] [max empties]
+ *                    [network weights]
+ */
+
+int main(int argc, char *argv[]) {
+    int depth = (argc > 1) ? atoi(argv[1]) : 7;
+    int positions = (argc > 2) ? atoi(argv[2]) : 50;
+    int minEmpties = (argc > 3) ? atoi(argv[3]) : 20;
+    int maxEmpties = (argc > 4) ? atoi(argv[4]) : 50;
+
+    NNEval nn;
+    if (argc > 5 && !nn.load(argv[5])) {
+        fprintf(stderr, "cannot load %s\n", argv[5]);
+        return 1;
+    }
+
+    uint64_t rng = POS_SEED;
+    uint64_t *own = new uint64_t[positions];
+    uint64_t *opp = new uint64_t[positions];
+    for (int i = 0; i < positions; i++) {
+        int empties = minEmpties + i % (maxEmpties - minEmpties + 1);
+        pos_random_position(empties, &rng, &own[i], &opp[i]);
+    }
+
+    Search search(SEARCH_TT_BYTES);
+    search.eval.set_nn(&nn);
+    printf("%d positions, depth %d, %s evaluation\n", positions, depth,
+           nn.loaded() ? "network" : "handcrafted");
+    printf("algorithm          nodes   vs alphabeta      time ms  "
+           "other scores  other moves\n");
+
+    int *scores = new int[positions];
+    int *moves = new int[positions];
+    long baseNodes = 0;
+    for (int a = 0; a < SEARCH_ALGORITHMS; a++) {
+        search.algorithm = (SearchAlgorithm)a;
+        long nodes = 0;
+        int scoreDiffs = 0, moveDiffs = 0;
+        double start = now_ms();
+        for (int i = 0; i < positions; i++) {
+            search.clear();
+            int move;
+            int score = search.run(own[i], opp[i], depth, 0, &move);
+            nodes += search.nodes();
+            // The table lets scores differ slightly between algorithms,
+            // since entries from deeper searches can be used.
+            if (a == SEARCH_ALPHABETA) {
+                scores[i] = score;
+                moves[i] = move;
+            } else {
+                if (score != scores[i]) scoreDiffs++;
+                if (move != moves[i]) moveDiffs++;
+            }
+        }
+        double ms = now_ms() - start;
+        if (a == SEARCH_ALPHABETA) baseNodes = nodes;
+
+        printf("%-10s %13ld %14.3f %12.1f %13d %12d\n",
+               search_algorithm_name(a), nodes,
+               (double)nodes / (baseNodes > 0 ? baseNodes : 1), ms,
+               scoreDiffs, moveDiffs);
+    }
+
+    // Multi-PV analysis against what it replaces: one search of the
+    // position after each move, since all of them must be scored to know
+    // which are best.
+    search.algorithm = SEARCH_PVS;
+    long separateNodes = 0;
+    for (int i = 0; i < positions; i++) {
+        for (uint64_t m = bb_moves(own[i], opp[i]); m; m &= m - 1) {
+            int sq = bb_first(m);
+            uint64_t flips = bb_flips(own[i], opp[i], sq);
+            int move;
+            search.clear();
+            search.run(opp[i] & ~flips, own[i] | flips | (UINT64_C(1) << sq),
+                       depth - 1, 0, &move);
+            separateNodes += search.nodes();
+        }
+    }
+    printf("\nmulti-pv (pvs)          nodes  vs one search per move\n");
+    printf("separate   %13ld %14.3f\n", separateNodes, 1.0);
+
+    static const int ks[] = { 1, 3, MAX_MOVES };
+    for (int k = 0; k < 3; k++) {
+        long nodes = 0;
+        for (int i = 0; i < positions; i++) {
+            SearchLine lines[MAX_MOVES];
+            search.clear();
+            search.analyze(own[i], opp[i], ks[k], depth, 0, lines);
+            nodes += search.nodes();
+        }
+        if (ks[k] == MAX_MOVES) printf("all lines ");
+        else printf("%2d lines  ", ks[k]);
+        printf(" %13ld %14.3f\n", nodes,
+               (double)nodes / (separateNodes > 0 ? separateNodes : 1));
+    }
+
+    printf("\npolicy engine              nodes      time ms\n");
+    for (int e = 0; e < engine_count; e++) {
+        if (engine_registry[e].create == NULL) continue;
+        Engine *engine = engine_registry[e].create();
+        long nodes = 0;
+        double start = now_ms();
+        for (int i = 0; i < positions; i++) {
+            int move;
+            engine->clear();
+            engine->run(own[i], opp[i], depth, 0, &move);
+            nodes += engine->nodes();
+        }
+        printf("%-20s %12ld %12.1f\n", engine_registry[e].name, nodes,
+               now_ms() - start);
+        delete engine;
+    }
+
+    delete[] own;
+    delete[] opp;
+    delete[] scores;
+    delete[] moves;
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include "searchcache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC         "OSC1"
+#define CACHE_HEADER        16
+#define CACHE_MAX_ENTRIES   (1 << 20)
+
+/*
+ * Hashes a position and side to move into a 64 bit key.
+ */
+uint64_t position_key(uint64_t black, uint64_t white, int side) {
+    uint64_t h = black * UINT64_C(0x9E3779B97F4A7C15);
+    h ^= (h >> 29) ^ (white * UINT64_C(0xBF58476D1CE4E5B9));
+    h ^= (h >> 32) ^ (uint64_t)(side + 1) * UINT64_C(0x94D049BB133111EB);
+    return h ^ (h >> 31);
+}
+
+/*
+ * Orders entries by key, then by position, with deeper results first so that
+ * duplicates can be dropped by keeping the first of each run.
+ */
+static bool entry_less(const CacheEntry &a, const CacheEntry &b) {
+    if (a.key != b.key) return a.key < b.key;
+    if (a.black != b.black) return a.black < b.black;
+    if (a.white != b.white) return a.white < b.white;
+    if (a.side != b.side) return a.side < b.side;
+    return a.depth > b.depth;
+}
+
+static bool same_position(const CacheEntry &a, const CacheEntry &b) {
+    return a.key == b.key && a.black == b.black && a.white == b.white
+        && a.side == b.side;
+}
+
+static bool deeper(const CacheEntry &a, const CacheEntry &b) {
+    return a.depth > b.depth;
+}
+
+SearchCache::SearchCache() {
+    table = NULL;
+    count = 0;
+    mapSize = 0;
+}
+
+SearchCache::~SearchCache() {
+    unload();
+}
+
+/*
+ * Maps the cache file at path. The pages are populated up front so that the
+ * first probes during the game do not stall on disk. A missing or invalid
+ * file just leaves the cache empty.
+ */
+bool SearchCache::load(const char *path) {
+    unload();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < CACHE_HEADER) {
+        close(fd);
+        return false;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+
+    const char *base = (const char *)p;
+    uint64_t n;
+    memcpy(&n, base + 8, sizeof(n));
+    if (memcmp(base, CACHE_MAGIC, 4) != 0
+        || CACHE_HEADER + n * sizeof(CacheEntry) > (uint64_t)st.st_size) {
+        munmap(p, st.st_size);
+        return false;
+    }
+
+    table = (const CacheEntry *)(base + CACHE_HEADER);
+    count = n;
+    mapSize = st.st_size;
+    return true;
+}
+
+void SearchCache::unload() {
+    if (table != NULL) {
+        munmap((char *)table - CACHE_HEADER, mapSize);
+        table = NULL;
+    }
+    count = 0;
+    mapSize = 0;
+}
+
+const CacheEntry *SearchCache::find(uint64_t key, uint64_t black,
+                                    uint64_t white, int side) {
+    // Results from this run take precedence over the file.
+    for (size_t i = added.size(); i-- > 0; ) {
+        const CacheEntry &e = added[i];
+        if (e.key == key && e.black == black && e.white == white
+            && e.side == side) {
+            return &e;
+        }
+    }
+
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (table[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    for (; lo < count && table[lo].key == key; lo++) {
+        const CacheEntry &e = table[lo];
+        if (e.black == black && e.white == white && e.side == side) return &e;
+    }
+    return NULL;
+}
+
+/*
+ * Looks up the position on b with side to move. Returns true and fills in
+ * out if a result searched to at least minDepth is known.
+ */
+bool SearchCache::probe(Board *b, Side side, int minDepth, CacheEntry *out) {
+    uint64_t black = b->getBits(BLACK);
+    uint64_t white = b->getBits(WHITE);
+    const CacheEntry *e = find(position_key(black, white, side), black, white,
+                               side);
+    if (e == NULL || e->depth < minDepth) return false;
+    *out = *e;
+    return true;
+}
+
+/*
+ * Records the result of a search of the position on b with side to move.
+ */
+void SearchCache::store(Board *b, Side side, int depth, Move *move,
+                        int score) {
+    CacheEntry e;
+    memset(&e, 0, sizeof(e));
+    e.black = b->getBits(BLACK);
+    e.white = b->getBits(WHITE);
+    e.key = position_key(e.black, e.white, side);
+    e.side = side;
+    e.depth = depth;
+    e.move = (move == NULL) ? -1 : move->getX() + 8 * move->getY();
+    e.score = score;
+    added.push_back(e);
+}
+
+/*
+ * Merges the results of this run that were searched to at least minDepth
+ * into the file at path. The file is re-read under a lock so that several
+ * processes saving at once do not drop each other's results, and replaced
+ * atomically so that readers never see a partial file.
+ */
+bool SearchCache::save(const char *path, int minDepth) {
+    vector<CacheEntry> all;
+    for (size_t i = 0; i < added.size(); i++) {
+        if (added[i].depth >= minDepth) all.push_back(added[i]);
+    }
+    if (all.empty()) return true;
+
+    string lockPath = string(path) + ".lock";
+    int lockfd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lockfd < 0) return false;
+    flock(lockfd, LOCK_EX);
+
+    SearchCache current;
+    if (current.load(path)) {
+        all.insert(all.end(), current.table, current.table + current.count);
+    }
+    current.unload();
+
+    if (all.size() > CACHE_MAX_ENTRIES) {
+        stable_sort(all.begin(), all.end(), deeper);
+        all.resize(CACHE_MAX_ENTRIES);
+    }
+    stable_sort(all.begin(), all.end(), entry_less);
+
+    size_t n = 0;
+    for (size_t i = 0; i < all.size(); i++) {
+        if (n > 0 && same_position(all[n - 1], all[i])) continue;
+        all[n++] = all[i];
+    }
+    all.resize(n);
+
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp.%d", path, (int)getpid());
+    FILE *fp = fopen(tmpPath, "wb");
+    bool ok = (fp != NULL);
+    if (ok) {
+        char header[CACHE_HEADER];
+        uint64_t count64 = n;
+        memset(header, 0, sizeof(header));
+        memcpy(header, CACHE_MAGIC, 4);
+        memcpy(header + 8, &count64, sizeof(count64));
+        ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+            && fwrite(&all[0], sizeof(CacheEntry), n, fp) == n;
+        ok = (fclose(fp) == 0) && ok;
+        ok = ok && rename(tmpPath, path) == 0;
+        if (!ok) unlink(tmpPath);
+    }
+
+    flock(lockfd, LOCK_UN);
+    close(lockfd);
+    if (ok) added.clear();
+    return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef __SEARCHCACHE_H__
+#define __SEARCHCACHE_H__
+
+#include <vector>
+#include <stdint.h>
+#include "common.h"
+#include "board.h"
+using namespace std;
+
+/*
+ * A search result for one position, as stored in the cache file. Entries in
+ * the file are sorted by key so they can be looked up in place.
+ */
+struct CacheEntry {
+    uint64_t key;
+    uint64_t black;
+    uint64_t white;
+    int32_t score;
+    int8_t side;
+    int8_t depth;
+    int8_t move;
+    int8_t pad;
+};
+
+/*
+ * Search results kept across games. Results from earlier runs are mapped
+ * read-only from disk when the cache is loaded; results from this run are
+ * kept in memory and merged into the file by save().
+ */
+class SearchCache {
+
+private:
+    const CacheEntry *table;
+    size_t count;
+    size_t mapSize;
+    vector<CacheEntry> added;
+
+    const CacheEntry *find(uint64_t key, uint64_t black, uint64_t white,
+                           int side);
+
+public:
+    SearchCache();
+    ~SearchCache();
+    bool load(const char *path);
+    void unload();
+    bool probe(Board *b, Side side, int minDepth, CacheEntry *out);
+    void store(Board *b, Side side, int depth, Move *move, int score);
+    bool save(const char *path, int minDepth);
+    size_t size() { return count + added.size(); }
+};
+
+uint64_t position_key(uint64_t black, uint64_t white, int side);
+
+#endif
@@ -0,0 +1,95 @@
+#include "searchtrace.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include "threadpool.h"
+
+static const char *type_names[TRACE_TYPES] = {
+    "search", "iteration", "root-move", "iteration-end", "tt", "time-check",
+    "timeout", "search-end", "lost"
+};
+
+const char *trace_type_name(int type) {
+    if (type < 0 || type >= TRACE_TYPES) return "unknown";
+    return type_names[type];
+}
+
+/*
+ * Opens path for appending, with a ring of the given number of records.
+ * Check ok() before use.
+ */
+SearchTrace::SearchTrace(const char *path, size_t records) {
+    capacity = (records > 0) ? records : 1;
+    ring = new TraceRecord[capacity];
+    written = 0;
+    flushed = 0;
+    fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    startMs = now_ms();
+}
+
+SearchTrace::~SearchTrace() {
+    flush();
+    if (fd >= 0) close(fd);
+    delete[] ring;
+}
+
+/*
+ * Starts the clock that record times are measured from.
+ */
+void SearchTrace::begin() {
+    startMs = now_ms();
+}
+
+uint32_t SearchTrace::micros() {
+    return (uint32_t)((now_ms() - startMs) * 1000);
+}
+
+void SearchTrace::record(int type, int depth, int move, int score,
+                         uint64_t nodes, uint32_t extra) {
+    TraceRecord *r = &ring[written % capacity];
+    r->type = (uint8_t)type;
+    r->depth = (int8_t)depth;
+    r->move = (int16_t)move;
+    r->score = score;
+    r->micros = micros();
+    r->extra = extra;
+    r->nodes = nodes;
+    written++;
+}
+
+/*
+ * Writes the records since the last flush to the file, oldest first.
+ * Returns false if the file could not be written; the records are dropped
+ * either way.
+ */
+bool SearchTrace::flush() {
+    if (written == flushed) return true;
+    if (fd < 0) {
+        flushed = written;
+        return false;
+    }
+
+    bool good = true;
+    if (written - flushed > capacity) {
+        TraceRecord lost;
+        lost.type = TRACE_LOST;
+        lost.depth = 0;
+        lost.move = -1;
+        lost.score = 0;
+        lost.micros = 0;
+        lost.extra = (uint32_t)(written - flushed - capacity);
+        lost.nodes = 0;
+        good &= write(fd, &lost, sizeof(lost)) == (ssize_t)sizeof(lost);
+        flushed = written - capacity;
+    }
+
+    // The unflushed records may wrap around the end of the ring.
+    while (flushed < written) {
+        size_t first = flushed % capacity;
+        size_t n = capacity - first;
+        if (n > written - flushed) n = written - flushed;
+        ssize_t bytes = n * sizeof(TraceRecord);
+        good &= write(fd, &ring[first], bytes) == bytes;
+        flushed += n;
+    }
+    return good;
+}
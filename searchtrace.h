@@ -0,0 +1,82 @@
+#ifndef __SEARCHTRACE_H__
+#define __SEARCHTRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary trace of what a search did with its time, for working out
+ * afterwards why a move took as long as it did.
+ *
+ * The search writes fixed size records into a ring buffer in memory; the
+ * caller flushes it to a file between moves, so no I/O happens while the
+ * clock runs. If a search writes more records than the ring holds, the
+ * oldest are overwritten and the flush starts with a TRACE_LOST record
+ * saying how many. Records are appended in host byte order; tracereport
+ * summarizes a trace file.
+ */
+
+// Records in the ring buffer by default (24 bytes each).
+#define TRACE_RECORDS       (1 << 16)
+
+/*
+ * Record types, and what their fields hold. micros is always the time since
+ * the search started and depth the iteration it was in.
+ *   TRACE_SEARCH      a search starts: score = empties, extra = time budget
+ *                     in ms (0 if untimed), nodes = the position's table key
+ *   TRACE_ITERATION   an iteration starts
+ *   TRACE_ROOT_MOVE   a root move was searched: score = its score (a bound
+ *                     if it was outside the window), extra = microseconds
+ *                     spent on it, nodes = nodes in its subtree
+ *   TRACE_ITERATION_END
+ *                     an iteration finished: move, score = its result,
+ *                     nodes = nodes it searched
+ *   TRACE_TT          table use during the iteration that just finished:
+ *                     nodes = probes, extra = hits, score = cutoffs
+ *   TRACE_TIME_CHECK  the clock was read: score = ms left before the
+ *                     deadline, nodes = nodes so far
+ *   TRACE_TIMEOUT     the deadline passed during the iteration
+ *   TRACE_SEARCH_END  the search returned: depth = deepest iteration
+ *                     finished, move, score = its result, nodes = total
+ *   TRACE_LOST        extra = records overwritten before they were flushed
+ */
+enum TraceType {
+    TRACE_SEARCH, TRACE_ITERATION, TRACE_ROOT_MOVE, TRACE_ITERATION_END,
+    TRACE_TT, TRACE_TIME_CHECK, TRACE_TIMEOUT, TRACE_SEARCH_END, TRACE_LOST,
+    TRACE_TYPES
+};
+
+struct TraceRecord {
+    uint8_t type;
+    int8_t depth;
+    int16_t move;       // x + 8*y, -1 for a pass or none
+    int32_t score;
+    uint32_t micros;
+    uint32_t extra;
+    uint64_t nodes;
+};
+
+class SearchTrace {
+
+private:
+    TraceRecord *ring;
+    size_t capacity;
+    uint64_t written;   // records ever written to the ring
+    uint64_t flushed;   // of which this many have been flushed or lost
+    int fd;
+    double startMs;
+
+public:
+    SearchTrace(const char *path, size_t records);
+    ~SearchTrace();
+    bool ok() { return fd >= 0 && ring != NULL; }
+    void begin();
+    uint32_t micros();
+    void record(int type, int depth, int move, int score, uint64_t nodes,
+                uint32_t extra);
+    bool flush();
+};
+
+const char *trace_type_name(int type);
+
+#endif
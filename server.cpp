@@ -0,0 +1,278 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "player.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Hosts many games in one process. Each connection to the Unix socket is one
+ * game and speaks the same line protocol as wrapper.cpp: the client sends
+ * the side ("Black" or "White"), the server answers "Init done", then each
+ * "x y msLeft" line is answered with the engine's move ("-1 -1" to pass).
+ *
+ * One thread multiplexes the sockets; the searches themselves run on a
+ * shared pool of workers, earliest deadline first.
+ */
+
+struct Game {
+    int fd;
+    Player *player;
+    string input;
+    int requests;
+    bool busy;
+    bool hungUp;
+};
+
+static pthread_mutex_t games_lock = PTHREAD_MUTEX_INITIALIZER;
+static int wake_pipe[2];
+
+/*
+ * Writes all of buf to fd, returning false if the peer went away.
+ */
+static bool write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/*
+ * Handles one request line for a game on a pool worker.
+ */
+class GameTask : public Task {
+
+private:
+    Game *game;
+    string line;
+
+public:
+    GameTask(Game *game, const string &line) {
+        this->game = game;
+        this->line = line;
+    }
+
+    void run() {
+        char reply[32];
+        if (game->player == NULL) {
+            Side side = (line.compare(0, 5, "Black") == 0) ? BLACK : WHITE;
+            game->player = new Player(side);
+            game->player->showBoard = false;
+            strcpy(reply, "Init done\n");
+        } else {
+            int moveX = -1, moveY = -1, msLeft = -1;
+            sscanf(line.c_str(), "%d %d %d", &moveX, &moveY, &msLeft);
+            Move *opponentsMove = NULL;
+            if (moveX >= 0 && moveY >= 0) {
+                opponentsMove = new Move(moveX, moveY);
+            }
+
+            Move *playersMove = game->player->doMove(opponentsMove, msLeft);
+            if (playersMove != NULL) {
+                sprintf(reply, "%d %d\n", playersMove->x, playersMove->y);
+            } else {
+                strcpy(reply, "-1 -1\n");
+            }
+            if (opponentsMove != NULL) delete opponentsMove;
+            if (playersMove != NULL) delete playersMove;
+        }
+        write_all(game->fd, reply, strlen(reply));
+
+        // Hand the game back to the I/O thread.
+        pthread_mutex_lock(&games_lock);
+        game->busy = false;
+        pthread_mutex_unlock(&games_lock);
+        char c = 0;
+        if (write(wake_pipe[1], &c, 1) < 0) {
+            // The I/O thread polls again within a second anyway.
+        }
+    }
+};
+
+/*
+ * Ends a hung up game on a pool worker: deleting the player saves its
+ * caches, which must not hold up the I/O thread.
+ */
+class CloseTask : public Task {
+
+private:
+    Game *game;
+
+public:
+    CloseTask(Game *game) {
+        this->game = game;
+    }
+
+    void run() {
+        close(game->fd);
+        delete game->player;
+        delete game;
+    }
+};
+
+/*
+ * Deadline for the next search of a game: the time left split evenly over
+ * the moves this side still has to make.
+ */
+static double search_deadline(Game *game, int msLeft) {
+    if (msLeft < 0) return now_ms() + 1e9;
+    int movesLeft = (60 - 2 * game->requests) / 2;
+    if (movesLeft < 1) movesLeft = 1;
+    return now_ms() + (double)msLeft / movesLeft;
+}
+
+/*
+ * Queues the next complete request line of an idle game. Must be called
+ * with games_lock held.
+ */
+static void dispatch(Game *game, ThreadPool *pool) {
+    size_t end = game->input.find('\n');
+    if (end == string::npos) return;
+
+    string line = game->input.substr(0, end);
+    game->input.erase(0, end + 1);
+
+    double deadline = now_ms();
+    if (game->player != NULL) {
+        int x, y, msLeft = -1;
+        sscanf(line.c_str(), "%d %d %d", &x, &y, &msLeft);
+        deadline = search_deadline(game, msLeft);
+        game->requests++;
+    }
+    game->busy = true;
+    pool->submit(new GameTask(game, line), deadline);
+}
+
+static int listen_on(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || listen(fd, 128) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " socket [threads]" << endl;
+        exit(-1);
+    }
+
+    int listenfd = listen_on(argv[1]);
+    if (listenfd < 0) {
+        cerr << "cannot listen on " << argv[1] << ": " << strerror(errno)
+             << endl;
+        exit(-1);
+    }
+    if (pipe(wake_pipe) < 0) {
+        cerr << "pipe: " << strerror(errno) << endl;
+        exit(-1);
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    ThreadPool pool((argc == 3) ? atoi(argv[2]) : 0);
+    cerr << "serving on " << argv[1] << " with " << pool.size()
+         << " search threads" << endl;
+
+    vector<Game *> games;
+    vector<struct pollfd> fds;
+    vector<Game *> polled;
+
+    for (;;) {
+        // Finish hung up games and start queued requests of idle ones.
+        pthread_mutex_lock(&games_lock);
+        for (unsigned int i = 0; i < games.size(); ) {
+            Game *game = games[i];
+            if (!game->busy) dispatch(game, &pool);
+            if (!game->busy && game->hungUp) {
+                // After the searches that have a deadline.
+                pool.submit(new CloseTask(game), now_ms() + 1e9);
+                games[i] = games.back();
+                games.pop_back();
+                continue;
+            }
+            i++;
+        }
+
+        fds.clear();
+        polled.clear();
+        struct pollfd p;
+        p.events = POLLIN;
+        p.fd = listenfd;
+        fds.push_back(p);
+        p.fd = wake_pipe[0];
+        fds.push_back(p);
+        for (unsigned int i = 0; i < games.size(); i++) {
+            if (games[i]->hungUp) continue;
+            p.fd = games[i]->fd;
+            fds.push_back(p);
+            polled.push_back(games[i]);
+        }
+        pthread_mutex_unlock(&games_lock);
+
+        if (poll(&fds[0], fds.size(), 1000) < 0 && errno != EINTR) {
+            cerr << "poll: " << strerror(errno) << endl;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[256];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenfd, NULL, NULL);
+            if (fd >= 0) {
+                Game *game = new Game();
+                game->fd = fd;
+                game->player = NULL;
+                game->requests = 0;
+                game->busy = false;
+                game->hungUp = false;
+                pthread_mutex_lock(&games_lock);
+                games.push_back(game);
+                pthread_mutex_unlock(&games_lock);
+            }
+        }
+
+        for (unsigned int i = 0; i < polled.size(); i++) {
+            if (!(fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            char buf[4096];
+            ssize_t n = read(polled[i]->fd, buf, sizeof(buf));
+            pthread_mutex_lock(&games_lock);
+            if (n > 0) polled[i]->input.append(buf, n);
+            else if (n == 0 || errno != EINTR) polled[i]->hungUp = true;
+            pthread_mutex_unlock(&games_lock);
+        }
+    }
+
+    close(listenfd);
+    unlink(argv[1]);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "positions.h"
+#include "simdboard.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Checks the batch kernels against each other and measures their
+ * throughput on random positions from random games.
+ *
+ * usage: simdbench [boards] [rounds]
+ */
+
+static uint64_t rng_state = UINT64_C(0x9E3779B97F4A7C15);
+
+static void random_boards(vector<BoardPair> &boards, vector<int> &squares) {
+    uint64_t own = 0, opp = 0;
+    for (unsigned int i = 0; i < boards.size(); i++) {
+        uint64_t moves = bb_moves(own, opp);
+        if (moves == 0 && bb_moves(opp, own) == 0) {
+            own = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+            opp = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+            moves = bb_moves(own, opp);
+        }
+
+        int sq = 0;
+        if (moves != 0) {
+            sq = pos_random_move(moves, &rng_state);
+        }
+        boards[i].own = own;
+        boards[i].opp = opp;
+        squares[i] = sq;
+
+        if (moves != 0) {
+            uint64_t flips = bb_flips(own, opp, sq);
+            own |= flips | (UINT64_C(1) << sq);
+            opp &= ~flips;
+        }
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+    }
+}
+
+/*
+ * Runs every kernel of k over the boards, rounds times, and prints the rate
+ * in millions of boards per second.
+ */
+static void bench(const BatchKernels *k, vector<BoardPair> &boards,
+                  vector<int> &squares, int rounds) {
+    int n = (int)boards.size();
+    vector<uint64_t> masks(n);
+    vector<int> counts(n);
+    double ms[4];
+
+    double start = now_ms();
+    for (int r = 0; r < rounds; r++) k->moves(&boards[0], &masks[0], n);
+    ms[0] = now_ms() - start;
+
+    start = now_ms();
+    for (int r = 0; r < rounds; r++) {
+        k->flips(&boards[0], &squares[0], &masks[0], n);
+    }
+    ms[1] = now_ms() - start;
+
+    start = now_ms();
+    for (int r = 0; r < rounds; r++) k->mobility(&boards[0], &counts[0], n);
+    ms[2] = now_ms() - start;
+
+    start = now_ms();
+    for (int r = 0; r < rounds; r++) k->frontier(&boards[0], &counts[0], n);
+    ms[3] = now_ms() - start;
+
+    double total = (double)n * rounds / 1000.0;
+    printf("%-8s", k->name);
+    for (int i = 0; i < 4; i++) printf(" %10.1f", total / ms[i]);
+    printf("\n");
+}
+
+/*
+ * Compares the outputs of two kernel sets. Returns false on any mismatch.
+ */
+static bool check(const BatchKernels *a, const BatchKernels *b,
+                  vector<BoardPair> &boards, vector<int> &squares) {
+    int n = (int)boards.size();
+    vector<uint64_t> ma(n), mb(n);
+    vector<int> ca(n), cb(n);
+
+    a->moves(&boards[0], &ma[0], n);
+    b->moves(&boards[0], &mb[0], n);
+    if (ma != mb) return false;
+    a->flips(&boards[0], &squares[0], &ma[0], n);
+    b->flips(&boards[0], &squares[0], &mb[0], n);
+    if (ma != mb) return false;
+    a->mobility(&boards[0], &ca[0], n);
+    b->mobility(&boards[0], &cb[0], n);
+    if (ca != cb) return false;
+    a->frontier(&boards[0], &ca[0], n);
+    b->frontier(&boards[0], &cb[0], n);
+    return ca == cb;
+}
+
+int main(int argc, char *argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : 4096;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 2000;
+
+    vector<BoardPair> boards(n);
+    vector<int> squares(n);
+    random_boards(boards, squares);
+
+    const BatchKernels *avx2 = batch_avx2();
+    if (avx2 != NULL) {
+        // Odd sizes exercise the scalar tail of the vector kernels.
+        for (int len = 1; len <= 19; len++) {
+            vector<BoardPair> part(boards.begin(), boards.begin() + len);
+            vector<int> partSquares(squares.begin(), squares.begin() + len);
+            if (!check(&batch_scalar, avx2, part, partSquares)) {
+                printf("avx2 kernels disagree with scalar (%d boards)\n", len);
+                return 1;
+            }
+        }
+        if (!check(&batch_scalar, avx2, boards, squares)) {
+            printf("avx2 kernels disagree with scalar\n");
+            return 1;
+        }
+    }
+
+    printf("%d boards x %d rounds, millions of boards per second\n", n, rounds);
+    printf("kernels       moves      flips   mobility   frontier\n");
+    bench(&batch_scalar, boards, squares, rounds);
+    if (avx2 != NULL) bench(avx2, boards, squares, rounds);
+    else printf("avx2     not supported on this CPU\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "simdboard.h"
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Columns B-G. Masking the opponent's stones with this before shifting
+// sideways keeps runs from wrapping around an edge.
+#define BB_INNER_FILES  UINT64_C(0x7E7E7E7E7E7E7E7E)
+
+static void scalar_moves(const BoardPair *boards, uint64_t *out, int n) {
+    for (int i = 0; i < n; i++) out[i] = bb_moves(boards[i].own, boards[i].opp);
+}
+
+static void scalar_flips(const BoardPair *boards, const int *squares,
+                         uint64_t *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = bb_flips(boards[i].own, boards[i].opp, squares[i]);
+    }
+}
+
+static void scalar_mobility(const BoardPair *boards, int *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = bb_count(bb_moves(boards[i].own, boards[i].opp));
+    }
+}
+
+static void scalar_frontier(const BoardPair *boards, int *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = bb_count(bb_frontier(boards[i].own, boards[i].opp));
+    }
+}
+
+const BatchKernels batch_scalar = {
+    "scalar", scalar_moves, scalar_flips, scalar_mobility, scalar_frontier
+};
+
+/*
+ * Loads boards[0..3] and splits them into one vector of own stones and one
+ * of opponent stones, in board order.
+ */
+static inline AVX2 void load4(const BoardPair *boards, __m256i *own,
+                              __m256i *opp) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)boards);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(boards + 2));
+    // unpack gives lanes in the order 0, 2, 1, 3.
+    *own = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xD8);
+    *opp = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xD8);
+}
+
+/*
+ * Moves in the directions that shift by s (left shifts for the positive
+ * directions, right shifts for the negative ones).
+ */
+static inline AVX2 __m256i moves_left(__m256i own, __m256i opp, __m256i empty,
+                                      int s) {
+    __m256i t = _mm256_and_si256(_mm256_slli_epi64(own, s), opp);
+    for (int i = 0; i < 5; i++) {
+        t = _mm256_or_si256(t, _mm256_and_si256(_mm256_slli_epi64(t, s), opp));
+    }
+    return _mm256_and_si256(_mm256_slli_epi64(t, s), empty);
+}
+
+static inline AVX2 __m256i moves_right(__m256i own, __m256i opp,
+                                       __m256i empty, int s) {
+    __m256i t = _mm256_and_si256(_mm256_srli_epi64(own, s), opp);
+    for (int i = 0; i < 5; i++) {
+        t = _mm256_or_si256(t, _mm256_and_si256(_mm256_srli_epi64(t, s), opp));
+    }
+    return _mm256_and_si256(_mm256_srli_epi64(t, s), empty);
+}
+
+static inline AVX2 __m256i moves4(__m256i own, __m256i opp) {
+    __m256i inner = _mm256_and_si256(opp,
+        _mm256_set1_epi64x((long)BB_INNER_FILES));
+    __m256i empty = _mm256_xor_si256(_mm256_or_si256(own, opp),
+        _mm256_set1_epi64x(-1));
+
+    __m256i m = moves_left(own, inner, empty, 1);
+    m = _mm256_or_si256(m, moves_right(own, inner, empty, 1));
+    m = _mm256_or_si256(m, moves_left(own, opp, empty, 8));
+    m = _mm256_or_si256(m, moves_right(own, opp, empty, 8));
+    m = _mm256_or_si256(m, moves_left(own, inner, empty, 7));
+    m = _mm256_or_si256(m, moves_right(own, inner, empty, 7));
+    m = _mm256_or_si256(m, moves_left(own, inner, empty, 9));
+    m = _mm256_or_si256(m, moves_right(own, inner, empty, 9));
+    return m;
+}
+
+/*
+ * Flips in one direction from the move bits in m: the run of opponent
+ * stones is kept only in lanes where it ends on one of our stones.
+ */
+static inline AVX2 __m256i flips_left(__m256i m, __m256i own, __m256i opp,
+                                      int s) {
+    __m256i f = _mm256_and_si256(_mm256_slli_epi64(m, s), opp);
+    for (int i = 0; i < 5; i++) {
+        f = _mm256_or_si256(f, _mm256_and_si256(_mm256_slli_epi64(f, s), opp));
+    }
+    __m256i end = _mm256_and_si256(_mm256_slli_epi64(f, s), own);
+    __m256i none = _mm256_cmpeq_epi64(end, _mm256_setzero_si256());
+    return _mm256_andnot_si256(none, f);
+}
+
+static inline AVX2 __m256i flips_right(__m256i m, __m256i own, __m256i opp,
+                                       int s) {
+    __m256i f = _mm256_and_si256(_mm256_srli_epi64(m, s), opp);
+    for (int i = 0; i < 5; i++) {
+        f = _mm256_or_si256(f, _mm256_and_si256(_mm256_srli_epi64(f, s), opp));
+    }
+    __m256i end = _mm256_and_si256(_mm256_srli_epi64(f, s), own);
+    __m256i none = _mm256_cmpeq_epi64(end, _mm256_setzero_si256());
+    return _mm256_andnot_si256(none, f);
+}
+
+static inline AVX2 __m256i flips4(__m256i own, __m256i opp, __m256i sq) {
+    __m256i m = _mm256_sllv_epi64(_mm256_set1_epi64x(1), sq);
+    __m256i inner = _mm256_and_si256(opp,
+        _mm256_set1_epi64x((long)BB_INNER_FILES));
+
+    __m256i f = flips_left(m, own, inner, 1);
+    f = _mm256_or_si256(f, flips_right(m, own, inner, 1));
+    f = _mm256_or_si256(f, flips_left(m, own, opp, 8));
+    f = _mm256_or_si256(f, flips_right(m, own, opp, 8));
+    f = _mm256_or_si256(f, flips_left(m, own, inner, 7));
+    f = _mm256_or_si256(f, flips_right(m, own, inner, 7));
+    f = _mm256_or_si256(f, flips_left(m, own, inner, 9));
+    f = _mm256_or_si256(f, flips_right(m, own, inner, 9));
+    return f;
+}
+
+static inline AVX2 __m256i frontier4(__m256i own, __m256i opp) {
+    __m256i notA = _mm256_set1_epi64x((long)~BB_FILE_A);
+    __m256i notH = _mm256_set1_epi64x((long)~BB_FILE_H);
+    __m256i east = _mm256_and_si256(_mm256_slli_epi64(own, 1), notA);
+    __m256i west = _mm256_and_si256(_mm256_srli_epi64(own, 1), notH);
+    __m256i row = _mm256_or_si256(own, _mm256_or_si256(east, west));
+    __m256i around = _mm256_or_si256(_mm256_or_si256(east, west),
+        _mm256_or_si256(_mm256_slli_epi64(row, 8), _mm256_srli_epi64(row, 8)));
+    return _mm256_andnot_si256(_mm256_or_si256(own, opp), around);
+}
+
+/*
+ * Population count of each 64 bit lane, using a nibble lookup table.
+ */
+static inline AVX2 __m256i popcount4(__m256i x) {
+    const __m256i table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(x, low));
+    __m256i hi = _mm256_shuffle_epi8(table,
+        _mm256_and_si256(_mm256_srli_epi16(x, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+static inline AVX2 void store_counts(__m256i counts, int *out) {
+    // Each count fits in the low 32 bits of its lane.
+    __m256i packed = _mm256_permutevar8x32_epi32(counts,
+        _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(packed));
+}
+
+static AVX2 void avx2_moves(const BoardPair *boards, uint64_t *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i own0, opp0, own1, opp1;
+        load4(boards + i, &own0, &opp0);
+        load4(boards + i + 4, &own1, &opp1);
+        _mm256_storeu_si256((__m256i *)(out + i), moves4(own0, opp0));
+        _mm256_storeu_si256((__m256i *)(out + i + 4), moves4(own1, opp1));
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256i own, opp;
+        load4(boards + i, &own, &opp);
+        _mm256_storeu_si256((__m256i *)(out + i), moves4(own, opp));
+    }
+    scalar_moves(boards + i, out + i, n - i);
+}
+
+static AVX2 void avx2_flips(const BoardPair *boards, const int *squares,
+                            uint64_t *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i own0, opp0, own1, opp1;
+        load4(boards + i, &own0, &opp0);
+        load4(boards + i + 4, &own1, &opp1);
+        __m256i sq0 = _mm256_cvtepi32_epi64(
+            _mm_loadu_si128((const __m128i *)(squares + i)));
+        __m256i sq1 = _mm256_cvtepi32_epi64(
+            _mm_loadu_si128((const __m128i *)(squares + i + 4)));
+        _mm256_storeu_si256((__m256i *)(out + i), flips4(own0, opp0, sq0));
+        _mm256_storeu_si256((__m256i *)(out + i + 4), flips4(own1, opp1, sq1));
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256i own, opp;
+        load4(boards + i, &own, &opp);
+        __m256i sq = _mm256_cvtepi32_epi64(
+            _mm_loadu_si128((const __m128i *)(squares + i)));
+        _mm256_storeu_si256((__m256i *)(out + i), flips4(own, opp, sq));
+    }
+    scalar_flips(boards + i, squares + i, out + i, n - i);
+}
+
+static AVX2 void avx2_mobility(const BoardPair *boards, int *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i own0, opp0, own1, opp1;
+        load4(boards + i, &own0, &opp0);
+        load4(boards + i + 4, &own1, &opp1);
+        store_counts(popcount4(moves4(own0, opp0)), out + i);
+        store_counts(popcount4(moves4(own1, opp1)), out + i + 4);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256i own, opp;
+        load4(boards + i, &own, &opp);
+        store_counts(popcount4(moves4(own, opp)), out + i);
+    }
+    scalar_mobility(boards + i, out + i, n - i);
+}
+
+static AVX2 void avx2_frontier(const BoardPair *boards, int *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i own0, opp0, own1, opp1;
+        load4(boards + i, &own0, &opp0);
+        load4(boards + i + 4, &own1, &opp1);
+        store_counts(popcount4(frontier4(own0, opp0)), out + i);
+        store_counts(popcount4(frontier4(own1, opp1)), out + i + 4);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256i own, opp;
+        load4(boards + i, &own, &opp);
+        store_counts(popcount4(frontier4(own, opp)), out + i);
+    }
+    scalar_frontier(boards + i, out + i, n - i);
+}
+
+static const BatchKernels avx2_kernels = {
+    "avx2", avx2_moves, avx2_flips, avx2_mobility, avx2_frontier
+};
+
+const BatchKernels *batch_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+}
+
+const BatchKernels *batch_kernels() {
+    static const BatchKernels *best = NULL;
+    if (best == NULL) {
+        const BatchKernels *k = batch_avx2();
+        best = (k != NULL) ? k : &batch_scalar;
+    }
+    return best;
+}
+
+void batch_moves(const BoardPair *boards, uint64_t *out, int n) {
+    batch_kernels()->moves(boards, out, n);
+}
+
+void batch_flips(const BoardPair *boards, const int *squares, uint64_t *out,
+                 int n) {
+    batch_kernels()->flips(boards, squares, out, n);
+}
+
+void batch_mobility(const BoardPair *boards, int *out, int n) {
+    batch_kernels()->mobility(boards, out, n);
+}
+
+void batch_frontier(const BoardPair *boards, int *out, int n) {
+    batch_kernels()->frontier(boards, out, n);
+}
@@ -0,0 +1,59 @@
+#ifndef __SIMDBOARD_H__
+#define __SIMDBOARD_H__
+
+#include <stdint.h>
+#include "bitboard.h"
+
+/*
+ * Batch kernels over many independent positions. Each position is a pair of
+ * bitboards: the stones of the side to move and those of its opponent.
+ */
+struct BoardPair {
+    uint64_t own;
+    uint64_t opp;
+};
+
+/*
+ * One implementation of the batch kernels. All functions process n boards;
+ * outputs are written in input order.
+ *
+ *   moves     legal move mask of each board
+ *   flips     stones flipped by playing squares[i] on board i
+ *   mobility  number of legal moves of each board
+ *   frontier  number of empty squares next to a stone of the side to move
+ */
+struct BatchKernels {
+    const char *name;
+    void (*moves)(const BoardPair *boards, uint64_t *out, int n);
+    void (*flips)(const BoardPair *boards, const int *squares, uint64_t *out,
+                  int n);
+    void (*mobility)(const BoardPair *boards, int *out, int n);
+    void (*frontier)(const BoardPair *boards, int *out, int n);
+};
+
+// Portable kernels, one board at a time.
+extern const BatchKernels batch_scalar;
+
+// AVX2 kernels (4 boards per vector, 8 per loop iteration), or NULL if this
+// CPU lacks AVX2.
+const BatchKernels *batch_avx2();
+
+// The fastest kernels this CPU supports, chosen on first use.
+const BatchKernels *batch_kernels();
+
+void batch_moves(const BoardPair *boards, uint64_t *out, int n);
+void batch_flips(const BoardPair *boards, const int *squares, uint64_t *out,
+                 int n);
+void batch_mobility(const BoardPair *boards, int *out, int n);
+void batch_frontier(const BoardPair *boards, int *out, int n);
+
+/*
+ * Empty squares adjacent to at least one stone of own.
+ */
+static inline uint64_t bb_frontier(uint64_t own, uint64_t opp) {
+    uint64_t around = 0;
+    for (int dir = 0; dir < 8; dir++) around |= bb_shift(own, dir);
+    return around & ~(own | opp);
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <cstdlib>
+#include "endgame.h"
+#include "threadpool.h"
+
+/*
+ * Solves 4x4 and 6x6 Othello with the endgame solver, as a deterministic
+ * end-to-end benchmark of search, transposition table and parallel scaling.
+ * Each board is solved with 1, 2, 4, ... threads up to the given maximum.
+ *
+ * Given a number of plies, the solve starts that far along a fixed opening
+ * line (each side playing the move that leaves the other the fewest
+ * replies). From the initial position (0 plies) the result is checked
+ * against the known outcome of perfect play; otherwise the thread counts
+ * are checked against each other.
+ *
+ * By default 4x4 starts from the initial position and 6x6 from
+ * SMALLSOLVE_6X6_PLIES plies in. The 6x6 solve gets about 8 times longer
+ * for every two plies earlier it starts (8 plies take 14 s on one thread),
+ * so from the initial position it takes hours, and it has not been run to
+ * the end: the 6x6 known result below is the published one, not one this
+ * program has reproduced.
+ *
+ * usage: smallsolve [max threads] [4|6] [plies]
+ */
+
+#define SMALLSOLVE_6X6_PLIES    10
+
+/*
+ * Plays plies moves of the opening line. Passes count as plies.
+ */
+template <int N>
+static void opening(int plies, uint64_t *own, uint64_t *opp) {
+    typedef BoardGeometry<N> G;
+    uint64_t a = G::start_black(), b = G::start_white();
+    for (int i = 0; i < plies; i++) {
+        uint64_t moves = G::moves(a, b);
+        int best = -1, fewest = 64;
+        for (; moves; moves &= moves - 1) {
+            int sq = bb_first(moves);
+            uint64_t flips = G::flips(a, b, sq);
+            int replies = bb_count(G::moves(b & ~flips,
+                                            a | flips | (UINT64_C(1) << sq)));
+            if (replies < fewest) {
+                fewest = replies;
+                best = sq;
+            }
+        }
+        if (best >= 0) {
+            uint64_t flips = G::flips(a, b, best);
+            a |= flips | (UINT64_C(1) << best);
+            b &= ~flips;
+        }
+        uint64_t t = a;
+        a = b;
+        b = t;
+    }
+    *own = a;
+    *opp = b;
+}
+
+/*
+ * Solves the position after the opening with 1, 2, 4, ... threads and prints
+ * a row for each. Returns false if a score differs from the expected one,
+ * or, when there is none, from the single threaded score.
+ */
+template <int N>
+static bool run(int maxThreads, int plies, bool known, int expected) {
+    uint64_t own, opp;
+    opening<N>(plies, &own, &opp);
+
+    bool ok = true;
+    double serialMs = 0;
+    for (int t = 1; t <= maxThreads; t *= 2) {
+        EndgameSolverT<N> solver(t);
+        int move;
+        double start = now_ms();
+        int score = solver.solve_mtd(own, opp, 0, &move);
+        double ms = now_ms() - start;
+        if (t == 1) {
+            serialMs = ms;
+            if (!known) expected = score;
+        }
+
+        long nodes = solver.nodes();
+        bool right = (score == expected);
+        ok &= right;
+        printf("%dx%d %5d %7d %11.1f %12ld %10.0f %8.2f %6d  %c%d%s\n", N, N,
+               plies, solver.threads(), ms, nodes,
+               nodes / (ms > 0 ? ms : 1) * 1000, serialMs / (ms > 0 ? ms : 1),
+               score, (move < 0) ? '-' : 'a' + move % 8,
+               (move < 0) ? 0 : move / 8 + 1, right ? "" : "  WRONG");
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : online_cpus();
+    int size = (argc > 2) ? atoi(argv[2]) : 0;
+    int plies = (argc > 3) ? atoi(argv[3]) : -1;
+
+    printf("size plies threads    time ms        nodes    nodes/s  speedup  "
+           "score  move\n");
+    bool ok = true;
+    // Scores are for the side to move (black at the start). 4x4: white
+    // wins 11-3 with two squares left empty, which count for the winner.
+    // 6x6: white wins 20-16 (published, unverified here).
+    if (size == 0 || size == 4) {
+        int p = (plies < 0) ? 0 : plies;
+        ok &= run<4>(maxThreads, p, p == 0, -10);
+    }
+    if (size == 0 || size == 6) {
+        int p = (plies < 0) ? SMALLSOLVE_6X6_PLIES : plies;
+        ok &= run<6>(maxThreads, p, p == 0, -4);
+    }
+    return ok ? 0 : 1;
+}
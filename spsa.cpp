@@ -0,0 +1,278 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <pthread.h>
+#include "player.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Tunes the parameters in tune.h by SPSA (simultaneous perturbation
+ * stochastic approximation). Each iteration perturbs every parameter that
+ * the chosen engine mode uses, all at once, by plus or minus its step, and
+ * plays game pairs between the two perturbed engines: both play each random
+ * opening once from each side, on a clock. The parameters then move towards
+ * the engine that scored better, in proportion to the score difference.
+ * Games are played in this process, in parallel on all cores.
+ *
+ * The run resumes from the checkpoint if there is one, otherwise it starts
+ * from the parameter file if there is one, otherwise from the defaults. The
+ * checkpoint is rewritten after every iteration, and the output file (the
+ * one the player reads, TUNE_FILE) after the last.
+ *
+ * Run it where there is no network weights file: the player uses the
+ * network instead of the evaluation weights being tuned.
+ *
+ * usage: spsa [iterations] [game pairs per iteration] [clock ms]
+ *             [minimax|search|mcts] [threads] [checkpoint] [output]
+ */
+
+// Random plies played from the start position before each game pair.
+#define SPSA_OPENING_PLIES  8
+
+// Gain sequences: parameters move by SPSA_GAIN / (k + 1 + SPSA_STABILITY)
+// ^ 0.602 steps per unit of score difference, and are perturbed by
+// 1 / (k + 1) ^ 0.101 steps, at iteration k.
+#define SPSA_GAIN           10.0
+#define SPSA_STABILITY      10
+
+struct Match {
+    TuneParams plus;
+    TuneParams minus;
+    EngineMode mode;
+    int clockMs;
+    int iteration;
+    int games;
+    int next;           // next game to play
+    int points;         // for plus: 2 a win, 1 a draw
+};
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= UINT64_C(0xFF51AFD7ED558CCD);
+    x ^= x >> 33;
+    return x;
+}
+
+/*
+ * Plays random moves from the start, the same ones for the same iteration
+ * and pair, and returns the side to move after them.
+ */
+static Side opening(int iteration, int pair, Board *board) {
+    uint64_t rng = mix(((uint64_t)iteration << 32) + pair + 1);
+    uint64_t own = BB_SQUARE(4, 3) | BB_SQUARE(3, 4);
+    uint64_t opp = BB_SQUARE(3, 3) | BB_SQUARE(4, 4);
+    Side side = BLACK;
+    for (int i = 0; i < SPSA_OPENING_PLIES; i++) {
+        uint64_t moves = bb_moves(own, opp);
+        if (moves == 0) break;
+        rng = mix(rng);
+        int n = (int)(rng % bb_count(moves));
+        while (n--) moves &= moves - 1;
+        int sq = bb_first(moves);
+        uint64_t flips = bb_flips(own, opp, sq);
+        own |= flips | (UINT64_C(1) << sq);
+        opp &= ~flips;
+        uint64_t t = own;
+        own = opp;
+        opp = t;
+        side = (side == BLACK) ? WHITE : BLACK;
+    }
+    if (side == BLACK) board->setBits(own, opp);
+    else board->setBits(opp, own);
+    return side;
+}
+
+/*
+ * Plays one game from board with params[side] for each side, each with
+ * clockMs for the whole game. Returns black's disc difference at the end;
+ * a side that runs out of time or makes an illegal move loses by 64.
+ */
+static int play(const TuneParams *params[2], EngineMode mode, int clockMs,
+                Board board, Side side) {
+    Player *players[2];
+    double clock[2];
+    for (int s = 0; s < 2; s++) {
+        players[s] = new Player((Side)s, &board);
+        players[s]->showBoard = false;
+        players[s]->mode = mode;
+        players[s]->tuning = *params[s];
+        clock[s] = clockMs;
+    }
+
+    int result = 0;
+    Move *last = NULL;
+    while (!board.isDone()) {
+        double start = now_ms();
+        Move *move = players[side]->doMove(last, (int)clock[side]);
+        clock[side] -= now_ms() - start;
+        if (clock[side] < 0 || (move != NULL && !board.checkMove(move, side))
+            || (move == NULL && board.hasMoves(side))) {
+            result = (side == BLACK) ? -64 : 64;
+            delete move;
+            break;
+        }
+        board.doMove(move, side);
+        delete last;
+        last = move;
+        side = (side == BLACK) ? WHITE : BLACK;
+    }
+    delete last;
+    if (board.isDone()) result = board.countBlack() - board.countWhite();
+
+    delete players[0];
+    delete players[1];
+    return result;
+}
+
+/*
+ * Plays the match's games until there are none left. Game g is the g/2-th
+ * opening, with plus playing black when g is even.
+ */
+static void *worker(void *arg) {
+    Match *m = (Match *)arg;
+    for (;;) {
+        int g = __sync_fetch_and_add(&m->next, 1);
+        if (g >= m->games) break;
+
+        Board board;
+        Side side = opening(m->iteration, g / 2, &board);
+        bool plusBlack = (g % 2 == 0);
+        const TuneParams *params[2];
+        params[BLACK] = plusBlack ? &m->plus : &m->minus;
+        params[WHITE] = plusBlack ? &m->minus : &m->plus;
+        int diff = play(params, m->mode, m->clockMs, board, side);
+        if (!plusBlack) diff = -diff;
+        __sync_fetch_and_add(&m->points, (diff > 0) ? 2 : (diff == 0) ? 1 : 0);
+    }
+    return NULL;
+}
+
+static bool save_checkpoint(const char *path, int iteration,
+                            const TuneParams *theta) {
+    string tmp = string(path) + ".tmp";
+    ofstream out(tmp.c_str());
+    if (!out) return false;
+    out.precision(17);
+    out << "iteration " << iteration << "\n";
+    theta->write(out, false);
+    out.close();
+    return !out.fail() && rename(tmp.c_str(), path) == 0;
+}
+
+static bool load_checkpoint(const char *path, int *iteration,
+                            TuneParams *theta) {
+    ifstream in(path);
+    string tag;
+    if (!(in >> tag >> *iteration) || tag != "iteration") return false;
+    return theta->read(in);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100;
+    int pairs = (argc > 2) ? atoi(argv[2]) : 8;
+    int clockMs = (argc > 3) ? atoi(argv[3]) : 2000;
+    const char *modeName = (argc > 4) ? argv[4] : "search";
+    int nthreads = (argc > 5) ? atoi(argv[5]) : online_cpus();
+    const char *checkpoint = (argc > 6) ? argv[6] : "spsa.checkpoint";
+    const char *output = (argc > 7) ? argv[7] : TUNE_FILE;
+
+    EngineMode mode;
+    int modes;
+    if (!strcmp(modeName, "minimax")) {
+        mode = MODE_MINIMAX;
+        modes = TUNE_MINIMAX;
+    } else if (!strcmp(modeName, "search")) {
+        mode = MODE_SEARCH;
+        modes = TUNE_SEARCH;
+    } else if (!strcmp(modeName, "mcts")) {
+        mode = MODE_MCTS;
+        modes = TUNE_MCTS;
+    } else {
+        fprintf(stderr, "unknown mode %s\n", modeName);
+        return 1;
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (FILE *nn = fopen(NN_WEIGHTS_FILE, "rb")) {
+        fclose(nn);
+        fprintf(stderr, "warning: %s replaces the evaluation being tuned\n",
+                NN_WEIGHTS_FILE);
+    }
+
+    TuneParams theta;
+    int start = 0;
+    if (load_checkpoint(checkpoint, &start, &theta)) {
+        printf("resuming %s at iteration %d\n", checkpoint, start);
+    } else {
+        start = 0;
+        theta = TuneParams();
+        theta.load(output);
+    }
+
+    uint64_t rng = mix((uint64_t)start + 12345);
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = start; k < iterations; k++) {
+        double a = SPSA_GAIN / pow(k + 1 + SPSA_STABILITY, 0.602);
+        double c = 1 / pow(k + 1, 0.101);
+
+        // Perturb each parameter by c steps in a random direction.
+        Match match;
+        int delta[TUNE_PARAMS];
+        match.plus = theta;
+        match.minus = theta;
+        for (int p = 0; p < TUNE_PARAMS; p++) {
+            delta[p] = 0;
+            if (!(tune_specs[p].modes & modes)) continue;
+            rng = mix(rng + p + 1);
+            delta[p] = (rng & 1) ? 1 : -1;
+            match.plus.value[p] += c * tune_specs[p].step * delta[p];
+            match.minus.value[p] -= c * tune_specs[p].step * delta[p];
+        }
+        match.plus.clamp();
+        match.minus.clamp();
+        match.mode = mode;
+        match.clockMs = clockMs;
+        match.iteration = k;
+        match.games = 2 * pairs;
+        match.next = 0;
+        match.points = 0;
+
+        double t0 = now_ms();
+        for (int i = 0; i < nthreads; i++) {
+            pthread_create(&threads[i], NULL, worker, &match);
+        }
+        for (int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+
+        // Score difference of plus over minus, from -1 to 1, and the step
+        // of the gradient estimate it gives.
+        double y = (match.points - match.games) / (double)match.games;
+        for (int p = 0; p < TUNE_PARAMS; p++) {
+            if (delta[p] == 0) continue;
+            theta.value[p] += a * tune_specs[p].step * y / (2 * c * delta[p]);
+        }
+        theta.clamp();
+
+        printf("iteration %d: plus %.1f of %d, %.1f s\n", k + 1,
+               match.points / 2.0, match.games, (now_ms() - t0) / 1000);
+        for (int p = 0; p < TUNE_PARAMS; p++) {
+            if (delta[p] != 0) {
+                printf("  %-18s %10.4f\n", tune_specs[p].name, theta.value[p]);
+            }
+        }
+        fflush(stdout);
+        if (!save_checkpoint(checkpoint, k + 1, &theta)) {
+            fprintf(stderr, "cannot write %s\n", checkpoint);
+        }
+    }
+    delete[] threads;
+
+    if (!theta.save(output)) {
+        fprintf(stderr, "cannot write %s\n", output);
+        return 1;
+    }
+    printf("wrote %s\n", output);
+    return 0;
+}
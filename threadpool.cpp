@@ -0,0 +1,89 @@
+#include "threadpool.h"
+#include <unistd.h>
+#include <sys/time.h>
+
+/*
+ * Number of processors available, at least 1.
+ */
+int online_cpus() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n < 1) ? 1 : (int)n;
+}
+
+/*
+ * Wall clock time in milliseconds.
+ */
+double now_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/*
+ * Starts nthreads workers (one per processor if nthreads is not positive).
+ */
+ThreadPool::ThreadPool(int nthreads) {
+    if (nthreads <= 0) nthreads = online_cpus();
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&ready, NULL);
+    submitted = 0;
+    stopping = false;
+
+    for (int i = 0; i < nthreads; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker, this) == 0) threads.push_back(t);
+    }
+}
+
+/*
+ * Runs the tasks still queued, then stops the workers.
+ */
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&ready);
+    pthread_mutex_unlock(&lock);
+
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_cond_destroy(&ready);
+    pthread_mutex_destroy(&lock);
+}
+
+/*
+ * Queues a task. Among queued tasks the one with the earliest deadline (in
+ * now_ms() time) runs first; equal deadlines run in submission order.
+ */
+void ThreadPool::submit(Task *task, double deadline) {
+    Entry e;
+    e.deadline = deadline;
+    e.task = task;
+
+    pthread_mutex_lock(&lock);
+    e.seq = submitted++;
+    queue.push(e);
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&lock);
+}
+
+void *ThreadPool::worker(void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queue.empty() && !pool->stopping) {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+        if (pool->queue.empty()) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        Task *task = pool->queue.top().task;
+        pool->queue.pop();
+        pthread_mutex_unlock(&pool->lock);
+
+        task->run();
+        delete task;
+    }
+}
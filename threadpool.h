@@ -0,0 +1,57 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <queue>
+#include <vector>
+#include <pthread.h>
+using namespace std;
+
+/*
+ * A unit of work for the thread pool. The pool deletes a task after running
+ * it.
+ */
+class Task {
+
+public:
+    virtual ~Task() {}
+    virtual void run() = 0;
+};
+
+/*
+ * A fixed set of worker threads sharing one queue. Tasks are run earliest
+ * deadline first, so work for a game that is short on time is not stuck
+ * behind work for games that can afford to wait.
+ */
+class ThreadPool {
+
+private:
+    struct Entry {
+        double deadline;
+        long seq;
+        Task *task;
+        bool operator<(const Entry &e) const {
+            if (deadline != e.deadline) return deadline > e.deadline;
+            return seq > e.seq;
+        }
+    };
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    vector<pthread_t> threads;
+    priority_queue<Entry> queue;
+    long submitted;
+    bool stopping;
+
+    static void *worker(void *arg);
+
+public:
+    ThreadPool(int nthreads);
+    ~ThreadPool();
+    void submit(Task *task, double deadline);
+    int size() { return (int)threads.size(); }
+};
+
+int online_cpus();
+double now_ms();
+
+#endif
@@ -0,0 +1,239 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "searchtrace.h"
+using namespace std;
+
+/*
+ * Summarizes the search traces written by shakespeare when OTHELLO_TRACE is
+ * set. For each search it prints the iterations (nodes, time, effective
+ * branching factor, table use and result) and how the nodes and time were
+ * split between the root moves, then the branching factor per depth over
+ * all the searches.
+ *
+ * usage: tracereport [-q] trace...   (-q prints only the totals)
+ */
+
+#define MAX_DEPTH   128
+
+struct Iteration {
+    bool done;
+    long nodes;
+    double ms;          // time since the search started when it ended
+    int move;
+    int score;
+    long probes, hits, cutoffs;
+};
+
+struct RootMove {
+    int move;
+    long nodes;
+    double ms;
+    int depth;          // deepest iteration that finished searching it
+    int score;
+};
+
+// Totals over all searches, per depth, for the branching factor.
+static double depthNodes[MAX_DEPTH];
+static double parentNodes[MAX_DEPTH];
+static long depthCount[MAX_DEPTH];
+
+static void print_move(int move) {
+    if (move < 0) printf("%-7s", "pass");
+    else printf("(%d,%d)  ", move % 8, move / 8);
+}
+
+/*
+ * Prints one search, records [first, last), and adds its iterations to the
+ * totals.
+ */
+static void report(const vector<TraceRecord> &recs, size_t first,
+                   size_t last, int number, bool quiet) {
+    Iteration its[MAX_DEPTH];
+    memset(its, 0, sizeof(its));
+    vector<RootMove> roots;
+    int empties = 0, budget = 0, reached = 0, timeout = 0;
+    long checks = 0, total = 0;
+    int closest = -1;
+    double endMs = 0;
+    bool ended = false;
+
+    for (size_t i = first; i < last; i++) {
+        const TraceRecord &r = recs[i];
+        int d = (r.depth >= 0) ? r.depth : 0;
+        endMs = r.micros / 1000.0;
+        switch (r.type) {
+        case TRACE_SEARCH:
+            empties = r.score;
+            budget = r.extra;
+            break;
+        case TRACE_ROOT_MOVE: {
+            size_t j = 0;
+            while (j < roots.size() && roots[j].move != r.move) j++;
+            if (j == roots.size()) {
+                RootMove m = { r.move, 0, 0, 0, 0 };
+                roots.push_back(m);
+            }
+            roots[j].nodes += r.nodes;
+            roots[j].ms += r.extra / 1000.0;
+            if (d >= roots[j].depth) {
+                roots[j].depth = d;
+                roots[j].score = r.score;
+            }
+            break;
+        }
+        case TRACE_ITERATION_END:
+            its[d].done = true;
+            its[d].nodes = r.nodes;
+            its[d].ms = r.micros / 1000.0;
+            its[d].move = r.move;
+            its[d].score = r.score;
+            break;
+        case TRACE_TT:
+            its[d].probes = r.nodes;
+            its[d].hits = r.extra;
+            its[d].cutoffs = r.score;
+            break;
+        case TRACE_TIME_CHECK:
+            checks++;
+            if (closest < 0 || r.score < closest) closest = r.score;
+            break;
+        case TRACE_TIMEOUT:
+            timeout = d;
+            break;
+        case TRACE_SEARCH_END:
+            ended = true;
+            reached = d;
+            total = r.nodes;
+            break;
+        }
+    }
+
+    for (int d = 2; d < MAX_DEPTH; d++) {
+        if (its[d].done && its[d - 1].done && its[d - 1].nodes > 0) {
+            depthNodes[d] += its[d].nodes;
+            parentNodes[d] += its[d - 1].nodes;
+            depthCount[d]++;
+        }
+    }
+    if (quiet) return;
+
+    if (recs[first].type != TRACE_SEARCH) {
+        printf("search %d: start lost to a full ring, ", number);
+    } else {
+        printf("search %d: %d empties, ", number, empties);
+    }
+    if (budget > 0) printf("budget %d ms, ", budget);
+    else if (recs[first].type == TRACE_SEARCH) printf("untimed, ");
+    if (ended) {
+        printf("depth %d in %.1f ms, %ld nodes", reached, endMs, total);
+    } else {
+        printf("no end record (trace cut short)");
+    }
+    if (timeout > 0) printf(", timed out in depth %d", timeout);
+    printf("\n");
+    if (checks > 0) {
+        printf("  %ld clock checks, closest %d ms before the deadline\n",
+               checks, closest);
+    }
+
+    printf("  depth        nodes      ms     ebf  tt hit%%  cut%%  "
+           "best     score\n");
+    for (int d = 1; d < MAX_DEPTH; d++) {
+        Iteration *it = &its[d];
+        if (!it->done) continue;
+        printf("  %5d %12ld %7.1f ", d, it->nodes, it->ms);
+        if (d > 1 && its[d - 1].done && its[d - 1].nodes > 0) {
+            printf("%7.2f", (double)it->nodes / its[d - 1].nodes);
+        } else {
+            printf("%7s", "-");
+        }
+        double probes = (it->probes > 0) ? it->probes : 1;
+        printf(" %8.1f %5.1f  ", 100 * it->hits / probes,
+               100 * it->cutoffs / probes);
+        print_move(it->move);
+        printf(" %6d\n", it->score);
+    }
+
+    // Root moves by the nodes they took, which is where the budget went.
+    for (size_t i = 1; i < roots.size(); i++) {
+        RootMove m = roots[i];
+        size_t j = i;
+        while (j > 0 && roots[j - 1].nodes < m.nodes) {
+            roots[j] = roots[j - 1];
+            j--;
+        }
+        roots[j] = m;
+    }
+    printf("  move          nodes  share      ms  depth  score\n");
+    long rootNodes = 0;
+    for (size_t i = 0; i < roots.size(); i++) {
+        RootMove *m = &roots[i];
+        rootNodes += m->nodes;
+        printf("  ");
+        print_move(m->move);
+        printf(" %12ld %5.1f%% %7.1f %6d %6d\n", m->nodes,
+               100.0 * m->nodes / (total > 0 ? total : 1), m->ms, m->depth,
+               m->score);
+    }
+    // Nodes not under a finished root move: the one being searched when
+    // time ran out, plus the root itself.
+    if (ended && total > rootNodes) {
+        printf("  %-7s %12ld %5.1f%%\n", "other", total - rootNodes,
+               100.0 * (total - rootNodes) / total);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool quiet = false;
+    vector<TraceRecord> recs;
+    long lost = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            quiet = true;
+            continue;
+        }
+        FILE *in = fopen(argv[i], "rb");
+        if (in == NULL) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return -1;
+        }
+        TraceRecord r;
+        while (fread(&r, sizeof(r), 1, in) == 1) {
+            if (r.type >= TRACE_TYPES) {
+                fprintf(stderr, "%s: not a search trace\n", argv[i]);
+                fclose(in);
+                return -1;
+            }
+            if (r.type == TRACE_LOST) lost += r.extra;
+            recs.push_back(r);
+        }
+        fclose(in);
+    }
+    if (recs.empty()) {
+        fprintf(stderr, "usage: %s [-q] trace...\n", argv[0]);
+        return -1;
+    }
+
+    int searches = 0;
+    size_t first = 0;
+    for (size_t i = 1; i <= recs.size(); i++) {
+        if (i == recs.size() || recs[i].type == TRACE_SEARCH
+            || recs[i].type == TRACE_LOST) {
+            report(recs, first, i, ++searches, quiet);
+            first = i;
+        }
+    }
+
+    printf("%d searches, %ld records", searches, (long)recs.size());
+    if (lost > 0) printf(", %ld lost to a full ring", lost);
+    printf("\n");
+    printf("depth  searches  effective branching factor\n");
+    for (int d = 2; d < MAX_DEPTH; d++) {
+        if (depthCount[d] == 0) continue;
+        printf("%5d %9ld %10.2f\n", d, depthCount[d],
+               depthNodes[d] / parentNodes[d]);
+    }
+    return 0;
+}
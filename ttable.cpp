@@ -0,0 +1,132 @@
+#include "ttable.h"
+#include <cstring>
+#include <sys/mman.h>
+
+#define TT_HUGE_PAGE    (2 << 20)
+
+// Packed entry data: lower and upper bound (16 bits each, offset so that
+// they are stored unsigned), move + 1, depth and generation (8 bits each),
+// and a bit marking the entry as used.
+#define TT_VALID        (UINT64_C(1) << 56)
+
+static inline uint64_t pack(int lower, int upper, int move, int depth,
+                            int generation) {
+    return (uint64_t)(lower + TT_MAX_SCORE + 1)
+        | (uint64_t)(upper + TT_MAX_SCORE + 1) << 16
+        | (uint64_t)(move + 1) << 32
+        | (uint64_t)depth << 40
+        | (uint64_t)generation << 48
+        | TT_VALID;
+}
+
+static inline int data_depth(uint64_t data) {
+    return (int)((data >> 40) & 0xff);
+}
+
+static inline int data_generation(uint64_t data) {
+    return (int)((data >> 48) & 0xff);
+}
+
+/*
+ * Makes a table of at most the given size, rounded down to a power of two
+ * buckets. With hugePages set the table is first tried on reserved huge
+ * pages (MAP_HUGETLB); otherwise, or if none are reserved, it is mapped
+ * normally and transparent huge pages are requested for it. Either way a
+ * probe of a large table then rarely misses the TLB.
+ */
+TTable::TTable(size_t bytes, bool hugePages) {
+    size_t nbuckets = 1;
+    while (nbuckets * 2 * TT_BUCKET_ENTRIES * sizeof(TTEntry) <= bytes) {
+        nbuckets *= 2;
+    }
+    size_t size = nbuckets * TT_BUCKET_ENTRIES * sizeof(TTEntry);
+    mask = nbuckets - 1;
+    generation = 0;
+    huge = false;
+
+    void *p = MAP_FAILED;
+    if (hugePages) {
+        mapSize = (size + TT_HUGE_PAGE - 1) & ~(size_t)(TT_HUGE_PAGE - 1);
+        p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = (p != MAP_FAILED);
+    }
+    if (p == MAP_FAILED) {
+        mapSize = size;
+        p = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED && hugePages) madvise(p, mapSize, MADV_HUGEPAGE);
+    }
+    if (p == MAP_FAILED) {
+        // Fall back to a single bucket rather than failing the search.
+        mapSize = 0;
+        mask = 0;
+        table = new TTEntry[TT_BUCKET_ENTRIES];
+        clear();
+        return;
+    }
+    table = (TTEntry *)p;
+}
+
+TTable::~TTable() {
+    if (mapSize > 0) munmap(table, mapSize);
+    else delete[] table;
+}
+
+void TTable::clear() {
+    memset(table, 0, (mask + 1) * TT_BUCKET_ENTRIES * sizeof(TTEntry));
+    generation = 0;
+}
+
+/*
+ * Looks up key. Returns false if it is not in the table or its entry was
+ * being overwritten at the time.
+ */
+bool TTable::probe(uint64_t key, TTData *out) {
+    TTEntry *bucket = &table[(key & mask) * TT_BUCKET_ENTRIES];
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        uint64_t data = ((volatile TTEntry *)&bucket[i])->data;
+        uint64_t check = ((volatile TTEntry *)&bucket[i])->check;
+        if ((check ^ data) != key || !(data & TT_VALID)) continue;
+
+        out->lower = (int)(data & 0xffff) - TT_MAX_SCORE - 1;
+        out->upper = (int)((data >> 16) & 0xffff) - TT_MAX_SCORE - 1;
+        out->move = (int)((data >> 32) & 0xff) - 1;
+        out->depth = data_depth(data);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Stores bounds for key. The entry replaced is the one already holding key
+ * if there is one, and otherwise the shallowest entry left from an earlier
+ * search, or failing that the shallowest entry.
+ */
+void TTable::store(uint64_t key, int lower, int upper, int move, int depth) {
+    if (lower < -TT_MAX_SCORE) lower = -TT_MAX_SCORE;
+    if (upper > TT_MAX_SCORE) upper = TT_MAX_SCORE;
+    if (depth > 0xff) depth = 0xff;
+
+    TTEntry *bucket = &table[(key & mask) * TT_BUCKET_ENTRIES];
+    int victim = 0, victimValue = 1 << 30;
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        uint64_t data = bucket[i].data;
+        if ((bucket[i].check ^ data) == key) {
+            victim = i;
+            break;
+        }
+        int value = data_depth(data);
+        if (data_generation(data) == generation) value += 0x100;
+        if (!(data & TT_VALID)) value = -1;
+        if (value < victimValue) {
+            victim = i;
+            victimValue = value;
+        }
+    }
+
+    uint64_t data = pack(lower, upper, move, depth, generation);
+    volatile TTEntry *e = &bucket[victim];
+    e->check = key ^ data;
+    e->data = data;
+}
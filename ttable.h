@@ -0,0 +1,72 @@
+#ifndef __TTABLE_H__
+#define __TTABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Transposition table shared by search threads without locks.
+ *
+ * Each entry is two 64 bit words: the packed data and the position key
+ * XORed with that data. A reader only accepts an entry whose two words
+ * XOR back to its key, so an entry torn by two threads writing at once
+ * reads as a miss instead of as a wrong result. Entries are grouped four to
+ * a 64 byte bucket, which is one cache line: a probe touches one line, and
+ * the line can be prefetched as soon as a move is made.
+ */
+
+#define TT_BUCKET_ENTRIES   4
+
+// Scores are stored in 16 bits.
+#define TT_MAX_SCORE        32767
+
+struct TTEntry {
+    uint64_t check;     // key ^ data
+    uint64_t data;
+};
+
+struct TTData {
+    int lower;          // the position's score is at least this
+    int upper;          // and at most this
+    int move;           // best move found, -1 if none
+    int depth;
+};
+
+/*
+ * Hashes a position (own to move) into a table key.
+ */
+static inline uint64_t tt_key(uint64_t own, uint64_t opp) {
+    uint64_t h = own * UINT64_C(0x9E3779B97F4A7C15);
+    h ^= (h >> 31) ^ (opp * UINT64_C(0xC2B2AE3D27D4EB4F));
+    h ^= h >> 29;
+    h *= UINT64_C(0x94D049BB133111EB);
+    return h ^ (h >> 32);
+}
+
+class TTable {
+
+private:
+    TTEntry *table;
+    size_t mapSize;
+    uint64_t mask;
+    int generation;
+    bool huge;
+
+public:
+    TTable(size_t bytes, bool hugePages);
+    ~TTable();
+    bool probe(uint64_t key, TTData *out);
+    void store(uint64_t key, int lower, int upper, int move, int depth);
+    void clear();
+    void new_search() { generation = (generation + 1) & 0xff; }
+    size_t buckets() { return mask + 1; }
+    size_t bytes() { return mapSize; }
+    bool huge_pages() { return huge; }
+
+    // Starts loading the bucket for key into the cache.
+    void prefetch(uint64_t key) {
+        __builtin_prefetch(&table[(key & mask) * TT_BUCKET_ENTRIES]);
+    }
+};
+
+#endif
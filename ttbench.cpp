@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include "positions.h"
+#include "ttable.h"
+#include "threadpool.h"
+using namespace std;
+
+/*
+ * Measures transposition table probes per second against the number of
+ * threads, with the table on normal pages and on huge pages. Each thread
+ * probes random keys and stores one in every four, which is roughly the mix
+ * seen in the endgame solver; keys are spread over the whole table so that
+ * nearly every probe misses the cache, as it does in a real search.
+ *
+ * usage: ttbench [max threads] [table MB] [ms per run]
+ */
+
+struct BenchThread {
+    TTable *table;
+    double ms;
+    uint64_t seed;
+    long probes;
+    long hits;
+};
+
+static void *bench_thread(void *arg) {
+    BenchThread *b = (BenchThread *)arg;
+    uint64_t x = b->seed | 1;
+    long probes = 0, hits = 0;
+    double end = now_ms() + b->ms;
+
+    while (now_ms() < end) {
+        for (int i = 0; i < 4096; i++) {
+            pos_random(&x);
+            // Keys come from a limited set so that stored entries are found
+            // again by later probes.
+            uint64_t key = tt_key(x & 0xffffff, 0);
+            TTData d;
+            if (b->table->probe(key, &d)) hits++;
+            if ((x & 3) == 0) b->table->store(key, -1, 1, (int)(x & 63), 10);
+            probes++;
+        }
+    }
+    b->probes = probes;
+    b->hits = hits;
+    return NULL;
+}
+
+static double run(TTable *table, int nthreads, double ms, double *hitRate) {
+    vector<BenchThread> args(nthreads);
+    vector<pthread_t> threads(nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        args[i].table = table;
+        args[i].ms = ms;
+        args[i].seed = (i + 1) * UINT64_C(0x9E3779B97F4A7C15);
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+
+    long probes = 0, hits = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+        probes += args[i].probes;
+        hits += args[i].hits;
+    }
+    *hitRate = (probes > 0) ? (double)hits / probes : 0;
+    return probes / ms / 1000;
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? atoi(argv[1]) : online_cpus();
+    size_t mb = (argc > 2) ? atoi(argv[2]) : 256;
+    double ms = (argc > 3) ? atof(argv[3]) : 1000;
+    if (maxThreads < 1) maxThreads = 1;
+
+    for (int huge = 0; huge <= 1; huge++) {
+        TTable table(mb << 20, huge != 0);
+        printf("%s: %lu MB, %lu buckets\n",
+               !huge ? "normal pages"
+               : table.huge_pages() ? "huge pages (MAP_HUGETLB)"
+               : "transparent huge pages (no huge pages reserved)",
+               (unsigned long)(table.bytes() >> 20),
+               (unsigned long)table.buckets());
+
+        // Touch every page before timing so that faults are not counted.
+        table.clear();
+        printf("threads  Mprobes/s  per thread  hit rate\n");
+        // Powers of two, then maxThreads itself.
+        for (int t = 1; ; t = (t * 2 < maxThreads) ? t * 2 : maxThreads) {
+            double hitRate;
+            double rate = run(&table, t, ms, &hitRate);
+            printf("%7d %10.2f %11.2f %9.2f\n", t, rate, rate / t, hitRate);
+            if (t == maxThreads) break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "tune.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "endgame.h"
+#include "eval.h"
+#include "search.h"
+
+const TuneSpec tune_specs[TUNE_PARAMS] = {
+    { "score.count", 0.25, 0, 2, 0.05, false, TUNE_MINIMAX },
+    { "score.mobility", 0.5, 0, 2, 0.05, false, TUNE_MINIMAX },
+    { "score.frontier", 0.25, 0, 2, 0.05, false, TUNE_MINIMAX },
+    { "score.corner", 3, 1, 10, 0.25, false, TUNE_MINIMAX },
+    { "eval.disc", EVAL_DISC_WEIGHT, 0, 16, 1, true, TUNE_SEARCH },
+    { "eval.mobility", EVAL_MOBILITY_WEIGHT, 0, 32, 1, true, TUNE_SEARCH },
+    { "eval.frontier", EVAL_FRONTIER_WEIGHT, 0, 32, 1, true, TUNE_SEARCH },
+    { "eval.corner", EVAL_CORNER_WEIGHT, 0, 128, 4, true, TUNE_SEARCH },
+    { "search.window", SEARCH_WINDOW, 1, 256, 4, true, TUNE_SEARCH },
+    { "search.sort_depth", SEARCH_SORT_DEPTH, 1, 6, 1, true, TUNE_SEARCH },
+    { "time.share", 0.9, 0.3, 1, 0.05, false, TUNE_SEARCH | TUNE_MCTS },
+    { "time.empties", 2, 1, 4, 0.25, false, TUNE_SEARCH | TUNE_MCTS },
+    { "endgame.empties", ENDGAME_EMPTIES, 8, 16, 1, true, TUNE_ALL }
+};
+
+/*
+ * Index of the parameter with the given name, or -1.
+ */
+int tune_find(const char *name) {
+    for (int p = 0; p < TUNE_PARAMS; p++) {
+        if (!strcmp(name, tune_specs[p].name)) return p;
+    }
+    return -1;
+}
+
+TuneParams::TuneParams() {
+    for (int p = 0; p < TUNE_PARAMS; p++) value[p] = tune_specs[p].value;
+}
+
+/*
+ * The value of an integer parameter, rounded to the nearest integer.
+ */
+int TuneParams::integer(int p) const {
+    return (int)floor(value[p] + 0.5);
+}
+
+/*
+ * Moves every value back into its parameter's range.
+ */
+void TuneParams::clamp() {
+    for (int p = 0; p < TUNE_PARAMS; p++) {
+        if (value[p] < tune_specs[p].min) value[p] = tune_specs[p].min;
+        if (value[p] > tune_specs[p].max) value[p] = tune_specs[p].max;
+    }
+}
+
+/*
+ * Reads "name value" lines until the end of the input; blank lines and
+ * lines starting with # are skipped. Returns false, changing nothing, if a
+ * name is unknown or a value malformed.
+ */
+bool TuneParams::read(istream &in) {
+    TuneParams read = *this;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        char name[64];
+        double v;
+        if (sscanf(line.c_str(), "%63s %lf", name, &v) != 2) return false;
+        int p = tune_find(name);
+        if (p < 0) return false;
+        read.value[p] = v;
+    }
+    read.clamp();
+    *this = read;
+    return true;
+}
+
+/*
+ * Writes every parameter in the form read() reads. If round is set,
+ * integer parameters are written rounded.
+ */
+void TuneParams::write(ostream &out, bool round) const {
+    for (int p = 0; p < TUNE_PARAMS; p++) {
+        out << tune_specs[p].name << " ";
+        if (round && tune_specs[p].integer) out << integer(p);
+        else out << value[p];
+        out << "\n";
+    }
+}
+
+bool TuneParams::load(const char *path) {
+    ifstream in(path);
+    return in && read(in);
+}
+
+bool TuneParams::save(const char *path) const {
+    ofstream out(path);
+    if (!out) return false;
+    out.precision(6);
+    out << "# engine parameters, see tune.h\n";
+    write(out, true);
+    return !out.fail();
+}
@@ -0,0 +1,70 @@
+#ifndef __TUNE_H__
+#define __TUNE_H__
+
+#include <iostream>
+using namespace std;
+
+/*
+ * Tunable engine parameters: the weights Player::score_move uses, the
+ * evaluation weights and window of the alpha-beta search, and how time and
+ * the endgame are allocated. Each has a default (the hand tuned value), a
+ * range and a step, the size of change the tuner starts perturbing it by.
+ *
+ * Values are kept in a text file of "name value" lines, written by the spsa
+ * tool and read by the player at startup; names not in the file keep their
+ * defaults.
+ */
+
+// Engine modes whose play a parameter changes, so the tuner only perturbs
+// parameters the games it plays can measure.
+#define TUNE_MINIMAX    1
+#define TUNE_SEARCH     2
+#define TUNE_MCTS       4
+#define TUNE_ALL        (TUNE_MINIMAX | TUNE_SEARCH | TUNE_MCTS)
+
+enum TuneParam {
+    TUNE_SCORE_COUNT,       // score_move: disc count weight
+    TUNE_SCORE_MOBILITY,    // score_move: mobility weight
+    TUNE_SCORE_FRONTIER,    // score_move: frontier weight
+    TUNE_SCORE_CORNER,      // score_move: factor for corner moves
+    TUNE_EVAL_DISC,         // search evaluation weights (see eval.h)
+    TUNE_EVAL_MOBILITY,
+    TUNE_EVAL_FRONTIER,
+    TUNE_EVAL_CORNER,
+    TUNE_SEARCH_WINDOW,     // first aspiration window half width
+    TUNE_SEARCH_SORT_DEPTH, // depth from which moves are sorted
+    TUNE_TIME_SHARE,        // share of the clock a game is planned to use
+    TUNE_TIME_EMPTIES,      // empties per move of ours left in the game
+    TUNE_ENDGAME_EMPTIES,   // solve exactly from this many empties
+    TUNE_PARAMS
+};
+
+struct TuneSpec {
+    const char *name;
+    double value;           // default
+    double min;
+    double max;
+    double step;
+    bool integer;
+    int modes;
+};
+
+extern const TuneSpec tune_specs[TUNE_PARAMS];
+
+int tune_find(const char *name);
+
+class TuneParams {
+
+public:
+    double value[TUNE_PARAMS];
+
+    TuneParams();
+    int integer(int p) const;
+    void clamp();
+    bool read(istream &in);
+    void write(ostream &out, bool round) const;
+    bool load(const char *path);
+    bool save(const char *path) const;
+};
+
+#endif
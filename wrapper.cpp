@@ -1,47 +1,109 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <unistd.h>
 #include "player.h"
+#include "threadpool.h"
+#include "latency.h"
+#include "protocol.h"
+#include "perfcount.h"
+#include "searchtrace.h"
 using namespace std;
 
 int main(int argc, char *argv[]) {    
     // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
+    const EngineEntry *engine = (argc == 3) ? engine_find(argv[2]) : NULL;
+    if ((argc != 2 && argc != 3) || (argc == 3 && engine == NULL)) {
+        cerr << "usage: " << argv[0] << " side [engine]" << endl
+             << "engines:" << endl;
+        engine_list(cerr);
         exit(-1);
     }
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
     // Initialize player.
     Player *player = new Player(side);
+    player->search_threads = online_cpus();
+    if (engine != NULL) player->use_engine(engine);
+
+    // No board after each move, e.g. when timing the referee protocol.
+    if (getenv("OTHELLO_QUIET") != NULL) player->showBoard = false;
+
+    // Proof-number search for positions with up to this many empties.
+    const char *proof = getenv("OTHELLO_PROOF");
+    if (proof != NULL) player->proof_empties = atoi(proof);
+
+    // Hardware counters for the search, if this is a profiling build.
+    if (getenv("OTHELLO_PERF") != NULL && !perf_enable() && !perf_enabled) {
+        cerr << "OTHELLO_PERF ignored: build with make PERF=1" << endl;
+    }
+
+    // Trace of the alpha-beta searches, for tracereport.
+    SearchTrace *trace = NULL;
+    const char *tracePath = getenv("OTHELLO_TRACE");
+    if (tracePath != NULL) {
+        trace = new SearchTrace(tracePath, TRACE_RECORDS);
+        if (!trace->ok()) {
+            cerr << "cannot write trace to " << tracePath << endl;
+            delete trace;
+            trace = NULL;
+        }
+        player->search_trace = trace;
+    }
+
+    // Talk to the java wrapper on stdin and stdout directly; it picks the
+    // framing (see protocol.h).
+    const char *framing = getenv("OTHELLO_FRAMING");
+    RefereeLink link(STDIN_FILENO, STDOUT_FILENO,
+                     framing != NULL && !strcmp(framing, "binary"));
 
     // Tell java wrapper that we are done initializing.
-    cout << "Init done" << endl;
-    cout.flush();    
+    link.write_line("Init done");
     
     int moveX, moveY, msLeft;    
+    LatencyStats latency;
+    latency.games = 1;
 
     // Get opponent's move and time left for player each turn.
-    while (cin >> moveX >> moveY >> msLeft) {
+    while (link.read_request(&moveX, &moveY, &msLeft)) {
+        double start = now_ms();
         Move *opponentsMove = NULL;
         if (moveX >= 0 && moveY >= 0) {
             opponentsMove = new Move(moveX, moveY);
         }
         
         // Get player's move and output to java wrapper.
+        double searchStart = now_ms();
         Move *playersMove = player->doMove(opponentsMove, msLeft);                        
+        double searchMs = now_ms() - searchStart;
         if (playersMove != NULL) {                  
-            cout << playersMove->x << " " << playersMove->y << endl;
+            link.write_move(playersMove->x, playersMove->y);
         } else {
-            cout << "-1 -1" << endl;
+            link.write_move(-1, -1);
         }
-        cout.flush();
         cerr.flush();
+        // Phase by the empties we searched, before our own move.
+        int empties = player->empties() + ((playersMove != NULL) ? 1 : 0);
+        latency.record(empties, now_ms() - start, searchMs, msLeft);
+        // Write the trace once the reply is out and timed, off the clock.
+        if (trace != NULL) trace->flush();
+        perf_move_report(cerr);
         
         // Delete move objects.
         if (opponentsMove != NULL) delete opponentsMove;
         if (playersMove != NULL) delete playersMove; 
     }
 
+    // Report how close each move came to the clock, and keep the numbers
+    // for aggregation if asked to.
+    latency.print(cerr);
+    perf_final_report(cerr);
+    const char *latencyLog = getenv("OTHELLO_LATENCY_LOG");
+    if (latencyLog != NULL) latency.append(latencyLog);
+
+    // Let the player save what it learned during the game.
+    delete player;
+    delete trace;
+
     return 0;
 }